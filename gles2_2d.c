@@ -16,12 +16,28 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
 */
 
+#include <core/gfxcard.h>
 #include <core/screen.h>
 #include <core/screens.h>
 #include <core/state.h>
+#include <core/surface.h>
 #include <core/surface_allocation.h>
 
-#include "gles2_gfxdriver.h"
+#include "gles2_2d.h"
+#include "gles2_async.h"
+#include "gles2_atlas.h"
+#include "gles2_context.h"
+#include "gles2_es3.h"
+#include "gles2_stats.h"
+#include "gles2_sync.h"
+
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 D_DEBUG_DOMAIN( GLES2_2D, "GLES2/2D", "OpenGL ES 2.0 2D Acceleration" );
 
@@ -31,42 +47,375 @@ D_DEBUG_DOMAIN( GLES2_2D, "GLES2/2D", "OpenGL ES 2.0 2D Acceleration" );
  * State handling macros.
  */
 
-#define GLES2_VALIDATE(flag)                                      \
-     do {                                                         \
-          dev->progs[dev->prog_index].flags |= flag;              \
+#define GLES2_VALIDATE(flag)                                                    \
+     do {                                                                       \
+          drv->context->flags[drv->context->prog_index] |= flag;                \
      } while (0)
 
-#define GLES2_INVALIDATE(flag)                                    \
-     do {                                                         \
-          int i;                                                  \
-          for (i = 0; i < NUM_PROGRAMS; i++)                      \
-               dev->progs[i].flags &= ~flag;                      \
+#define GLES2_INVALIDATE(flag)                                                  \
+     do {                                                                       \
+          int i;                                                                \
+          for (i = 0; i < NUM_PROGRAMS; i++)                                    \
+               drv->context->flags[i] &= ~flag;                                 \
      } while (0)
 
-#define GLES2_CHECK_VALIDATE(flag)                                \
-     do {                                                         \
-          if ((dev->progs[dev->prog_index].flags & flag) != flag) \
-               gles2_validate_##flag( drv, dev, state );          \
+#define GLES2_CHECK_VALIDATE(flag)                                              \
+     do {                                                                       \
+          if ((drv->context->flags[drv->context->prog_index] & flag) != flag)   \
+               gles2_validate_##flag( drv, dev, state );                        \
      } while (0)
 
+/*
+ * Framebuffer object cache.
+ */
+
+static ReactionResult
+gles2_fbo_listener( const void *msg_data,
+                    void       *ctx )
+{
+     const CoreSurfaceNotification *notification = msg_data;
+     GLES2DriverData               *drv          = ctx;
+     FusionObjectID                 id           = notification->surface->object.id;
+     unsigned int                   i;
+
+     if (!(notification->flags & (CSNF_SIZEFORMAT | CSNF_DESTROY | CSNF_BUFFER_ALLOCATION_DESTROY)))
+          return RS_OK;
+
+     D_DEBUG_AT( GLES2_2D, "%s( surface %u, flags 0x%08x )\n", __FUNCTION__, id, notification->flags );
+
+     /* Not in a rendering thread, each context releases the framebuffer objects before its next commands. */
+     direct_mutex_lock( &drv->fbo_lock );
+
+     drv->fbo_destroyed[drv->fbo_num_destroyed++ % GLES2_FBO_DESTROYED] = id;
+
+     if (notification->flags & CSNF_DESTROY) {
+          for (i = 0; i < GLES2_FBO_WATCHES; i++) {
+               if (drv->fbo_watches[i].id == id) {
+                    drv->fbo_watches[i].surface = NULL;
+                    drv->fbo_watches[i].id      = 0;
+                    break;
+               }
+          }
+     }
+
+     direct_mutex_unlock( &drv->fbo_lock );
+
+     return (notification->flags & CSNF_DESTROY) ? RS_REMOVE : RS_OK;
+}
+
+/*
+ * Listen to a destination surface rendered via the cache, for the release of its framebuffer objects. Returns false if
+ * no more surfaces can be listened to, the destination is then rendered via the framebuffer bound by the system module.
+ */
+static bool
+gles2_fbo_watch( GLES2DriverData *drv,
+                 CoreSurface     *surface )
+{
+     GLES2FramebufferWatch *watch = NULL;
+     FusionObjectID         id    = surface->object.id;
+     unsigned int           i;
+
+     /* Surfaces of the tools harness are no core objects. */
+     if (!drv->core)
+          return true;
+
+     direct_mutex_lock( &drv->fbo_lock );
+
+     for (i = 0; i < GLES2_FBO_WATCHES; i++) {
+          if (drv->fbo_watches[i].id == id) {
+               direct_mutex_unlock( &drv->fbo_lock );
+               return true;
+          }
+
+          if (!watch && !drv->fbo_watches[i].id)
+               watch = &drv->fbo_watches[i];
+     }
+
+     if (watch) {
+          watch->surface = surface;
+          watch->id      = id;
+     }
+
+     direct_mutex_unlock( &drv->fbo_lock );
+
+     if (!watch) {
+          D_DEBUG_AT( GLES2_2D, "  -> no watch left for surface %u\n", id );
+          return false;
+     }
+
+     /* The listener locks the watches, the reactor is not called with the lock held. */
+     if (dfb_surface_attach( surface, gles2_fbo_listener, drv, &watch->reaction )) {
+          direct_mutex_lock( &drv->fbo_lock );
+
+          watch->surface = NULL;
+          watch->id      = 0;
+
+          direct_mutex_unlock( &drv->fbo_lock );
+
+          return false;
+     }
+
+     return true;
+}
+
+static void
+gles2_fbo_release( GLES2Framebuffer *fbo )
+{
+     D_DEBUG_AT( GLES2_2D, "%s( texture %u, fbo %u )\n", __FUNCTION__, fbo->tex, fbo->fbo );
+
+     if (fbo->fbo)
+          glDeleteFramebuffers( 1, &fbo->fbo );
+
+     memset( fbo, 0, sizeof(GLES2Framebuffer) );
+}
+
+/*
+ * Bind the framebuffer object of the destination texture, created and checked for completeness on first use.
+ * Returns false if the destination has no texture or it is not color renderable.
+ *
+ * Entries are identified by the texture, the allocation and its object id. An entry with the texture of another
+ * allocation belongs to a deleted texture whose name has been reused, entries of destroyed or reallocated surfaces are
+ * released by gles2_fbo_drain().
+ */
+static bool
+gles2_fbo_bind( GLES2DriverData         *drv,
+                const GLES2PendingState *state )
+{
+     GLuint            tex     = state->dst_tex;
+     GLES2Context     *context = drv->context;
+     GLES2Framebuffer *fbos    = context->fbos;
+     GLES2Framebuffer *fbo     = NULL;
+     GLenum            status;
+     unsigned int      i;
+
+     if (!tex)
+          return false;
+
+     /* Framebuffer objects are not shared between contexts, each context has its own cache. */
+     for (i = 0; i < GLES2_FBOS; i++) {
+          if (fbos[i].tex == tex) {
+               if (fbos[i].allocation == state->dst_allocation && fbos[i].id == state->dst_id) {
+                    fbo = &fbos[i];
+                    break;
+               }
+
+               gles2_fbo_release( &fbos[i] );
+          }
+
+          /* Replace the least recently used entry. */
+          if (!fbo || fbos[i].used < fbo->used)
+               fbo = &fbos[i];
+     }
+
+     /* Remember the framebuffer bound by the system module, it's bound again after the commands. */
+     if (!context->cached)
+          glGetIntegerv( GL_FRAMEBUFFER_BINDING, &context->system );
+
+     if (i == GLES2_FBOS) {
+          if (fbo->tex)
+               gles2_fbo_release( fbo );
+
+          fbo->tex        = tex;
+          fbo->allocation = state->dst_allocation;
+          fbo->id         = state->dst_id;
+          fbo->surface    = state->surface_id;
+
+          glGenFramebuffers( 1, &fbo->fbo );
+          glBindFramebuffer( GL_FRAMEBUFFER, fbo->fbo );
+          glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0 );
+
+          status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+          if (status != GL_FRAMEBUFFER_COMPLETE) {
+               D_DEBUG_AT( GLES2_2D, "  -> texture %u incomplete (0x%04x), using bound framebuffer\n", tex, status );
+
+               /* Remember the texture to not check it again. */
+               glBindFramebuffer( GL_FRAMEBUFFER, context->system );
+               glDeleteFramebuffers( 1, &fbo->fbo );
+               fbo->fbo = 0;
+          }
+          else
+               D_DEBUG_AT( GLES2_2D, "  -> created fbo %u for texture %u\n", fbo->fbo, tex );
+     }
+     else if (fbo->fbo)
+          glBindFramebuffer( GL_FRAMEBUFFER, fbo->fbo );
+
+     fbo->used = ++drv->fbo_stamp;
+
+     context->cached   = fbo->fbo;
+     context->restored = 0;
+
+     return fbo->fbo != 0;
+}
+
+/*
+ * Bind the framebuffer bound by the system module again after commands rendered via the cache in the context of the
+ * calling thread. The hardware states stay valid, only the framebuffer object is bound again by gles2_fbo_rebind().
+ */
+static void
+gles2_fbo_restore( GLES2DriverData *drv )
+{
+     GLES2Context *context = drv->context;
+
+     if (!context->cached)
+          return;
+
+     D_DEBUG_AT( GLES2_2D, "%s( fbo %u -> %d )\n", __FUNCTION__, context->cached, context->system );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, context->system );
+
+     context->restored = context->cached;
+     context->cached   = 0;
+}
+
+/*
+ * Bind the framebuffer object of the destination again before further commands, after the framebuffer bound by the
+ * system module has been restored. It is queried again, the system module may have bound another one meanwhile.
+ */
+static void
+gles2_fbo_rebind( GLES2DriverData *drv )
+{
+     GLES2Context *context = drv->context;
+
+     if (!context->restored)
+          return;
+
+     D_DEBUG_AT( GLES2_2D, "%s( fbo %u )\n", __FUNCTION__, context->restored );
+
+     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &context->system );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, context->restored );
+
+     context->cached   = context->restored;
+     context->restored = 0;
+}
+
+/*
+ * Release the framebuffer objects of the surfaces destroyed or reallocated since the last commands of the current
+ * context. If more surfaces have been destroyed than remembered, all framebuffer objects of the context are released.
+ */
+static void
+gles2_fbo_drain( GLES2DriverData *drv )
+{
+     GLES2Context   *context = drv->context;
+     FusionObjectID  ids[GLES2_FBO_DESTROYED];
+     unsigned int    i, n, num;
+
+     direct_mutex_lock( &drv->fbo_lock );
+
+     num = drv->fbo_num_destroyed - context->destroyed;
+
+     for (n = 0; n < num && num <= GLES2_FBO_DESTROYED; n++)
+          ids[n] = drv->fbo_destroyed[(context->destroyed + n) % GLES2_FBO_DESTROYED];
+
+     context->destroyed = drv->fbo_num_destroyed;
+
+     direct_mutex_unlock( &drv->fbo_lock );
+
+     if (!num)
+          return;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %u surfaces )\n", __FUNCTION__, num );
+
+     for (i = 0; i < GLES2_FBOS; i++) {
+          GLES2Framebuffer *fbo = &context->fbos[i];
+
+          if (!fbo->tex)
+               continue;
+
+          if (num <= GLES2_FBO_DESTROYED) {
+               for (n = 0; n < num; n++) {
+                    if (ids[n] == fbo->surface)
+                         break;
+               }
+
+               if (n == num)
+                    continue;
+          }
+
+          /* The destination is bound again via the cache or the system module. */
+          if (fbo->fbo && (fbo->fbo == context->cached || fbo->fbo == context->restored)) {
+               if (context->cached)
+                    glBindFramebuffer( GL_FRAMEBUFFER, context->system );
+
+               context->cached   = 0;
+               context->restored = 0;
+
+               GLES2_INVALIDATE( DESTINATION );
+          }
+
+          gles2_fbo_release( fbo );
+     }
+}
+
+void
+gles2_watch_init( GLES2DriverData *drv )
+{
+     direct_mutex_init( &drv->fbo_lock );
+}
+
+void
+gles2_watch_deinit( GLES2DriverData *drv )
+{
+     unsigned int i;
+
+     for (i = 0; i < GLES2_FBO_WATCHES; i++) {
+          if (drv->fbo_watches[i].surface)
+               dfb_surface_detach( drv->fbo_watches[i].surface, &drv->fbo_watches[i].reaction );
+     }
+
+     memset( drv->fbo_watches, 0, sizeof(drv->fbo_watches) );
+
+     direct_mutex_deinit( &drv->fbo_lock );
+}
+
+void
+gles2_fbo_deinit( GLES2Framebuffer *fbos,
+                  bool              current )
+{
+     unsigned int i;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %scurrent )\n", __FUNCTION__, current ? "" : "not " );
+
+     for (i = 0; i < GLES2_FBOS; i++) {
+          if (!current)
+               fbos[i].fbo = 0;
+
+          if (fbos[i].tex)
+               gles2_fbo_release( &fbos[i] );
+     }
+}
+
 /*
  * State validation functions.
  */
 
 static inline void
-gles2_validate_DESTINATION( GLES2DriverData *drv,
-                            GLES2DeviceData *dev,
-                            CardState       *state )
+gles2_validate_DESTINATION( GLES2DriverData         *drv,
+                            GLES2DeviceData         *dev,
+                            const GLES2PendingState *state )
 {
-     GLint             w    = state->destination->config.size.w;
-     GLint             h    = state->destination->config.size.h;
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLint             w    = state->dst_size.w;
+     GLint             h    = state->dst_size.h;
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
      GLfloat           m[9];
      int               width, height;
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
      D_DEBUG_AT( GLES2_2D, "  -> width %d, height %d\n", w, h );
 
+     /* Bind the cached framebuffer object of an offscreen destination, or the framebuffer bound by the system module
+        when the state was set, another destination may have been bound since. */
+     if (state->offscreen && gles2_fbo_bind( drv, state )) {
+          drv->offscreen = true;
+     }
+     else {
+          glBindFramebuffer( GL_FRAMEBUFFER, state->framebuffer );
+
+          drv->offscreen         = state->framebuffer != 0;
+          drv->context->cached   = 0;
+          drv->context->restored = 0;
+     }
+
      glViewport( 0, 0, w, h );
 
      memset( m, 0, sizeof(m) );
@@ -93,11 +442,7 @@ gles2_validate_DESTINATION( GLES2DriverData *drv,
           glUniformMatrix3fv( prog->dfbMVPMatrix, 1, GL_FALSE, m );
      }
      else {
-          GLint fbo;
-
-          glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
-
-          if (fbo) {
+          if (drv->offscreen) {
                glUniform3f( prog->dfbScale, 2.0f / w,  2.0f / h, -1.0f );
 
                m[0] = 1.0f; m[4] = 1.0f;
@@ -131,19 +476,15 @@ gles2_validate_DESTINATION( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_CLIP( GLES2DriverData *drv,
-                     GLES2DeviceData *dev,
-                     CardState       *state )
+gles2_validate_CLIP( GLES2DriverData         *drv,
+                     GLES2DeviceData         *dev,
+                     const GLES2PendingState *state )
 {
-     GLint fbo;
-
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
-     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
-
      glEnable( GL_SCISSOR_TEST );
 
-     glScissor( state->clip.x1, fbo ? state->clip.y1 : state->dst.allocation->config.size.h - state->clip.y2 - 1,
+     glScissor( state->clip.x1, drv->offscreen ? state->clip.y1 : state->dst_size.h - state->clip.y2 - 1,
                 state->clip.x2 - state->clip.x1 + 1, state->clip.y2 - state->clip.y1 + 1 );
 
      /* Set the flag. */
@@ -151,11 +492,11 @@ gles2_validate_CLIP( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_MATRIX( GLES2DriverData *drv,
-                       GLES2DeviceData *dev,
-                       CardState       *state )
+gles2_validate_MATRIX( GLES2DriverData         *drv,
+                       GLES2DeviceData         *dev,
+                       const GLES2PendingState *state )
 {
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
@@ -178,11 +519,11 @@ gles2_validate_MATRIX( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_COLOR_DRAW( GLES2DriverData *drv,
-                           GLES2DeviceData *dev,
-                           CardState       *state )
+gles2_validate_COLOR_DRAW( GLES2DriverData         *drv,
+                           GLES2DeviceData         *dev,
+                           const GLES2PendingState *state )
 {
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
@@ -211,14 +552,14 @@ gles2_validate_COLOR_DRAW( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_COLORKEY( GLES2DriverData *drv,
-                         GLES2DeviceData *dev,
-                         CardState       *state )
+gles2_validate_COLORKEY( GLES2DriverData         *drv,
+                         GLES2DeviceData         *dev,
+                         const GLES2PendingState *state )
 {
      GLint             r    = (state->src_colorkey & 0x00FF0000) >> 16;
      GLint             g    = (state->src_colorkey & 0x0000FF00) >>  8;
      GLint             b    = (state->src_colorkey & 0x000000FF);
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
@@ -231,16 +572,23 @@ gles2_validate_COLORKEY( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_SOURCE( GLES2DriverData *drv,
-                       GLES2DeviceData *dev,
-                       CardState       *state )
+gles2_validate_SOURCE( GLES2DriverData         *drv,
+                       GLES2DeviceData         *dev,
+                       const GLES2PendingState *state )
 {
-     GLint             w    = state->source->config.size.w;
-     GLint             h    = state->source->config.size.h;
-     GLuint            tex  = (GLuint)(long) state->src.handle;
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLint             w    = state->src_size.w;
+     GLint             h    = state->src_size.h;
+     GLuint            tex  = state->src_tex;
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
+
+     /* The source rectangles of blits from an atlas page are within the page. */
+     if (drv->atlas.bound) {
+          w   = drv->atlas.size;
+          h   = drv->atlas.size;
+          tex = drv->atlas.bound->tex;
+     }
      D_DEBUG_AT( GLES2_2D, "  -> width %d, height %d, texture %u\n", w, h, tex );
 
      glBindTexture( GL_TEXTURE_2D, tex );
@@ -252,12 +600,12 @@ gles2_validate_SOURCE( GLES2DriverData *drv,
 }
 
 static inline void
-gles2_validate_COLOR_BLIT( GLES2DriverData *drv,
-                           GLES2DeviceData *dev,
-                           CardState       *state )
+gles2_validate_COLOR_BLIT( GLES2DriverData         *drv,
+                           GLES2DeviceData         *dev,
+                           const GLES2PendingState *state )
 {
      GLfloat           s, r, g, b, a;
-     GLES2ProgramInfo *prog = &dev->progs[dev->prog_index];
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
@@ -300,174 +648,547 @@ gles2_validate_COLOR_BLIT( GLES2DriverData *drv,
      GLES2_VALIDATE( COLOR_BLIT );
 }
 
+/*
+ * The source color matrix has three rows of 16.16 fixed point values, the coefficients of the red, green and blue
+ * components followed by an offset in the units of 8 bit components. The alpha is not transformed.
+ */
 static inline void
-gles2_validate_BLENDING( GLES2DriverData *drv,
-                         GLES2DeviceData *dev,
-                         CardState       *state )
+gles2_validate_COLORMATRIX( GLES2DriverData         *drv,
+                            GLES2DeviceData         *dev,
+                            const GLES2PendingState *state )
 {
-     GLenum src, dst;
+     GLES2ProgramInfo *prog = &dev->progs[drv->context->prog_index];
+     const s32        *m    = state->src_colormatrix;
+     GLfloat           s    = 1.0f / 65536.0f;
+     GLfloat           o    = s / 255.0f;
+     GLfloat           matrix[16];
+     int               i;
 
      D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
-     switch (state->src_blend) {
-          case DSBF_ZERO:
-               src = GL_ZERO;
-               break;
+     /* Column major, the offsets in the last column. */
+     for (i = 0; i < 3; i++) {
+          matrix[i]      = m[i * 4]     * s;
+          matrix[i + 4]  = m[i * 4 + 1] * s;
+          matrix[i + 8]  = m[i * 4 + 2] * s;
+          matrix[i + 12] = m[i * 4 + 3] * o;
+     }
 
-          case DSBF_ONE:
-               src = GL_ONE;
-               break;
+     matrix[3]  = 0.0f;
+     matrix[7]  = 0.0f;
+     matrix[11] = 0.0f;
+     matrix[15] = 1.0f;
 
-          case DSBF_SRCCOLOR:
-               src = GL_SRC_COLOR;
-               break;
+     glUniformMatrix4fv( prog->dfbColorMatrix, 1, GL_FALSE, matrix );
 
-          case DSBF_INVSRCCOLOR:
-               src = GL_ONE_MINUS_SRC_COLOR;
-               break;
+     /* Premultiplication after the modulation. */
+     glUniform3f( prog->dfbMultiply, (state->blittingflags & DSBLIT_SRC_PREMULTIPLY) ? 1.0f : 0.0f, 0.0f, 0.0f );
 
-          case DSBF_SRCALPHA:
-               src = GL_SRC_ALPHA;
-               break;
+     D_DEBUG_AT( GLES2_2D, "  -> loaded color matrix\n" );
 
-          case DSBF_INVSRCALPHA:
-               src = GL_ONE_MINUS_SRC_ALPHA;
-               break;
+     /* Set the flag. */
+     GLES2_VALIDATE( COLORMATRIX );
+}
 
-          case DSBF_DESTALPHA:
-               src = GL_DST_ALPHA;
-               break;
+/*
+ * The convolution kernel, its scale and the bias are 16.16 fixed point values, the bias in the units of 8 bit
+ * components. All components including the alpha are convolved.
+ */
+static inline void
+gles2_validate_CONVOLUTION( GLES2DriverData         *drv,
+                            GLES2DeviceData         *dev,
+                            const GLES2PendingState *state )
+{
+     GLES2ProgramInfo           *prog   = &dev->progs[drv->context->prog_index];
+     const DFBConvolutionFilter *filter = &state->src_convolution;
+     GLfloat                     s      = filter->scale / (65536.0f * 65536.0f);
+     GLfloat                     kernel[9];
+     int                         i;
 
-          case DSBF_INVDESTALPHA:
-               src = GL_ONE_MINUS_DST_ALPHA;
-               break;
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
-          case DSBF_DESTCOLOR:
-               src = GL_DST_COLOR;
-               break;
+     /* Each row of the kernel is a column of the matrix. */
+     for (i = 0; i < 9; i++)
+          kernel[i] = filter->kernel[i] * s;
 
-          case DSBF_INVDESTCOLOR:
-               src = GL_ONE_MINUS_DST_COLOR;
-               break;
+     glUniformMatrix3fv( prog->dfbKernel, 1, GL_FALSE, kernel );
+     glUniform1f( prog->dfbBias, filter->bias / (65536.0f * 255.0f) );
 
-          case DSBF_SRCALPHASAT:
-               src = GL_SRC_ALPHA_SATURATE;
-               break;
+     /* Premultiplication after the modulation. */
+     glUniform3f( prog->dfbMultiply, (state->blittingflags & DSBLIT_SRC_PREMULTIPLY) ? 1.0f : 0.0f, 0.0f, 0.0f );
 
-          default:
-               D_BUG( "unexpected src blend function %u", state->src_blend );
-     }
+     D_DEBUG_AT( GLES2_2D, "  -> loaded convolution kernel, scale 0x%08x, bias 0x%08x\n", filter->scale, filter->bias );
 
-     switch (state->dst_blend) {
+     /* Set the flag. */
+     GLES2_VALIDATE( CONVOLUTION );
+}
+
+/*
+ * Map a DirectFB blend function to the OpenGL ES blend factor, applied to color and alpha like DirectFB does.
+ */
+static inline GLenum
+gles2_blend_factor( DFBSurfaceBlendFunction function )
+{
+     switch (function) {
           case DSBF_ZERO:
-               dst = GL_ZERO;
-               break;
+               return GL_ZERO;
 
           case DSBF_ONE:
-               dst = GL_ONE;
-               break;
+               return GL_ONE;
 
           case DSBF_SRCCOLOR:
-               dst = GL_SRC_COLOR;
-               break;
+               return GL_SRC_COLOR;
 
           case DSBF_INVSRCCOLOR:
-               dst = GL_ONE_MINUS_SRC_COLOR;
-               break;
+               return GL_ONE_MINUS_SRC_COLOR;
 
           case DSBF_SRCALPHA:
-               dst = GL_SRC_ALPHA;
-               break;
+               return GL_SRC_ALPHA;
 
           case DSBF_INVSRCALPHA:
-               dst = GL_ONE_MINUS_SRC_ALPHA;
-               break;
+               return GL_ONE_MINUS_SRC_ALPHA;
 
           case DSBF_DESTALPHA:
-               dst = GL_DST_ALPHA;
-               break;
+               return GL_DST_ALPHA;
 
           case DSBF_INVDESTALPHA:
-               dst = GL_ONE_MINUS_DST_ALPHA;
-               break;
+               return GL_ONE_MINUS_DST_ALPHA;
 
           case DSBF_DESTCOLOR:
-               dst = GL_DST_COLOR;
-               break;
+               return GL_DST_COLOR;
 
           case DSBF_INVDESTCOLOR:
-               dst = GL_ONE_MINUS_DST_COLOR;
-               break;
+               return GL_ONE_MINUS_DST_COLOR;
 
           case DSBF_SRCALPHASAT:
-               dst = GL_SRC_ALPHA_SATURATE;
-               break;
+               return GL_SRC_ALPHA_SATURATE;
 
           default:
-               D_BUG( "unexpected dst blend function %u", state->dst_blend );
+               D_BUG( "unexpected blend function %u", function );
      }
 
-     glBlendFunc( src, dst );
+     return GL_ONE;
+}
+
+static inline void
+gles2_validate_BLENDING( GLES2DriverData         *drv,
+                         GLES2DeviceData         *dev,
+                         const GLES2PendingState *state )
+{
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
+
+     glBlendFunc( gles2_blend_factor( state->src_blend ), gles2_blend_factor( state->dst_blend ) );
 
      /* Set the flag. */
      GLES2_VALIDATE( BLENDING );
 }
 
-/**********************************************************************************************************************/
-
-static void
-gles2CheckState( void                *driver_data,
-                 void                *device_data,
-                 CardState           *state,
-                 DFBAccelerationMask  accel )
+static inline void
+gles2_validate_FETCH( GLES2DriverData         *drv,
+                      GLES2DeviceData         *dev,
+                      const GLES2PendingState *state )
 {
-     GraphicsDeviceInfo device_info;
-
-     D_DEBUG_AT( GLES2_2D, "%s( %p, 0x%08x )\n", __FUNCTION__, state, accel );
+     GLES2ProgramIndex  prog_index = drv->context->prog_index;
+     GLES2ProgramInfo  *prog       = &dev->progs[prog_index];
+     bool               blend, src_premultiply, dst_premultiply, demultiply;
 
-     dfb_gfxcard_get_device_info( &device_info );
-
-     /* Check if function is accelerated. */
-     if (accel & ~device_info.caps.accel) {
-          D_DEBUG_AT(GLES2_2D, "  -> unsupported function\n");
-          return;
-     }
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
-     /* Check if drawing or blitting flags are supported. */
-     if (DFB_DRAWING_FUNCTION(accel)) {
-          if (state->drawingflags & ~device_info.caps.drawing) {
-               D_DEBUG_AT(GLES2_2D, "  -> unsupported drawing flags 0x%08x\n", state->drawingflags);
-               return;
-          }
+     if (prog_index == DRAW_FETCH || prog_index == DRAW_FETCH_MAT) {
+          /* The color is premultiplied by the COLOR_DRAW validation. */
+          blend           = state->drawingflags & DSDRAW_BLEND;
+          src_premultiply = false;
+          dst_premultiply = state->drawingflags & DSDRAW_DST_PREMULTIPLY;
+          demultiply      = state->drawingflags & DSDRAW_DEMULTIPLY;
      }
      else {
-          if (state->blittingflags & ~device_info.caps.blitting) {
-               D_DEBUG_AT(GLES2_2D, "  -> unsupported blitting flags 0x%08x\n", state->blittingflags);
-               return;
-          }
+          blend           = state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA);
+          src_premultiply = state->blittingflags & DSBLIT_SRC_PREMULTIPLY;
+          dst_premultiply = state->blittingflags & DSBLIT_DST_PREMULTIPLY;
+          demultiply      = state->blittingflags & DSBLIT_DEMULTIPLY;
      }
 
-     /* Enable acceleration of the function. */
-     state->accel |= accel;
+     glUniform2i( prog->dfbBlend, blend ? state->src_blend : DSBF_UNKNOWN, blend ? state->dst_blend : DSBF_UNKNOWN );
+     glUniform3f( prog->dfbMultiply, src_premultiply, dst_premultiply, demultiply );
+
+     D_DEBUG_AT( GLES2_2D, "  -> loaded blend functions %d %d, multiply %d %d %d\n",
+                 blend ? state->src_blend : DSBF_UNKNOWN, blend ? state->dst_blend : DSBF_UNKNOWN,
+                 src_premultiply, dst_premultiply, demultiply );
+
+     /* Set the flag. */
+     GLES2_VALIDATE( FETCH );
 }
 
-static void
-gles2SetState( void                *driver_data,
-               void                *device_data,
-               GraphicsDeviceFuncs *funcs,
-               CardState           *state,
-               DFBAccelerationMask  accel )
+static inline void
+gles2_validate_ANTIALIAS( GLES2DriverData         *drv,
+                          GLES2DeviceData         *dev,
+                          const GLES2PendingState *state )
 {
-     GLES2DriverData *drv = driver_data;
-     GLES2DeviceData *dev = device_data;
-     DFBBoolean       blend;
+     GLES2ProgramIndex  prog_index = drv->context->prog_index;
+     GLES2ProgramInfo  *prog       = &dev->progs[prog_index];
+     bool               blend, premultiply, scale;
 
-     D_DEBUG_AT(GLES2_2D, "%s( %p, 0x%08x ) <- mod_hw 0x%08x\n", __FUNCTION__, state, accel, state->mod_hw );
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
 
-     drv->blittingflags = state->blittingflags;
+     if (prog_index == DRAW_AA || prog_index == DRAW_AA_MAT) {
+          /* The color is premultiplied by the COLOR_DRAW validation. */
+          blend       = state->drawingflags & DSDRAW_BLEND;
+          premultiply = false;
+     }
+     else {
+          blend       = state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA);
+          premultiply = state->blittingflags & DSBLIT_SRC_PREMULTIPLY;
+     }
 
-     /*
-      * 1) Invalidate hardware states
+     /* With blending, the coverage scales the alpha, and the color unless it is scaled by the source alpha. Without
+        blending, the coverage replaces the alpha mixing the color with the destination. */
+     scale = blend && state->src_blend != DSBF_SRCALPHA;
+
+     glUniform3f( prog->dfbCoverage, scale, !blend, premultiply );
+
+     D_DEBUG_AT( GLES2_2D, "  -> loaded coverage factors %d %d %d\n", scale, !blend, premultiply );
+
+     /* Set the flag. */
+     GLES2_VALIDATE( ANTIALIAS );
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_init_dispatch( GLES2DeviceData *dev )
+{
+     GLES2AccelClass  ac;
+     GLES2DispatchKey key;
+
+     for (ac = GLES2AC_DRAW; ac < NUM_ACCEL_CLASSES; ac++) {
+          for (key = GLES2DK_NONE; key < NUM_DISPATCH_KEYS; key++) {
+               GLES2Dispatch *dispatch  = &dev->dispatch[ac][key];
+               bool           blend     = key & GLES2DK_BLEND;
+               bool           antialias = key & GLES2DK_ANTIALIAS &&
+                                          !(key & (GLES2DK_COLORKEY | GLES2DK_DST_PREMUL | GLES2DK_FETCH |
+                                                   GLES2DK_COLORMATRIX | GLES2DK_CONVOLUTION));
+               bool           scale     = ac == GLES2AC_STRETCHBLIT && key & GLES2DK_SCALE && !antialias &&
+                                          !(key & (GLES2DK_COLORKEY | GLES2DK_PREMULTIPLY | GLES2DK_FETCH |
+                                                   GLES2DK_COLORMATRIX | GLES2DK_CONVOLUTION));
+
+               if (ac == GLES2AC_DRAW) {
+                    if (key & GLES2DK_FETCH)
+                         dispatch->prog_index = (key & GLES2DK_MATRIX) ? DRAW_FETCH_MAT : DRAW_FETCH;
+                    else if (antialias)
+                         dispatch->prog_index = (key & GLES2DK_MATRIX) ? DRAW_AA_MAT : DRAW_AA;
+                    else
+                         dispatch->prog_index = (key & GLES2DK_MATRIX) ? DRAW_MAT : DRAW;
+
+                    dispatch->validation = DESTINATION | CLIP | MATRIX | COLOR_DRAW;
+                    dispatch->filter     = GL_NEAREST;
+               }
+               else {
+                    if (key & GLES2DK_FETCH)
+                         dispatch->prog_index = BLIT_FETCH;
+                    else if (antialias)
+                         dispatch->prog_index = BLIT_AA;
+                    else if (scale)
+                         dispatch->prog_index = BLIT_SCALE;
+                    else if (key & GLES2DK_COLORKEY && !blend)
+                         dispatch->prog_index = BLIT_COLORKEY;
+                    else if (key & GLES2DK_CONVOLUTION)
+                         dispatch->prog_index = BLIT_CONVOLUTION;
+                    else if (key & GLES2DK_COLORMATRIX)
+                         dispatch->prog_index = BLIT_COLORMATRIX;
+                    else if (key & GLES2DK_PREMULTIPLY)
+                         dispatch->prog_index = BLIT_PREMULTIPLY;
+                    else if (key & GLES2DK_COLOR)
+                         dispatch->prog_index = BLIT_COLOR;
+                    else
+                         dispatch->prog_index = BLIT;
+
+                    /* Each blit program is followed by its render options matrix variant. */
+                    if (key & GLES2DK_MATRIX)
+                         dispatch->prog_index++;
+
+                    dispatch->validation = DESTINATION | CLIP | MATRIX | SOURCE | COLOR_BLIT;
+
+                    /* If normal blitting, color keying or a scaler is used, don't use filtering. Otherwise the
+                       filtering of scaled sources is chosen by the smooth scaling render options. */
+                    if ((ac == GLES2AC_BLIT && !(key & GLES2DK_MATRIX)) || (key & GLES2DK_COLORKEY && !blend) || scale)
+                         dispatch->filter = GL_NEAREST;
+                    else
+                         dispatch->filter = GL_LINEAR;
+               }
+
+               if (key & GLES2DK_FETCH) {
+                    dispatch->validation |= FETCH;
+                    dispatch->blend       = GLES2BM_FETCH;
+               }
+               else if (blend && key & GLES2DK_DST_PREMUL) {
+                    dispatch->blend       = GLES2BM_DST_PREMUL;
+               }
+               else if (blend) {
+                    dispatch->validation |= BLENDING;
+                    dispatch->blend       = GLES2BM_STATE;
+               }
+               else if (ac != GLES2AC_DRAW && key & GLES2DK_COLORKEY) {
+                    dispatch->validation |= COLORKEY;
+                    dispatch->blend       = GLES2BM_COLORKEY;
+               }
+               else if (antialias) {
+                    dispatch->blend       = GLES2BM_COVERAGE;
+               }
+               else {
+                    dispatch->blend       = GLES2BM_DISABLED;
+               }
+
+               if (antialias)
+                    dispatch->validation |= ANTIALIAS;
+
+               if (dispatch->prog_index == BLIT_COLORMATRIX || dispatch->prog_index == BLIT_COLORMATRIX_MAT)
+                    dispatch->validation |= COLORMATRIX;
+
+               if (dispatch->prog_index == BLIT_CONVOLUTION || dispatch->prog_index == BLIT_CONVOLUTION_MAT)
+                    dispatch->validation |= CONVOLUTION;
+          }
+     }
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Point the vertex attributes to client arrays, which are copied to the ring buffer of the context on the OpenGL ES 3.x
+ * path.
+ */
+static void
+gles2_vertex_arrays( GLES2DriverData        *drv,
+                     const GLES2VertexArray *arrays,
+                     unsigned int            num )
+{
+     unsigned int i;
+
+     if (drv->es3) {
+          gles2_es3_arrays( drv, arrays, num );
+          return;
+     }
+
+     for (i = 0; i < num; i++)
+          glVertexAttribPointer( arrays[i].index, arrays[i].size, GL_FLOAT, GL_FALSE, arrays[i].stride, arrays[i].data );
+}
+
+static inline void
+gles2_vertex_positions( GLES2DriverData *drv,
+                        const GLfloat   *pos,
+                        unsigned int     num )
+{
+     GLES2VertexArray array = { GLES2VA_POSITIONS, 2, 0, pos, num * 2 * sizeof(GLfloat) };
+
+     gles2_vertex_arrays( drv, &array, 1 );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Anti-aliased primitives.
+ *
+ * A convex polygon of up to four vertices is expanded by the margin to include the partially covered pixels along its
+ * edges. Each vertex gets its distances to the edges (positive inside), from which the fragment shader computes the
+ * coverage, and texture coordinates are extrapolated. The polygon is emitted as triangles, so that several polygons
+ * can be drawn at once.
+ */
+
+/* Distance to an unused edge. */
+#define GLES2_EDGE_NONE 8192.0f
+
+/*
+ * Expansion by at least one pixel in each direction, in local units: the inverse of the smallest singular value of the
+ * linear part of the render options matrix.
+ */
+static float
+gles2_aa_margin( const GLES2PendingState *state )
+{
+     float a, b, c, d, s, t;
+
+     if (!(state->render_options & DSRO_MATRIX))
+          return 1.0f;
+
+     a = state->matrix[0] / 65536.0f;
+     b = state->matrix[1] / 65536.0f;
+     c = state->matrix[3] / 65536.0f;
+     d = state->matrix[4] / 65536.0f;
+
+     s = a * a + b * b + c * c + d * d;
+     t = a * d - b * c;
+
+     /* Smallest eigenvalue of the matrix multiplied by its transpose, limited for degenerate matrices. */
+     s = (s - sqrtf( D_MAX( s * s - 4.0f * t * t, 0.0f ) )) / 2.0f;
+
+     return 1.0f / sqrtf( D_MAX( s, 1.0f / 4096.0f ) );
+}
+
+/*
+ * Emit the triangles of a polygon given by 'num' points, with optional texture coordinates. Returns the number of
+ * vertices, 0 if the polygon is degenerate.
+ */
+static unsigned int
+gles2_aa_polygon( const GLfloat *points,
+                  const GLfloat *texcoords,
+                  unsigned int   num,
+                  float          margin,
+                  GLfloat       *pos,
+                  GLfloat       *tex,
+                  GLfloat       *edges )
+{
+     static const unsigned int order[6] = { 0, 1, 2, 0, 2, 3 };
+
+     GLfloat      p[8], t[8], n[8], v[8];
+     float        area = 0.0f;
+     unsigned int i, j, k, count = 0;
+
+     D_ASSERT( num <= 4 );
+
+     /* Drop repeated points. */
+     for (i = 0; i < num; i++) {
+          if (count && points[i*2] == p[count*2-2] && points[i*2+1] == p[count*2-1])
+               continue;
+
+          p[count*2]   = points[i*2];
+          p[count*2+1] = points[i*2+1];
+
+          if (texcoords) {
+               t[count*2]   = texcoords[i*2];
+               t[count*2+1] = texcoords[i*2+1];
+          }
+
+          count++;
+     }
+
+     if (count > 1 && p[count*2-2] == p[0] && p[count*2-1] == p[1])
+          count--;
+
+     if (count < 3)
+          return 0;
+
+     for (i = 0; i < count; i++) {
+          j = (i + 1) % count;
+
+          area += p[i*2] * p[j*2+1] - p[j*2] * p[i*2+1];
+     }
+
+     if (area == 0.0f)
+          return 0;
+
+     /* Unit normal of each edge pointing inside, depending on the orientation. */
+     for (i = 0; i < count; i++) {
+          float dx, dy, l;
+
+          j  = (i + 1) % count;
+          dx = p[j*2]   - p[i*2];
+          dy = p[j*2+1] - p[i*2+1];
+          l  = sqrtf( dx * dx + dy * dy );
+
+          if (area < 0.0f)
+               l = -l;
+
+          n[i*2]   = -dy / l;
+          n[i*2+1] =  dx / l;
+     }
+
+     /* Move each vertex to the intersection of its edges moved outwards by the margin, limited for acute angles. */
+     for (i = 0; i < count; i++) {
+          const GLfloat *na = &n[((i + count - 1) % count) * 2];
+          const GLfloat *nb = &n[i*2];
+          float          f  = margin / D_MAX( 1.0f + na[0] * nb[0] + na[1] * nb[1], 0.125f );
+
+          v[i*2]   = p[i*2]   - f * (na[0] + nb[0]);
+          v[i*2+1] = p[i*2+1] - f * (na[1] + nb[1]);
+     }
+
+     for (k = 0; k < (count - 2) * 3; k++) {
+          i = order[k];
+
+          pos[k*2]   = v[i*2];
+          pos[k*2+1] = v[i*2+1];
+
+          for (j = 0; j < 4; j++) {
+               if (j < count)
+                    edges[k*4+j] = (v[i*2] - p[j*2]) * n[j*2] + (v[i*2+1] - p[j*2+1]) * n[j*2+1];
+               else
+                    edges[k*4+j] = GLES2_EDGE_NONE;
+          }
+     }
+
+     if (texcoords) {
+          /* Affine mapping of the positions relative to the first point to the texture coordinates. */
+          float ex = p[2] - p[0], ey = p[3] - p[1];
+          float fx = p[4] - p[0], fy = p[5] - p[1];
+          float d  = ex * fy - ey * fx;
+          int   l  = 2;
+
+          if (d == 0.0f) {
+               fx = p[6] - p[0];
+               fy = p[7] - p[1];
+               d  = ex * fy - ey * fx;
+               l  = 3;
+          }
+
+          for (k = 0; k < (count - 2) * 3; k++) {
+               float qx = pos[k*2]   - p[0];
+               float qy = pos[k*2+1] - p[1];
+               float a  = (qx * fy - qy * fx) / d;
+               float b  = (ex * qy - ey * qx) / d;
+
+               tex[k*2]   = t[0] + a * (t[2] - t[0]) + b * (t[l*2]   - t[0]);
+               tex[k*2+1] = t[1] + a * (t[3] - t[1]) + b * (t[l*2+1] - t[1]);
+          }
+     }
+
+     return (count - 2) * 3;
+}
+
+static void
+gles2_aa_draw( GLES2DriverData *drv,
+               const GLfloat   *pos,
+               const GLfloat   *tex,
+               const GLfloat   *edges,
+               unsigned int     num )
+{
+     GLES2VertexArray arrays[] = {
+          { GLES2VA_POSITIONS, 2, 0, pos,   num * 2 * sizeof(GLfloat) },
+          { GLES2VA_EDGES,     4, 0, edges, num * 4 * sizeof(GLfloat) },
+          { GLES2VA_TEXCOORDS, 2, 0, tex,   num * 2 * sizeof(GLfloat) }
+     };
+
+     if (!num)
+          return;
+
+     gles2_vertex_arrays( drv, arrays, tex ? 3 : 2 );
+
+     glDrawArrays( GL_TRIANGLES, 0, num );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Pending commands.
+ *
+ * SetState(), FillRectangle(), BatchFill() and Blit() are queued and executed in submission order, other functions
+ * execute the pending commands first. Commands rendering into offscreen surfaces only are kept across operations until
+ * the serial of the batch is waited for, the texture cache is flushed or the queue is full, others are executed when
+ * the commands are emitted. Queued primitives covered by a later opaque primitive with the
+ * same destination and clip are dropped. A primitive is drawn with the primitives of an earlier equal state instead,
+ * if the primitives in between neither overlap it in the destination nor depend on it as a source.
+ */
+
+static void
+gles2_apply_state( GLES2DriverData         *drv,
+                   GLES2DeviceData         *dev,
+                   const GLES2PendingState *state )
+{
+     const GLES2Dispatch *dispatch = state->dispatch;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %p ) <- mod_hw 0x%08x\n", __FUNCTION__, state, state->mod_hw );
+
+     drv->blittingflags = state->blittingflags;
+
+     /*
+      * 1) Invalidate hardware states
       *
       * Each modification to the hw independent state invalidates one or more hardware states.
       */
@@ -497,216 +1218,1672 @@ gles2SetState( void                *driver_data,
           if (state->mod_hw & SMF_SOURCE)
                GLES2_INVALIDATE( SOURCE );
 
+          if (state->mod_hw & (SMF_SRC_COLORMATRIX | SMF_BLITTING_FLAGS))
+               GLES2_INVALIDATE( COLORMATRIX );
+
+          if (state->mod_hw & (SMF_SRC_CONVOLUTION | SMF_BLITTING_FLAGS))
+               GLES2_INVALIDATE( CONVOLUTION );
+
           if (state->mod_hw & (SMF_SRC_BLEND | SMF_DST_BLEND))
                GLES2_INVALIDATE( BLENDING );
+
+          if (state->mod_hw & (SMF_SRC_BLEND | SMF_DST_BLEND | SMF_DRAWING_FLAGS | SMF_BLITTING_FLAGS))
+               GLES2_INVALIDATE( FETCH | ANTIALIAS );
+     }
+
+     /* The atlas page holding a copy of the source is bound instead of the source texture. */
+     if (drv->atlas.bound != state->page) {
+          drv->atlas.bound = state->page;
+
+          GLES2_INVALIDATE( SOURCE );
      }
 
      /*
       * 2) Validate hardware states
       *
-      * Each function has its own set of states that need to be validated.
+      * Each function has its own set of states that need to be validated, looked up in the dispatch table by SetState().
       */
 
-     switch (accel) {
-          case DFXL_FILLRECTANGLE:
-          case DFXL_DRAWRECTANGLE:
-          case DFXL_DRAWLINE:
-          case DFXL_FILLTRIANGLE:
-               /* Use of alpha blending. */
-               if (state->drawingflags & DSDRAW_BLEND)
-                    blend = DFB_TRUE;
-               else
-                    blend = DFB_FALSE;
+     /* Validate the current shader program to use and check the states to validate. */
+     if (drv->context->prog_index != dispatch->prog_index) {
+          drv->context->prog_index = dispatch->prog_index;
+          glUseProgram( dev->progs[dispatch->prog_index].obj );
+     }
 
-               /* Validate the current shader program to use and check the states to validate. */
-               if (state->render_options & DSRO_MATRIX) {
-                    if (dev->prog_index != DRAW_MAT) {
-                         dev->prog_index = DRAW_MAT;
-                         glUseProgram( dev->progs[dev->prog_index].obj );
-                    }
-               }
-               else {
-                    if (dev->prog_index != DRAW) {
-                         dev->prog_index = DRAW;
-                         glUseProgram( dev->progs[dev->prog_index].obj );
-                    }
-               }
+     D_DEBUG_AT( GLES2_2D, "  -> using shader program \"%s\"\n", dev->progs[dispatch->prog_index].name );
 
-               D_DEBUG_AT( GLES2_2D, "  -> using shader program \"%s\"\n", dev->progs[dev->prog_index].name );
+     GLES2_CHECK_VALIDATE( DESTINATION );
+     GLES2_CHECK_VALIDATE( CLIP );
+     GLES2_CHECK_VALIDATE( MATRIX );
 
-               GLES2_CHECK_VALIDATE( DESTINATION );
-               GLES2_CHECK_VALIDATE( CLIP );
-               GLES2_CHECK_VALIDATE( MATRIX );
-               GLES2_CHECK_VALIDATE( COLOR_DRAW );
+     if (dispatch->validation & COLOR_DRAW)
+          GLES2_CHECK_VALIDATE( COLOR_DRAW );
 
-               if (blend) {
-                    GLES2_CHECK_VALIDATE( BLENDING );
-                    glEnable( GL_BLEND );
-               }
-               else {
-                    glDisable( GL_BLEND );
-               }
+     if (dispatch->validation & SOURCE)
+          GLES2_CHECK_VALIDATE( SOURCE );
 
-               /* Enable vertex positions and disable texture coordinates. */
-               glEnableVertexAttribArray( GLES2VA_POSITIONS );
-               glDisableVertexAttribArray( GLES2VA_TEXCOORDS );
+     if (dispatch->validation & COLOR_BLIT)
+          GLES2_CHECK_VALIDATE( COLOR_BLIT );
 
-               /*
-                * 3) Tell which functions can be called without further validation, i.e. SetState()
-                *
-                * When the hw independent state is changed, this collection is reset.
-                */
+     if (dispatch->validation & COLORMATRIX)
+          GLES2_CHECK_VALIDATE( COLORMATRIX );
 
-               state->set = DFXL_FILLRECTANGLE | DFXL_DRAWRECTANGLE | DFXL_DRAWLINE | DFXL_FILLTRIANGLE;
-               break;
+     if (dispatch->validation & CONVOLUTION)
+          GLES2_CHECK_VALIDATE( CONVOLUTION );
 
-          case DFXL_BLIT:
-          case DFXL_STRETCHBLIT:
-               /* Use of alpha blending. */
-               if (state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA))
-                    blend = DFB_TRUE;
-               else
-                    blend = DFB_FALSE;
-
-               /* Validate the current shader program to use and check the states to validate. */
-               if (state->render_options & DSRO_MATRIX) {
-                    if (state->blittingflags & DSBLIT_SRC_COLORKEY && !blend) {
-                         if (dev->prog_index != BLIT_COLORKEY_MAT) {
-                              dev->prog_index = BLIT_COLORKEY_MAT;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else if (state->blittingflags & DSBLIT_SRC_PREMULTIPLY) {
-                         if (dev->prog_index != BLIT_PREMULTIPLY_MAT) {
-                              dev->prog_index = BLIT_PREMULTIPLY_MAT;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else if (state->blittingflags & (DSBLIT_COLORIZE | DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTCOLOR)) {
-                         if (dev->prog_index != BLIT_COLOR_MAT) {
-                              dev->prog_index = BLIT_COLOR_MAT;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else {
-                         if (dev->prog_index != BLIT_MAT) {
-                              dev->prog_index = BLIT_MAT;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-               }
-               else {
-                    if (state->blittingflags & DSBLIT_SRC_COLORKEY && !blend) {
-                         if (dev->prog_index != BLIT_COLORKEY) {
-                              dev->prog_index = BLIT_COLORKEY;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else if (state->blittingflags & DSBLIT_SRC_PREMULTIPLY) {
-                         if (dev->prog_index != BLIT_PREMULTIPLY) {
-                              dev->prog_index = BLIT_PREMULTIPLY;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else if (state->blittingflags & (DSBLIT_COLORIZE | DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTCOLOR)) {
-                         if (dev->prog_index != BLIT_COLOR) {
-                              dev->prog_index = BLIT_COLOR;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-                    else {
-                         if (dev->prog_index != BLIT) {
-                              dev->prog_index = BLIT;
-                              glUseProgram( dev->progs[dev->prog_index].obj );
-                         }
-                    }
-               }
+     if (dispatch->validation & ANTIALIAS)
+          GLES2_CHECK_VALIDATE( ANTIALIAS );
 
-               D_DEBUG_AT( GLES2_2D, "  -> using shader program \"%s\"\n", dev->progs[dev->prog_index].name );
+     switch (dispatch->blend) {
+          case GLES2BM_STATE:
+               GLES2_CHECK_VALIDATE( BLENDING );
+               glEnable( GL_BLEND );
+               break;
 
-               GLES2_CHECK_VALIDATE( DESTINATION );
-               GLES2_CHECK_VALIDATE( CLIP );
-               GLES2_CHECK_VALIDATE( MATRIX );
-               GLES2_CHECK_VALIDATE( SOURCE );
-               GLES2_CHECK_VALIDATE( COLOR_BLIT );
+          case GLES2BM_COLORKEY:
+               GLES2_CHECK_VALIDATE( COLORKEY );
+               glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+               glEnable( GL_BLEND );
 
-               if (blend) {
-                    GLES2_CHECK_VALIDATE( BLENDING );
-                    glEnable( GL_BLEND );
-               }
-               else {
-                    if (state->blittingflags & DSBLIT_SRC_COLORKEY) {
-                         GLES2_CHECK_VALIDATE( COLORKEY );
-                         glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-                         glEnable( GL_BLEND );
-                    }
-                    else {
-                         glDisable( GL_BLEND );
-                    }
-               }
+               /* The blend functions of the state have been overridden. */
+               GLES2_INVALIDATE( BLENDING );
+               break;
 
-               /* If normal blitting or color keying is used, don't use filtering. */
-               if (accel == DFXL_BLIT || ((state->blittingflags & DSBLIT_SRC_COLORKEY) && !blend)) {
-                    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-                    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-               }
-               else {
-                    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-                    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-               }
+          case GLES2BM_DST_PREMUL:
+               /* Premultiply the destination color by the destination alpha instead of adding it as is. */
+               glBlendFuncSeparate( gles2_blend_factor( state->src_blend ), GL_DST_ALPHA,
+                                    gles2_blend_factor( state->src_blend ), GL_ONE );
+               glEnable( GL_BLEND );
 
-               /* Enable vertex positions and disable texture coordinates. */
-               glEnableVertexAttribArray( GLES2VA_POSITIONS );
-               glEnableVertexAttribArray( GLES2VA_TEXCOORDS );
+               /* The blend functions of the state have been overridden. */
+               GLES2_INVALIDATE( BLENDING );
+               break;
 
-               /*
-                * 3) Tell which functions can be called without further validation, i.e. SetState()
-                *
-                * When the hw independent state is changed, this collection is reset.
-                */
+          case GLES2BM_FETCH:
+               GLES2_CHECK_VALIDATE( FETCH );
+               glDisable( GL_BLEND );
+               break;
 
-               state->set = accel;
+          case GLES2BM_COVERAGE:
+               /* Mix the color with the destination by the coverage, the alpha by the coverage of the alpha of the
+                  drawing color or of the blit source, which has no alpha channel. */
+               glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_CONSTANT_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+               glBlendColor( 0.0f, 0.0f, 0.0f, (dispatch->validation & SOURCE) ? 1.0f : state->color.a / 255.0f );
+               glEnable( GL_BLEND );
+
+               /* The blend functions of the state have been overridden. */
+               GLES2_INVALIDATE( BLENDING );
                break;
 
           default:
-               D_BUG( "unexpected drawing/blitting function" );
+               glDisable( GL_BLEND );
                break;
      }
 
-     /*
-      * 4) Clear modification flags
-      *
-      * All flags have been evaluated in 1) and remembered for further validation.
-      * If the hw independent state is not modified, this function won't get called
-      * for subsequent rendering functions, unless they aren't defined by 3).
-      */
+     if (dispatch->validation & SOURCE) {
+          GLenum min_filter = dispatch->filter;
+          GLenum mag_filter = dispatch->filter;
+
+          /* Filter reduced and enlarged sources only if requested, otherwise pixels are replicated or skipped. */
+          if (dispatch->filter == GL_LINEAR) {
+               if (!(state->render_options & DSRO_SMOOTH_DOWNSCALE))
+                    min_filter = GL_NEAREST;
+
+               if (!(state->render_options & DSRO_SMOOTH_UPSCALE))
+                    mag_filter = GL_NEAREST;
+          }
+
+          /* The parameters of the texture are ignored while a sampler object is bound. */
+          if (drv->es3) {
+               gles2_es3_sampler( drv, min_filter, mag_filter );
+          }
+          else {
+               glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter );
+               glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter );
+          }
+
+          /* Remember the source for StretchBlit() minification. */
+          drv->source     = state->src_allocation;
+          drv->source_tex = state->src_tex;
+          drv->filter     = min_filter;
+          drv->min_filter = min_filter;
+          drv->mag_filter = mag_filter;
+
+          /* Enable vertex positions and texture coordinates. */
+          if (!drv->es3) {
+               glEnableVertexAttribArray( GLES2VA_POSITIONS );
+               glEnableVertexAttribArray( GLES2VA_TEXCOORDS );
+          }
+     }
+     else if (!drv->es3) {
+          /* Enable vertex positions and disable texture coordinates. */
+          glEnableVertexAttribArray( GLES2VA_POSITIONS );
+          glDisableVertexAttribArray( GLES2VA_TEXCOORDS );
+     }
+
+     /* Primitives not instanced are drawn in the unit rectangle at their source position, set once per context. */
+     if (!drv->context->rects) {
+          glVertexAttrib4f( GLES2VA_RECTS, 0.0f, 0.0f, 1.0f, 1.0f );
+          glVertexAttrib2f( GLES2VA_TEXPOS, 0.0f, 0.0f );
+
+          /* The divisors are recorded in the vertex array objects on the OpenGL ES 3.x path. */
+          if (drv->VertexAttribDivisor && !drv->es3) {
+               drv->VertexAttribDivisor( GLES2VA_RECTS, 1 );
+               drv->VertexAttribDivisor( GLES2VA_TEXPOS, 1 );
+          }
+
+          drv->context->rects = true;
+     }
+
+     drv->antialias = dispatch->validation & ANTIALIAS;
+
+     if (drv->antialias)
+          drv->margin = gles2_aa_margin( state );
+
+     /* Enable the edge distances of anti-aliased primitives, disabled again only if they have been enabled. On the
+        OpenGL ES 3.x path, the vertex array object of the layout is bound instead. */
+     if (drv->es3) {
+          gles2_es3_layout( drv, dispatch->validation & SOURCE, drv->antialias );
+     }
+     else if (drv->antialias) {
+          if (!drv->context->edges) {
+               glEnableVertexAttribArray( GLES2VA_EDGES );
+               drv->context->edges = true;
+          }
+     }
+     else if (drv->context->edges) {
+          glDisableVertexAttribArray( GLES2VA_EDGES );
+          drv->context->edges = false;
+     }
+
+     /* Time batches per program and destination. */
+     gles2_stats_batch( drv, dev, state->surface_id );
+}
+
+/*
+ * Draw a quadrangle given by its corners, with texture coordinates for blits.
+ */
+static void
+gles2_draw_quad( GLES2DriverData *drv,
+                 const GLfloat   *pos,
+                 const GLfloat   *tex )
+{
+     GLES2VertexArray arrays[] = {
+          { GLES2VA_POSITIONS, 2, 0, pos, 8 * sizeof(GLfloat) },
+          { GLES2VA_TEXCOORDS, 2, 0, tex, 8 * sizeof(GLfloat) }
+     };
+
+     if (drv->antialias) {
+          GLfloat      aa_pos[12];
+          GLfloat      aa_tex[12];
+          GLfloat      edges[24];
+          unsigned int num;
+
+          num = gles2_aa_polygon( pos, tex, 4, drv->margin, aa_pos, aa_tex, edges );
+
+          gles2_aa_draw( drv, aa_pos, tex ? aa_tex : NULL, edges, num );
+          return;
+     }
+
+     gles2_vertex_arrays( drv, arrays, tex ? 2 : 1 );
+
+     glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
+}
+
+/*
+ * Texture coordinates of the corners of a blit destination, in the order given by the rotation.
+ */
+static void
+gles2_texcoords( GLES2DriverData    *drv,
+                 const DFBRectangle *rect,
+                 GLfloat            *tex )
+{
+     float tx1 = rect->x;
+     float ty1 = rect->y;
+     float tx2 = rect->w + tx1;
+     float ty2 = rect->h + ty1;
+
+     if (drv->blittingflags & DSBLIT_ROTATE180) {
+          tex[0] = tx2; tex[1] = ty2;
+          tex[2] = tx1; tex[3] = ty2;
+          tex[4] = tx1; tex[5] = ty1;
+          tex[6] = tx2; tex[7] = ty1;
+     }
+     else if (drv->blittingflags & DSBLIT_ROTATE90) {
+          tex[0] = tx2; tex[1] = ty1;
+          tex[2] = tx2; tex[3] = ty2;
+          tex[4] = tx1; tex[5] = ty2;
+          tex[6] = tx1; tex[7] = ty1;
+     }
+     else if (drv->blittingflags & DSBLIT_ROTATE270) {
+          tex[0] = tx1; tex[1] = ty2;
+          tex[2] = tx1; tex[3] = ty1;
+          tex[4] = tx2; tex[5] = ty1;
+          tex[6] = tx2; tex[7] = ty2;
+     }
+     else {
+          tex[0] = tx1; tex[1] = ty1;
+          tex[2] = tx2; tex[3] = ty1;
+          tex[4] = tx2; tex[5] = ty2;
+          tex[6] = tx1; tex[7] = ty2;
+     }
+}
+
+static void
+gles2_draw_rectangle( GLES2DriverData    *drv,
+                      const DFBRectangle *rect )
+{
+     float   x1    = rect->x;
+     float   y1    = rect->y;
+     float   x2    = rect->w + x1;
+     float   y2    = rect->h + y1;
+     GLfloat pos[] = {
+          x1, y1,
+          x2, y1,
+          x2, y2,
+          x1, y2
+     };
+
+     gles2_draw_quad( drv, pos, NULL );
+}
+
+/*
+ * Clear the clip with the color of the state, used for opaque rectangles covering the clip. The scissor test is
+ * always enabled by the clip validation and glClear() allows tile based GPUs to skip loading the previous contents.
+ */
+static void
+gles2_clear( const GLES2PendingState *state )
+{
+     if (state->drawingflags & DSDRAW_SRC_PREMULTIPLY) {
+          /* Same as the premultiplied color loaded for drawing. */
+          GLfloat a = state->color.a / 65025.0f;
+
+          glClearColor( state->color.r * a, state->color.g * a, state->color.b * a, state->color.a / 255.0f );
+     }
+     else {
+          GLfloat s = 1.0f / 255.0f;
+
+          glClearColor( state->color.r * s, state->color.g * s, state->color.b * s, state->color.a * s );
+     }
+
+     glClear( GL_COLOR_BUFFER_BIT );
+}
+
+static void
+gles2_draw_blit( GLES2DriverData    *drv,
+                 const DFBRectangle *rect,
+                 int                 dx,
+                 int                 dy )
+{
+     float   x1    = dx;
+     float   y1    = dy;
+     float   x2    = rect->w + x1;
+     float   y2    = rect->h + y1;
+     GLfloat pos[] = {
+          x1, y1,
+          x2, y1,
+          x2, y2,
+          x1, y2
+     };
+     GLfloat tex[8];
+
+     gles2_texcoords( drv, rect, tex );
+
+     gles2_draw_quad( drv, pos, tex );
+}
+
+/*
+ * Corners of the unit square drawn for each instance, and the corners of the source rectangle in the order given by
+ * the rotation, like gles2_texcoords() does.
+ */
+static const GLfloat unit_corners[] = {
+     0.0f, 0.0f,  1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 1.0f
+};
+
+static const GLfloat unit_texcoords[4][8] = {
+     { 0.0f, 0.0f,  1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 1.0f }, /* DSBLIT_NOFX */
+     { 1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 1.0f,  0.0f, 0.0f }, /* DSBLIT_ROTATE90 */
+     { 1.0f, 1.0f,  0.0f, 1.0f,  0.0f, 0.0f,  1.0f, 0.0f }, /* DSBLIT_ROTATE180 */
+     { 0.0f, 1.0f,  0.0f, 0.0f,  1.0f, 0.0f,  1.0f, 1.0f }  /* DSBLIT_ROTATE270 */
+};
+
+/*
+ * Draw rectangles as instances of the unit square, each given by its destination position and size, followed by its
+ * source position for blits. The rectangle attributes are set back to their constant values afterwards.
+ */
+static void
+gles2_draw_instances( GLES2DriverData *drv,
+                      const GLfloat   *instances,
+                      unsigned int     num,
+                      bool             blit )
+{
+     GLsizei          stride   = (blit ? 6 : 4) * sizeof(GLfloat);
+     GLES2VertexArray arrays[] = {
+          { GLES2VA_POSITIONS, 2, 0,      unit_corners,      sizeof(unit_corners) },
+          { GLES2VA_RECTS,     4, stride, instances,         num * stride },
+          { GLES2VA_TEXPOS,    2, stride, instances + 4,     num * stride - 4 * sizeof(GLfloat) },
+          { GLES2VA_TEXCOORDS, 2, 0,      unit_texcoords[0], sizeof(unit_texcoords[0]) }
+     };
+
+     if (blit) {
+          if (drv->blittingflags & DSBLIT_ROTATE180)
+               arrays[3].data = unit_texcoords[2];
+          else if (drv->blittingflags & DSBLIT_ROTATE90)
+               arrays[3].data = unit_texcoords[1];
+          else if (drv->blittingflags & DSBLIT_ROTATE270)
+               arrays[3].data = unit_texcoords[3];
+
+          glEnableVertexAttribArray( GLES2VA_TEXPOS );
+     }
+
+     gles2_vertex_arrays( drv, arrays, blit ? 4 : 2 );
+
+     glEnableVertexAttribArray( GLES2VA_RECTS );
+
+     drv->DrawArraysInstanced( GL_TRIANGLE_FAN, 0, 4, num );
+
+     /* The current values of attributes drawn from arrays are undefined afterwards. */
+     glDisableVertexAttribArray( GLES2VA_RECTS );
+     glVertexAttrib4f( GLES2VA_RECTS, 0.0f, 0.0f, 1.0f, 1.0f );
+
+     if (blit) {
+          glDisableVertexAttribArray( GLES2VA_TEXPOS );
+          glVertexAttrib2f( GLES2VA_TEXPOS, 0.0f, 0.0f );
+     }
+}
+
+/*
+ * Tell the GL that the previous contents of the destination are not needed, if the whole destination is covered by
+ * an opaque primitive. Tile based GPUs don't need to load them.
+ */
+static void
+gles2_discard( GLES2DriverData         *drv,
+               const GLES2PendingState *state )
+{
+     GLenum attachment = drv->offscreen ? GL_COLOR_ATTACHMENT0 : GL_COLOR_EXT;
+
+     if (state->clip.x1 > 0 || state->clip.y1 > 0 ||
+         state->clip.x2 < state->dst_size.w - 1 || state->clip.y2 < state->dst_size.h - 1)
+          return;
+
+     D_DEBUG_AT( GLES2_2D, "  -> discarding %s\n", drv->offscreen ? "color attachment" : "color buffer" );
+
+     drv->DiscardFramebufferEXT( GL_FRAMEBUFFER, 1, &attachment );
+}
+
+/*
+ * Destination region of a pending primitive, not clipped.
+ */
+static void
+gles2_pending_region( const GLES2PendingCommand *command,
+                      DFBRegion                 *region )
+{
+     region->x1 = command->point.x;
+     region->y1 = command->point.y;
+     region->x2 = command->point.x + command->rect.w - 1;
+     region->y2 = command->point.y + command->rect.h - 1;
+}
+
+/*
+ * Check for an opaque primitive covering the clip, the scissor is not rotated with the layer though.
+ */
+static bool
+gles2_pending_covered( const GLES2DriverData     *drv,
+                       const GLES2PendingState   *state,
+                       const GLES2PendingCommand *command )
+{
+     const DFBRegion *clip = &state->clip;
+     DFBRegion        region;
+
+     if (!state->opaque || (!drv->offscreen && drv->rotation))
+          return false;
+
+     gles2_pending_region( command, &region );
+
+     return region.x1 <= clip->x1 && region.y1 <= clip->y1 && region.x2 >= clip->x2 && region.y2 >= clip->y2;
+}
+
+/*
+ * Draw a primitive and the following ones of the same type, not separated by a state change, as instances, stopping
+ * at a primitive covering the clip. Returns the index of the last command drawn.
+ */
+static unsigned int
+gles2_pending_instances( GLES2DriverData    *drv,
+                         const GLES2Pending *pending,
+                         unsigned int        index )
+{
+     const GLES2PendingCommand *first = &pending->commands[index];
+     const GLES2PendingState   *state = &pending->states[first->state];
+     bool                       blit  = first->type == GLES2PC_BLIT;
+     GLfloat                    instances[GLES2_PENDING_COMMANDS*6];
+     GLfloat                   *rect  = instances;
+     unsigned int               i, last = index, num = 0;
+
+     for (i = index; i < pending->num_commands; i++) {
+          const GLES2PendingCommand *command = &pending->commands[i];
+
+          if (command->type != first->type)
+               break;
+
+          if (command->culled)
+               continue;
+
+          if (i > index && gles2_pending_covered( drv, state, command ))
+               break;
+
+          rect[0] = command->point.x;
+          rect[1] = command->point.y;
+          rect[2] = command->rect.w;
+          rect[3] = command->rect.h;
+
+          if (blit) {
+               rect[4] = command->rect.x;
+               rect[5] = command->rect.y;
+               rect += 6;
+          }
+          else
+               rect += 4;
+
+          last = i;
+          num++;
+     }
+
+     if (num > 1)
+          gles2_draw_instances( drv, instances, num, blit );
+     else if (blit)
+          gles2_draw_blit( drv, &first->rect, first->point.x, first->point.y );
+     else
+          gles2_draw_rectangle( drv, &first->rect );
+
+     return last;
+}
+
+/*
+ * Execute a batch, the last state stays in effect for further primitives. When the batch is executed in another
+ * context than the previous one, all hardware states are validated again.
+ */
+void
+gles2_pending_execute( GLES2DriverData *drv,
+                       GLES2DeviceData *dev,
+                       GLES2Pending    *pending,
+                       GLES2Context    *context )
+{
+     unsigned int i, n;
+
+     gles2_context_switch( drv, context );
+
+     gles2_fbo_drain( drv );
+
+     if (!pending->num_commands && !pending->num_uploads)
+          return;
+
+     context->issued = true;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %u commands, %u states )\n", __FUNCTION__, pending->num_commands, pending->num_states );
+
+     /* The system module may have bound another framebuffer during the operations the batch has been kept across,
+        bind the destination of the state carried over from the previous batch again. */
+     if (pending->kept) {
+          GLES2_INVALIDATE( DESTINATION );
+
+          drv->reapply = true;
+     }
+     else
+          gles2_fbo_rebind( drv );
+
+     /* Copy the sources blitted from atlas pages first, none of the commands renders into them. */
+     if (pending->num_uploads)
+          gles2_atlas_upload( drv, pending->uploads, pending->num_uploads );
+
+     for (i = 0; i < pending->num_commands; i++) {
+          GLES2PendingCommand *command = &pending->commands[i];
+          GLES2PendingState   *state   = &pending->states[command->state];
+          bool                 covered;
+
+          switch (command->type) {
+               case GLES2PC_STATE:
+                    /* Skip a state whose primitives have all been culled, its modifications apply to the next one. */
+                    for (n = i + 1; n < pending->num_commands; n++) {
+                         if (pending->commands[n].type == GLES2PC_STATE || !pending->commands[n].culled)
+                              break;
+                    }
+
+                    if (n < pending->num_commands && pending->commands[n].type == GLES2PC_STATE) {
+                         pending->states[pending->commands[n].state].mod_hw |= state->mod_hw;
+                         i = n - 1;
+                         break;
+                    }
+
+                    gles2_apply_state( drv, dev, state );
+
+                    drv->reapply = false;
+                    break;
+
+               case GLES2PC_FILLRECTANGLE:
+               case GLES2PC_BLIT:
+                    if (command->culled)
+                         break;
+
+                    /* The state carried over from the previous batch has been applied before. */
+                    if (drv->reapply) {
+                         gles2_apply_state( drv, dev, state );
+
+                         drv->reapply = false;
+                    }
+
+                    covered = gles2_pending_covered( drv, state, command );
+
+                    if (covered && drv->DiscardFramebufferEXT)
+                         gles2_discard( drv, state );
+
+                    /* Following primitives are drawn at once, a covering fill is cleared instead. */
+                    if (drv->DrawArraysInstanced && !drv->antialias && !(covered && command->type != GLES2PC_BLIT))
+                         i = gles2_pending_instances( drv, pending, i );
+                    else if (command->type == GLES2PC_BLIT)
+                         gles2_draw_blit( drv, &command->rect, command->point.x, command->point.y );
+                    else if (covered)
+                         gles2_clear( state );
+                    else
+                         gles2_draw_rectangle( drv, &command->rect );
+                    break;
+          }
+     }
+}
+
+/*
+ * Start a batch with the last state of the previous one, to keep it in effect for culling of further primitives.
+ */
+static void
+gles2_pending_carry( const GLES2Pending *previous,
+                     GLES2Pending       *pending )
+{
+     if (previous->num_states > 1 || (previous->num_states && pending != previous))
+          pending->states[0] = previous->states[previous->num_states - 1];
+
+     pending->num_states   = D_MIN( previous->num_states, 1 );
+     pending->num_commands = 0;
+     pending->num_uploads  = 0;
+     pending->onscreen     = false;
+     pending->kept         = false;
+}
+
+/*
+ * Reference an allocation used by a batch kept across operations, unless it is referenced already.
+ */
+static bool
+gles2_pending_ref( GLES2Pending          *pending,
+                   CoreSurfaceAllocation *allocation )
+{
+     unsigned int i;
+
+     if (!allocation)
+          return true;
+
+     for (i = 0; i < pending->num_refs; i++) {
+          if (pending->refs[i] == allocation)
+               return true;
+     }
+
+     if (pending->num_refs == GLES2_PENDING_REFS || dfb_surface_allocation_ref( allocation ))
+          return false;
+
+     pending->refs[pending->num_refs++] = allocation;
+
+     return true;
+}
+
+/*
+ * Reference the allocations used by a batch kept across operations. They are unlocked when the operation ends, without
+ * references an allocation may be destroyed before the batch is executed and another one may get the same address.
+ * Returns false if the batch cannot be kept, states replaced in earlier operations may leave no reference free.
+ */
+static bool
+gles2_pending_reference( GLES2DriverData *drv,
+                         GLES2Pending    *pending )
+{
+     unsigned int i;
+
+     /* Allocations of the tools harness are no core objects. */
+     if (!drv->core)
+          return true;
+
+     for (i = 0; i < pending->num_states; i++) {
+          if (!gles2_pending_ref( pending, pending->states[i].dst_allocation ) ||
+              !gles2_pending_ref( pending, pending->states[i].src_allocation ))
+               return false;
+     }
+
+     for (i = 0; i < pending->num_uploads; i++) {
+          if (!gles2_pending_ref( pending, pending->uploads[i].allocation ))
+               return false;
+     }
+
+     return true;
+}
+
+/*
+ * Release the references of a batch after its execution. Destroying an allocation may wait for the serial, which
+ * flushes the batch again: the references are cleared first.
+ */
+static void
+gles2_pending_unreference( GLES2Pending *pending )
+{
+     CoreSurfaceAllocation *refs[GLES2_PENDING_REFS];
+     unsigned int           i, num_refs;
+
+     num_refs = pending->num_refs;
+     if (!num_refs)
+          return;
+
+     memcpy( refs, pending->refs, num_refs * sizeof(refs[0]) );
+
+     pending->num_refs = 0;
+
+     for (i = 0; i < num_refs; i++)
+          dfb_surface_allocation_unref( refs[i] );
+}
+
+/*
+ * Execute the pending commands in the context of the calling thread, after the batches submitted to the submission
+ * thread. Returns false if the thread has no context, the commands are executed by the next thread having one.
+ */
+static bool
+gles2_pending_run( GLES2DriverData *drv,
+                   GLES2DeviceData *dev )
+{
+     GLES2Context *context;
+
+     if (drv->async.thread)
+          gles2_async_drain( drv );
+
+     context = gles2_context_get( drv );
+     if (!context)
+          return false;
+
+     gles2_pending_execute( drv, dev, drv->pending, context );
+
+     gles2_pending_carry( drv->pending, drv->pending );
+
+     gles2_pending_unreference( drv->pending );
+
+     return true;
+}
+
+static bool
+gles2_pending_flush( GLES2DriverData *drv,
+                     GLES2DeviceData *dev )
+{
+     if (!gles2_pending_run( drv, dev ))
+          return false;
+
+     gles2_fbo_restore( drv );
+
+     gles2_context_release( drv );
+
+     return true;
+}
+
+/*
+ * Execute the pending commands and make sure the last state is in effect for a function not queued, which releases
+ * the context after issuing its commands.
+ */
+static void
+gles2_pending_prepare( GLES2DriverData *drv,
+                       GLES2DeviceData *dev )
+{
+     GLES2Pending      *pending = drv->pending;
+     GLES2PendingState *state;
+
+     gles2_pending_run( drv, dev );
+
+     gles2_fbo_rebind( drv );
+
+     if (drv->reapply) {
+          D_ASSERT( pending->num_states > 0 );
+
+          state = &pending->states[pending->num_states - 1];
+
+          gles2_apply_state( drv, dev, state );
+
+          drv->reapply = false;
+     }
+
+     drv->context->issued = true;
+}
+
+/*
+ * Called after the commands of a function not queued, the framebuffer bound by the system module is bound again and
+ * other contexts wait for the commands. With a single context they are fenced by the next flush.
+ */
+static inline void
+gles2_pending_release( GLES2DriverData *drv )
+{
+     gles2_fbo_restore( drv );
+
+     if (drv->num_contexts > 1)
+          gles2_context_release( drv );
+}
+
+/*
+ * Issue the pending commands. In asynchronous mode, a batch rendering into offscreen surfaces only is passed to the
+ * submission thread, always before the current operation ends. The allocations and textures it uses stay locked until
+ * then, later uploads or deletions wait for its serial, which waits for the submission thread.
+ *
+ * Returns false if the calling thread has no context, the queue is not emptied then. Functions queuing commands are
+ * only called for states accepted by CheckState(), which requires one.
+ */
+static bool
+gles2_pending_submit( GLES2DriverData *drv,
+                      GLES2DeviceData *dev )
+{
+     GLES2Pending *pending = drv->pending;
+     GLES2Pending *next;
+
+     if (!pending->num_commands && !pending->num_uploads)
+          return true;
+
+     if (!drv->async.thread || pending->onscreen)
+          return gles2_pending_flush( drv, dev );
+
+     /* The batch waits for a fence inserted into the context of the calling thread, after the texture uploads of the
+        sources it reads, including the ones copied into atlas pages. A thread calling the driver for the first time
+        has no context to insert the fence into yet. */
+     if (!gles2_context_get( drv ))
+          return false;
+
+     next = gles2_async_next( drv );
+
+     gles2_pending_carry( pending, next );
+
+     gles2_async_submit( drv );
+
+     drv->pending = next;
+
+     return true;
+}
+
+/*
+ * Look up the copy of the source in an atlas page for blits without scaling or filtering of neighbouring texels, and
+ * queue the copy of a new or modified source.
+ */
+static GLES2AtlasEntry *
+gles2_pending_atlas( GLES2DriverData     *drv,
+                     GLES2DeviceData     *dev,
+                     const CardState     *state,
+                     const GLES2Dispatch *dispatch )
+{
+     GLES2Pending     *pending = drv->pending;
+     GLES2AtlasEntry  *entry;
+     GLES2AtlasUpload *upload;
+     DFBResult         ret;
+     bool              copy;
+     unsigned int      i;
+
+     if (!drv->atlas.max_size || state->set != DFXL_BLIT || dispatch->filter != GL_NEAREST ||
+         dispatch->validation & CONVOLUTION || state->render_options & DSRO_MATRIX)
+          return NULL;
+
+     /* The copies are made before the commands of the batch, which must not render into the source. */
+     for (i = 0; i < pending->num_states; i++) {
+          if (pending->states[i].dst_allocation == state->src.allocation)
+               return NULL;
+     }
+
+     ret = gles2_atlas_lookup( drv, state, &entry, &copy );
+     if (ret == DFB_LIMITEXCEEDED) {
+          /* Pending commands may draw from the page to be evicted or copy into it. */
+          if (!gles2_pending_submit( drv, dev ))
+               return NULL;
+
+          gles2_atlas_evict( drv );
+
+          ret = gles2_atlas_lookup( drv, state, &entry, &copy );
+     }
+
+     if (ret)
+          return NULL;
+
+     if (copy) {
+          if (drv->pending->num_uploads == GLES2_PENDING_UPLOADS && !gles2_pending_submit( drv, dev ))
+               return NULL;
+
+          upload = &drv->pending->uploads[drv->pending->num_uploads++];
+
+          upload->tex        = (GLuint)(long) state->src.handle;
+          upload->w          = state->source->config.size.w;
+          upload->h          = state->source->config.size.h;
+          upload->page       = entry->page;
+          upload->slot       = entry->slot;
+          upload->allocation = state->src.allocation;
+     }
+
+     return entry;
+}
+
+/*
+ * Check if a pending state differs from another one only by the source.
+ */
+static bool
+gles2_pending_equal( const GLES2PendingState *prev,
+                     const GLES2PendingState *state )
+{
+     return prev->dispatch == state->dispatch &&
+            prev->dst_allocation == state->dst_allocation && prev->dst_tex == state->dst_tex &&
+            prev->framebuffer == state->framebuffer && DFB_REGION_EQUAL( prev->clip, state->clip ) &&
+            prev->drawingflags == state->drawingflags && prev->blittingflags == state->blittingflags &&
+            prev->render_options == state->render_options &&
+            prev->color.a == state->color.a && prev->color.r == state->color.r &&
+            prev->color.g == state->color.g && prev->color.b == state->color.b &&
+            prev->src_blend == state->src_blend && prev->dst_blend == state->dst_blend &&
+            prev->src_colorkey == state->src_colorkey &&
+            !memcmp( prev->src_colormatrix, state->src_colormatrix, sizeof(state->src_colormatrix) ) &&
+            !memcmp( &prev->src_convolution, &state->src_convolution, sizeof(state->src_convolution) );
+}
+
+/*
+ * Copy the fields of the state passed to SetState() used for the validation of the hardware states, the allocations
+ * are only compared, not accessed when the state is applied. The source is only kept for blitting functions.
+ */
+static void
+gles2_pending_copy( GLES2PendingState   *pending_state,
+                    const CardState     *state,
+                    const GLES2Dispatch *dispatch )
+{
+     pending_state->dispatch        = dispatch;
+     pending_state->dst_allocation  = state->dst.allocation;
+     pending_state->dst_id          = state->dst.allocation->object.id;
+     pending_state->dst_tex         = (GLuint)(long) state->dst.handle;
+     pending_state->dst_size        = state->destination->config.size;
+     pending_state->surface_id      = state->destination->object.id;
+     pending_state->clip            = state->clip;
+     pending_state->color           = state->color;
+     pending_state->drawingflags    = state->drawingflags;
+     pending_state->blittingflags   = state->blittingflags;
+     pending_state->render_options  = state->render_options;
+     pending_state->src_blend       = state->src_blend;
+     pending_state->dst_blend       = state->dst_blend;
+     pending_state->src_colorkey    = state->src_colorkey;
+     pending_state->src_convolution = state->src_convolution;
+
+     memcpy( pending_state->matrix, state->matrix, sizeof(state->matrix) );
+     memcpy( pending_state->src_colormatrix, state->src_colormatrix, sizeof(state->src_colormatrix) );
+
+     if (dispatch->validation & SOURCE) {
+          pending_state->src_allocation = state->src.allocation;
+          pending_state->src_tex        = (GLuint)(long) state->src.handle;
+          pending_state->src_size       = state->source->config.size;
+     }
+     else {
+          pending_state->src_allocation = NULL;
+          pending_state->src_tex        = 0;
+          pending_state->src_size       = (DFBDimension) { 0, 0 };
+     }
+}
+
+static void
+gles2_pending_state( GLES2DriverData        *drv,
+                     GLES2DeviceData        *dev,
+                     CardState              *state,
+                     const GLES2Dispatch    *dispatch,
+                     StateModificationFlags  modified )
+{
+     GLES2Pending        *pending;
+     GLES2PendingState   *pending_state;
+     GLES2PendingState   *previous;
+     GLES2PendingCommand *command;
+     GLES2AtlasEntry     *entry;
+
+     pending = drv->pending;
+
+     /* Replace the last state if all its primitives have been moved to earlier states, keeping its modifications. */
+     if (pending->num_commands && pending->commands[pending->num_commands - 1].type == GLES2PC_STATE) {
+          D_DEBUG_AT( GLES2_2D, "  -> replacing state %u without primitives\n", pending->num_states - 1 );
+
+          modified |= pending->states[--pending->num_states].mod_hw;
+
+          pending->num_commands--;
+     }
+
+     if ((pending->num_states == GLES2_PENDING_STATES || pending->num_commands == GLES2_PENDING_COMMANDS) &&
+         !gles2_pending_submit( drv, dev )) {
+          D_BUG( "no context to submit a full queue" );
+          return;
+     }
+
+     entry = gles2_pending_atlas( drv, dev, state, dispatch );
+
+     pending       = drv->pending;
+     pending_state = &pending->states[pending->num_states];
+     previous      = pending->num_states ? pending_state - 1 : NULL;
+
+     gles2_pending_copy( pending_state, state, dispatch );
+
+     /* The framebuffer bound by the system module is queried again only if the destination has changed, it is not
+        shared between contexts. */
+     if (previous && !(modified & SMF_DESTINATION) && drv->num_contexts == 1 &&
+         previous->dst_allocation == pending_state->dst_allocation && previous->dst_tex == pending_state->dst_tex) {
+          pending_state->framebuffer = previous->framebuffer;
+          pending_state->offscreen   = previous->offscreen;
+     }
+     else {
+          glGetIntegerv( GL_FRAMEBUFFER_BINDING, &pending_state->framebuffer );
+
+          /* The texture of a surface not shown by a layer is bound via the cache in any context: its primitives can
+             be kept across operations and executed by the submission thread. The framebuffers of surfaces shown by a
+             layer are left to the system module. */
+          pending_state->offscreen = drv->fbo_cache && pending_state->dst_tex &&
+                                     !(state->destination->type & CSTF_LAYER) &&
+                                     gles2_fbo_watch( drv, state->destination );
+     }
+
+     /* Blits from another source in the same atlas page are drawn with the previous state. */
+     if (entry && previous && previous->page == entry->page && gles2_pending_equal( previous, pending_state )) {
+          D_DEBUG_AT( GLES2_2D, "  -> blitting from atlas page with the previous state\n" );
+
+          previous->src_allocation = pending_state->src_allocation;
+          previous->src_tex        = pending_state->src_tex;
+          previous->src_size       = pending_state->src_size;
+          previous->atlas          = entry;
+          return;
+     }
+
+     pending_state->mod_hw = modified;
+     pending_state->atlas  = entry;
+     pending_state->page   = entry ? entry->page : NULL;
+
+     /* Primitives replace the destination pixels if there's no blending (including color keying), no transformation
+        and the source is not the destination. */
+     pending_state->opaque = dispatch->blend == GLES2BM_DISABLED && !(state->render_options & DSRO_MATRIX) &&
+                             (!(dispatch->validation & SOURCE) || state->src.allocation != state->dst.allocation);
+
+     command = &pending->commands[pending->num_commands++];
+
+     command->type   = GLES2PC_STATE;
+     command->state  = pending->num_states++;
+     command->culled = false;
+}
+
+/*
+ * Drop pending primitives with the same destination and clip lying within the area covered by an opaque primitive,
+ * up to a primitive reading from the destination.
+ */
+static void
+gles2_pending_cull( GLES2DriverData *drv,
+                    GLES2DeviceData *dev,
+                    const DFBRegion *area )
+{
+     GLES2Pending      *pending = drv->pending;
+     GLES2PendingState *current = &pending->states[pending->num_states - 1];
+     int                i;
+
+     for (i = pending->num_commands - 1; i >= 0; i--) {
+          GLES2PendingCommand *command = &pending->commands[i];
+          GLES2PendingState   *state   = &pending->states[command->state];
+          DFBRegion            region;
+
+          if (command->type == GLES2PC_STATE || command->culled)
+               continue;
+
+          if (command->type == GLES2PC_BLIT && state->src_allocation == current->dst_allocation)
+               break;
+
+          if (state->dst_allocation != current->dst_allocation || !DFB_REGION_EQUAL( state->clip, current->clip ))
+               continue;
+
+          if (state->render_options & DSRO_MATRIX) {
+               /* Transformed primitives are only known to be within the clip. */
+               region = state->clip;
+          }
+          else {
+               gles2_pending_region( command, &region );
+
+               if (!dfb_region_region_intersect( &region, &state->clip )) {
+                    command->culled = true;
+                    gles2_stats_culled( dev, NULL );
+                    continue;
+               }
+          }
+
+          if (region.x1 >= area->x1 && region.y1 >= area->y1 && region.x2 <= area->x2 && region.y2 <= area->y2) {
+               D_DEBUG_AT( GLES2_2D, "  -> culled [%d] %4d,%4d-%4d,%4d\n", i, DFB_REGION_VALS( &region ) );
+
+               command->culled = true;
+               gles2_stats_culled( dev, &region );
+          }
+     }
+}
+
+/*
+ * Copy of the source blitted from with the last state, NULL if the source texture is bound. The state is queued again
+ * if the allocations locked for the operation are not the ones of the last state, e.g. after a flip of the
+ * destination, or if the source has been modified or its copy has been evicted since the state was set.
+ */
+static const GLES2AtlasEntry *
+gles2_pending_source( GLES2DriverData *drv,
+                      GLES2DeviceData *dev )
+{
+     GLES2PendingState      *last     = &drv->pending->states[drv->pending->num_states - 1];
+     CardState              *state    = drv->state;
+     StateModificationFlags  modified = SMF_NONE;
+
+     if (state->dst.allocation != last->dst_allocation || (GLuint)(long) state->dst.handle != last->dst_tex)
+          modified |= SMF_DESTINATION;
+
+     if (last->dispatch->validation & SOURCE) {
+          if (state->src.allocation != last->src_allocation || (GLuint)(long) state->src.handle != last->src_tex)
+               modified |= SMF_SOURCE;
+          else if (last->atlas && !gles2_atlas_valid( last->atlas, last->page, state ))
+               modified |= SMF_SOURCE;
+     }
+
+     if (!modified)
+          return last->atlas;
+
+     D_DEBUG_AT( GLES2_2D, "  -> allocations or atlas copy outdated (0x%08x)\n", modified );
+
+     gles2_pending_state( drv, dev, state, last->dispatch, modified );
+
+     return drv->pending->states[drv->pending->num_states - 1].atlas;
+}
+
+/*
+ * Check if the primitives of the last state can be drawn with a pending one, which has the same hardware state and
+ * binds the same texture.
+ */
+static bool
+gles2_pending_equivalent( const GLES2PendingState *pending_state,
+                          const GLES2PendingState *last )
+{
+     if (pending_state->page != last->page || !gles2_pending_equal( pending_state, last ))
+          return false;
+
+     return pending_state->page || !(last->dispatch->validation & SOURCE) ||
+            (pending_state->src_allocation == last->src_allocation && pending_state->src_tex == last->src_tex);
+}
+
+/*
+ * Check if a pending primitive must stay ahead of a primitive drawn with the last state in the given region, because
+ * it renders into that region or into the source, or reads from the destination.
+ */
+static bool
+gles2_pending_depends( const GLES2PendingState   *last,
+                       const DFBRegion           *area,
+                       const GLES2PendingState   *state,
+                       const GLES2PendingCommand *command )
+{
+     DFBRegion region;
+
+     /* Copies in atlas pages are made before the batch. */
+     if (!last->page && last->dispatch->validation & SOURCE && state->dst_allocation == last->src_allocation)
+          return true;
+
+     if (!state->page && state->dispatch->validation & SOURCE && state->src_allocation == last->dst_allocation)
+          return true;
+
+     if (state->dst_allocation != last->dst_allocation)
+          return false;
+
+     if (state->render_options & DSRO_MATRIX) {
+          region = state->clip;
+     }
+     else {
+          gles2_pending_region( command, &region );
+
+          if (!dfb_region_region_intersect( &region, &state->clip ))
+               return false;
+     }
+
+     return dfb_region_region_intersect( &region, area );
+}
+
+/*
+ * Look for the earliest state equivalent to the last one that a primitive can be moved back to, across primitives of
+ * other states not overlapping it in the destination, so that it's drawn together with the primitives of that state.
+ * Returns the index of the command to insert the primitive at, the number of commands to append it with the last
+ * state.
+ */
+static unsigned int
+gles2_pending_reorder( const GLES2Pending *pending,
+                       const DFBRegion    *area,
+                       unsigned int       *ret_state )
+{
+     const GLES2PendingState *last  = &pending->states[pending->num_states - 1];
+     unsigned int             index = pending->num_commands;
+     unsigned int             end   = pending->num_commands;
+     int                      i;
+
+     *ret_state = pending->num_states - 1;
+
+     /* Transformed primitives are only known to be within the clip. */
+     if (last->render_options & DSRO_MATRIX)
+          return index;
+
+     for (i = pending->num_commands - 1; i >= 0; i--) {
+          const GLES2PendingCommand *command = &pending->commands[i];
+          const GLES2PendingState   *state   = &pending->states[command->state];
+
+          if (command->type == GLES2PC_STATE) {
+               /* Insert after the primitives of the state, up to the next state. */
+               if (command->state != pending->num_states - 1 && gles2_pending_equivalent( state, last )) {
+                    index      = end;
+                    *ret_state = command->state;
+               }
+
+               end = i;
+          }
+          else if (!command->culled && gles2_pending_depends( last, area, state, command ))
+               return index;
+     }
+
+     /* The first state carried over from the previous batch has no state command. */
+     if (end > 0 && pending->num_states > 1 && gles2_pending_equivalent( &pending->states[0], last )) {
+          index      = end;
+          *ret_state = 0;
+     }
+
+     return index;
+}
+
+static void
+gles2_pending_primitive( GLES2DriverData    *drv,
+                         GLES2DeviceData    *dev,
+                         GLES2PendingType    type,
+                         const DFBRectangle *rect,
+                         int                 dx,
+                         int                 dy )
+{
+     GLES2Pending          *pending;
+     GLES2PendingCommand   *command;
+     const GLES2AtlasEntry *atlas;
+     DFBRegion              area;
+     unsigned int           index, state;
+
+     atlas = gles2_pending_source( drv, dev );
+
+     if (drv->pending->num_commands == GLES2_PENDING_COMMANDS && !gles2_pending_submit( drv, dev )) {
+          D_BUG( "no context to submit a full queue" );
+          return;
+     }
+
+     pending = drv->pending;
+
+     D_ASSERT( pending->num_states > 0 );
+
+     area = (DFBRegion) { dx, dy, dx + rect->w - 1, dy + rect->h - 1 };
+
+     if (pending->states[pending->num_states - 1].opaque)
+          gles2_pending_cull( drv, dev, &area );
+
+     if (!pending->states[pending->num_states - 1].offscreen)
+          pending->onscreen = true;
+
+     /* Draw the primitive with an earlier state equal to the last one, if no primitive in between overlaps it. */
+     if (drv->reorder) {
+          dfb_region_region_intersect( &area, &pending->states[pending->num_states - 1].clip );
+
+          index = gles2_pending_reorder( pending, &area, &state );
+     }
+     else {
+          index = pending->num_commands;
+          state = pending->num_states - 1;
+     }
+
+     if (index < pending->num_commands) {
+          D_DEBUG_AT( GLES2_2D, "  -> moved to [%u] with state %u\n", index, state );
+
+          memmove( &pending->commands[index + 1], &pending->commands[index],
+                   (pending->num_commands - index) * sizeof(GLES2PendingCommand) );
+
+          gles2_stats_reordered( dev );
+     }
+
+     pending->num_commands++;
+
+     command = &pending->commands[index];
+
+     command->type    = type;
+     command->state   = state;
+     command->culled  = false;
+     command->rect    = *rect;
+     command->point.x = dx;
+     command->point.y = dy;
+
+     /* Blit from the slot of the copy in the atlas page. */
+     if (atlas) {
+          command->rect.x += atlas->slot.x;
+          command->rect.y += atlas->slot.y;
+     }
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Premultiplication of the destination is done by the blend functions if the destination is added, other uses need
+ * blending in the shader, as well as demultiplication and DSBF_SRCALPHASAT as destination blend function.
+ */
+static GLES2DispatchKey
+gles2_dst_dispatch_key( const CardState     *state,
+                        DFBAccelerationMask  accel )
+{
+     bool blend, dst_premultiply, demultiply;
+
+     if (DFB_DRAWING_FUNCTION( accel )) {
+          blend           = state->drawingflags & DSDRAW_BLEND;
+          dst_premultiply = state->drawingflags & DSDRAW_DST_PREMULTIPLY;
+          demultiply      = state->drawingflags & DSDRAW_DEMULTIPLY;
+     }
+     else {
+          blend           = state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA);
+          dst_premultiply = state->blittingflags & DSBLIT_DST_PREMULTIPLY;
+          demultiply      = state->blittingflags & DSBLIT_DEMULTIPLY;
+     }
+
+     if (demultiply)
+          return GLES2DK_FETCH;
+
+     /* The destination is not read without blending. */
+     if (!blend)
+          return GLES2DK_NONE;
+
+     if (state->dst_blend == DSBF_SRCALPHASAT)
+          return GLES2DK_FETCH;
+
+     if (!dst_premultiply)
+          return GLES2DK_NONE;
+
+     if (state->src_blend == DSBF_DESTCOLOR || state->src_blend == DSBF_INVDESTCOLOR)
+          return GLES2DK_FETCH;
+
+     switch (state->dst_blend) {
+          case DSBF_ZERO:
+               return GLES2DK_NONE;
+
+          case DSBF_ONE:
+               return GLES2DK_DST_PREMUL;
+
+          default:
+               return GLES2DK_FETCH;
+     }
+}
+
+/* Blitting flags selecting a program that filters the source, which can't be combined with each other. */
+#define GLES2_SOURCE_FILTERS (DSBLIT_SRC_COLORKEY | DSBLIT_SRC_COLORMATRIX | DSBLIT_SRC_CONVOLUTION)
+
+static void
+gles2CheckState( void                *driver_data,
+                 void                *device_data,
+                 CardState           *state,
+                 DFBAccelerationMask  accel )
+{
+     GLES2DriverData *drv = driver_data;
+     GLES2DeviceData *dev = device_data;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %p, 0x%08x )\n", __FUNCTION__, state, accel );
+
+     /* Check if function is accelerated. */
+     if (accel & ~dev->caps.accel) {
+          D_DEBUG_AT(GLES2_2D, "  -> unsupported function\n");
+          gles2_stats_fallback( dev, state, accel, accel & ~dev->caps.accel );
+          return;
+     }
+
+     /* Check if the calling thread has a context, the functions of a thread without one are rendered in software. */
+     if (!gles2_context_get( drv )) {
+          D_DEBUG_AT( GLES2_2D, "  -> no context for the calling thread\n" );
+          gles2_stats_fallback( dev, state, accel, 0 );
+          return;
+     }
+
+     /* Check if drawing or blitting flags are supported. */
+     if (DFB_DRAWING_FUNCTION(accel)) {
+          if (state->drawingflags & ~dev->caps.drawing) {
+               D_DEBUG_AT(GLES2_2D, "  -> unsupported drawing flags 0x%08x\n", state->drawingflags);
+               gles2_stats_fallback( dev, state, accel, state->drawingflags & ~dev->caps.drawing );
+               return;
+          }
+     }
+     else {
+          if (state->blittingflags & ~dev->caps.blitting) {
+               D_DEBUG_AT(GLES2_2D, "  -> unsupported blitting flags 0x%08x\n", state->blittingflags);
+               gles2_stats_fallback( dev, state, accel, state->blittingflags & ~dev->caps.blitting );
+               return;
+          }
+     }
+
+     /* Check if blending in the shader is needed and possible, it doesn't do color keying or source filtering. */
+     if (gles2_dst_dispatch_key( state, accel ) & GLES2DK_FETCH) {
+          if (!dev->fetch || (DFB_BLITTING_FUNCTION( accel ) && state->blittingflags & GLES2_SOURCE_FILTERS)) {
+               D_DEBUG_AT( GLES2_2D, "  -> blending in the shader not supported\n" );
+               gles2_stats_fallback( dev, state, accel, 0 );
+               return;
+          }
+     }
+
+     /* Check if the source is filtered once, by color keying, the color matrix or the convolution. */
+     if (DFB_BLITTING_FUNCTION( accel )) {
+          DFBSurfaceBlittingFlags filters = state->blittingflags & GLES2_SOURCE_FILTERS;
+
+          if (filters & (filters - 1)) {
+               D_DEBUG_AT( GLES2_2D, "  -> combined source filters 0x%08x not supported\n", filters );
+               gles2_stats_fallback( dev, state, accel, 0 );
+               return;
+          }
+     }
+
+     /* Check if the surfaces are within the size limits, a larger source has no texture object. */
+     if (state->destination->config.size.w > dev->max_viewport[0] ||
+         state->destination->config.size.h > dev->max_viewport[1]) {
+          D_DEBUG_AT(GLES2_2D, "  -> destination exceeds max viewport\n");
+          gles2_stats_fallback( dev, state, accel, 0 );
+          return;
+     }
+
+     if (DFB_BLITTING_FUNCTION(accel)) {
+          if (state->source->config.size.w > dev->max_texture_size ||
+              state->source->config.size.h > dev->max_texture_size) {
+               D_DEBUG_AT(GLES2_2D, "  -> source exceeds max texture size\n");
+               gles2_stats_fallback( dev, state, accel, 0 );
+               return;
+          }
+     }
+
+     /* Enable acceleration of the function. */
+     state->accel |= accel;
+}
+
+static void
+gles2SetState( void                *driver_data,
+               void                *device_data,
+               GraphicsDeviceFuncs *funcs,
+               CardState           *state,
+               DFBAccelerationMask  accel )
+{
+     GLES2DriverData  *drv = driver_data;
+     GLES2DeviceData  *dev = device_data;
+     GLES2DispatchKey  key = GLES2DK_NONE;
+     GLES2Dispatch    *dispatch;
+
+     D_DEBUG_AT(GLES2_2D, "%s( %p, 0x%08x ) <- mod_hw 0x%08x\n", __FUNCTION__, state, accel, state->mod_hw );
+
+     /*
+      * 1) Look up the program and the states to validate for the function
+      */
+
+     if (state->render_options & DSRO_MATRIX)
+          key |= GLES2DK_MATRIX;
+
+     /* Premultiplication or demultiplication of the destination. */
+     key |= gles2_dst_dispatch_key( state, accel );
+
+     switch (accel) {
+          case DFXL_FILLRECTANGLE:
+          case DFXL_DRAWRECTANGLE:
+          case DFXL_DRAWLINE:
+          case DFXL_FILLTRIANGLE:
+          case DFXL_FILLQUADRANGLE:
+               /* Use of alpha blending. */
+               if (state->drawingflags & DSDRAW_BLEND)
+                    key |= GLES2DK_BLEND;
+
+               /* Use of anti-aliasing. With blending, the coverage can only mix the color with the destination if
+                  the destination is scaled by the inverted source alpha. */
+               if (state->render_options & DSRO_ANTIALIAS && dev->antialias &&
+                   (!(key & GLES2DK_BLEND) || state->dst_blend == DSBF_INVSRCALPHA))
+                    key |= GLES2DK_ANTIALIAS;
+
+               dispatch = &dev->dispatch[GLES2AC_DRAW][key];
+
+               /*
+                * 2) Tell which functions can be called without further validation, i.e. SetState()
+                *
+                * When the hw independent state is changed, this collection is reset.
+                */
+
+               state->set = DFXL_FILLRECTANGLE | DFXL_DRAWRECTANGLE | DFXL_DRAWLINE | DFXL_FILLTRIANGLE |
+                            DFXL_FILLQUADRANGLE;
+               break;
+
+          case DFXL_BLIT:
+          case DFXL_STRETCHBLIT:
+               /* Use of alpha blending. */
+               if (state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA))
+                    key |= GLES2DK_BLEND;
+
+               if (state->blittingflags & DSBLIT_SRC_COLORKEY)
+                    key |= GLES2DK_COLORKEY;
+
+               if (state->blittingflags & DSBLIT_SRC_PREMULTIPLY)
+                    key |= GLES2DK_PREMULTIPLY;
+
+               if (state->blittingflags & (DSBLIT_COLORIZE | DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTCOLOR))
+                    key |= GLES2DK_COLOR;
+
+               if (state->blittingflags & DSBLIT_SRC_COLORMATRIX)
+                    key |= GLES2DK_COLORMATRIX;
+
+               if (state->blittingflags & DSBLIT_SRC_CONVOLUTION)
+                    key |= GLES2DK_CONVOLUTION;
+
+               /* Use of anti-aliasing, only the edges of transformed blits are not aligned to pixels. With blending,
+                  the coverage can only mix the source with the destination if the destination is scaled by the
+                  inverted source alpha, without blending if the source has no alpha channel. */
+               if (state->render_options & DSRO_ANTIALIAS && state->render_options & DSRO_MATRIX && dev->antialias &&
+                   (key & GLES2DK_BLEND ? state->dst_blend == DSBF_INVSRCALPHA :
+                                          !DFB_PIXELFORMAT_HAS_ALPHA( state->source->config.format )))
+                    key |= GLES2DK_ANTIALIAS;
+
+               /* Use of a scaler instead of bilinear filtering. */
+               if (accel == DFXL_STRETCHBLIT && state->render_options & DSRO_SMOOTH_UPSCALE && dev->scale)
+                    key |= GLES2DK_SCALE;
+
+               dispatch = &dev->dispatch[accel == DFXL_BLIT ? GLES2AC_BLIT : GLES2AC_STRETCHBLIT][key];
+
+               /*
+                * 2) Tell which functions can be called without further validation, i.e. SetState()
+                *
+                * When the hw independent state is changed, this collection is reset.
+                */
+
+               state->set = accel;
+               break;
+
+          default:
+               D_BUG( "unexpected drawing/blitting function" );
+               return;
+     }
+
+     /*
+      * 3) Queue the state
+      *
+      * The hardware states are invalidated and validated when the pending commands are executed.
+      */
+
+     drv->state = state;
+
+     gles2_pending_state( drv, dev, state, dispatch, state->mod_hw );
+
+     /*
+      * 4) Clear modification flags
+      *
+      * All flags have been remembered with the queued state for further validation.
+      * If the hw independent state is not modified, this function won't get called
+      * for subsequent rendering functions, unless they aren't defined by 2).
+      */
+
+     state->mod_hw = SMF_NONE;
+}
+
+static void
+gles2EmitCommands( void *driver_data,
+                   void *device_data )
+{
+     GLES2DriverData *drv = driver_data;
+     GLES2DeviceData *dev = device_data;
+     GLES2Context    *context;
+
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
+
+     /* Keep primitives rendering into offscreen surfaces for culling and reordering across operations. The serial is
+        not advanced, waiting for it flushes them, as well as FlushTextureCache(), a function not queued and a full
+        queue. The framebuffers bound by the system module are only valid during the operation, the allocations used
+        are referenced until the primitives have been executed. */
+     if (!drv->async.thread && drv->pending->num_commands && !drv->pending->onscreen &&
+         gles2_pending_reference( drv, drv->pending )) {
+          D_DEBUG_AT( GLES2_2D, "  -> keeping %u commands\n", drv->pending->num_commands );
+
+          drv->pending->kept = true;
+          return;
+     }
+
+     gles2_pending_submit( drv, dev );
+
+     /* The fence ending the batch covers the commands of the calling thread's context, which waits for the context
+        that executed the previous commands. */
+     context = gles2_context_get( drv );
+     if (!context)
+          return;
+
+     if (!drv->async.thread)
+          gles2_context_switch( drv, context );
+
+     /* End the batch. */
+     gles2_sync_submit( drv );
+
+     gles2_stats_flush( drv, dev );
+}
+
+static DFBResult
+gles2EngineSync( void *driver_data,
+                 void *device_data )
+{
+     GLES2DriverData *drv = driver_data;
+
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
+
+     gles2_pending_flush( drv, device_data );
+
+     /* Wait for the current batch, i.e. all commands. */
+     return gles2_sync_wait( drv, &drv->serial );
+}
+
+static void
+gles2FlushTextureCache( void *driver_data,
+                        void *device_data )
+{
+     GLES2DriverData *drv = driver_data;
+
+     D_DEBUG_AT( GLES2_2D, "%s()\n", __FUNCTION__ );
+
+     /* Texture sampling is coherent with texture updates, but pending blits must read the previous contents. */
+     if (!gles2_pending_run( drv, device_data ))
+          return;
+
+     gles2_fbo_restore( drv );
+
+     /* The updates have been issued in the context of the calling thread, other contexts wait for them. */
+     drv->context->issued = true;
+
+     gles2_context_release( drv );
+}
+
+static void
+gles2GetSerial( void               *driver_data,
+                void               *device_data,
+                CoreGraphicsSerial *serial )
+{
+     gles2_sync_get( driver_data, serial );
+
+     D_DEBUG_AT( GLES2_2D, "%s() -> %u:%u\n", __FUNCTION__, serial->generation, serial->serial );
+}
+
+static DFBResult
+gles2WaitSerial( void                     *driver_data,
+                 void                     *device_data,
+                 const CoreGraphicsSerial *serial )
+{
+     GLES2DriverData *drv = driver_data;
+
+     D_DEBUG_AT( GLES2_2D, "%s( %u:%u )\n", __FUNCTION__, serial->generation, serial->serial );
+
+     /* Commands of the current batch may still be pending, in asynchronous mode commands of previous batches too. */
+     if (drv->async.thread || (serial->generation == drv->serial.generation && serial->serial == drv->serial.serial))
+          gles2_pending_flush( drv, device_data );
+
+     return gles2_sync_wait( drv, serial );
+}
+
+static bool
+gles2FillRectangle( void         *driver_data,
+                    void         *device_data,
+                    DFBRectangle *rect )
+{
+     D_DEBUG_AT( GLES2_2D, "%s( %4d,%4d-%4dx%4d )\n", __FUNCTION__, DFB_RECTANGLE_VALS( rect ) );
+
+     gles2_pending_primitive( driver_data, device_data, GLES2PC_FILLRECTANGLE, rect, rect->x, rect->y );
+
+     return true;
+}
+
+static bool
+gles2BatchFill( void               *driver_data,
+                void               *device_data,
+                const DFBRectangle *rects,
+                unsigned int        num,
+                unsigned int       *ret_num )
+{
+     unsigned int i;
+
+     for (i = 0; i < num; i++) {
+          D_DEBUG_AT( GLES2_2D, "%s( [%2u] %4d,%4d-%4dx%4d )\n", __FUNCTION__, i, DFB_RECTANGLE_VALS( &rects[i] ) );
+
+          gles2_pending_primitive( driver_data, device_data, GLES2PC_FILLRECTANGLE, &rects[i], rects[i].x, rects[i].y );
+     }
+
+     *ret_num = num;
 
-     state->mod_hw = SMF_NONE;
+     return true;
 }
 
-static bool
-gles2FillRectangle( void         *driver_data,
-                    void         *device_data,
-                    DFBRectangle *rect )
+/*
+ * Anti-aliased outline, drawn as the rectangles of the top and bottom rows and of the left and right columns between.
+ */
+static void
+gles2_aa_outline( GLES2DriverData    *drv,
+                  const DFBRectangle *rect )
 {
-     float   x1    = rect->x;
-     float   y1    = rect->y;
-     float   x2    = rect->w + x1;
-     float   y2    = rect->h + y1;
-     GLfloat pos[] = {
-          x1, y1,
-          x2, y1,
-          x2, y2,
-          x1, y2
-     };
+     DFBRectangle sides[4];
+     GLfloat      pos[4*12];
+     GLfloat      edges[4*24];
+     unsigned int i, n = 0, num = 0;
 
-     D_DEBUG_AT( GLES2_2D, "%s( %4d,%4d-%4dx%4d )\n", __FUNCTION__, DFB_RECTANGLE_VALS( rect ) );
+     sides[n++] = (DFBRectangle) { rect->x, rect->y, rect->w, 1 };
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
+     if (rect->h > 1)
+          sides[n++] = (DFBRectangle) { rect->x, rect->y + rect->h - 1, rect->w, 1 };
 
-     glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
+     if (rect->h > 2) {
+          sides[n++] = (DFBRectangle) { rect->x, rect->y + 1, 1, rect->h - 2 };
 
-     return true;
+          if (rect->w > 1)
+               sides[n++] = (DFBRectangle) { rect->x + rect->w - 1, rect->y + 1, 1, rect->h - 2 };
+     }
+
+     for (i = 0; i < n; i++) {
+          float   x1       = sides[i].x;
+          float   y1       = sides[i].y;
+          float   x2       = sides[i].w + x1;
+          float   y2       = sides[i].h + y1;
+          GLfloat points[] = {
+               x1, y1,
+               x2, y1,
+               x2, y2,
+               x1, y2
+          };
+
+          num += gles2_aa_polygon( points, NULL, 4, drv->margin, pos + num * 2, NULL, edges + num * 4 );
+     }
+
+     gles2_aa_draw( drv, pos, NULL, edges, num );
 }
 
 static bool
@@ -714,11 +2891,12 @@ gles2DrawRectangle( void         *driver_data,
                     void         *device_data,
                     DFBRectangle *rect )
 {
-     float   x1    = rect->x + 1;
-     float   y1    = rect->y + 1;
-     float   x2    = rect->x + rect->w;
-     float   y2    = rect->y + rect->h;
-     GLfloat pos[] = {
+     GLES2DriverData *drv   = driver_data;
+     float            x1    = rect->x + 1;
+     float            y1    = rect->y + 1;
+     float            x2    = rect->x + rect->w;
+     float            y2    = rect->y + rect->h;
+     GLfloat          pos[] = {
           x1, y1,
           x2, y1,
           x2, y2,
@@ -727,28 +2905,76 @@ gles2DrawRectangle( void         *driver_data,
 
      D_DEBUG_AT( GLES2_2D, "%s( %4d,%4d-%4dx%4d )\n", __FUNCTION__, DFB_RECTANGLE_VALS( rect ) );
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
+     gles2_pending_prepare( drv, device_data );
+
+     if (drv->antialias) {
+          gles2_aa_outline( drv, rect );
+     }
+     else {
+          gles2_vertex_positions( drv, pos, 4 );
+
+          glDrawArrays( GL_LINE_LOOP, 0, 4 );
+     }
 
-     glDrawArrays( GL_LINE_LOOP, 0, 4 );
+     gles2_pending_release( drv );
 
      return true;
 }
 
+/*
+ * Anti-aliased line, drawn as a rectangle of one pixel width between the centers of the end pixels, which are covered
+ * by extending it by half a pixel at each end.
+ */
+static void
+gles2_aa_line( GLES2DriverData *drv,
+               const DFBRegion *line )
+{
+     float   dx       = line->x2 - line->x1;
+     float   dy       = line->y2 - line->y1;
+     float   l        = sqrtf( dx * dx + dy * dy );
+     float   ux       = l ? dx / l * 0.5f : 0.5f;
+     float   uy       = l ? dy / l * 0.5f : 0.0f;
+     float   x1       = line->x1 + 0.5f - ux;
+     float   y1       = line->y1 + 0.5f - uy;
+     float   x2       = line->x2 + 0.5f + ux;
+     float   y2       = line->y2 + 0.5f + uy;
+     GLfloat points[] = {
+          x1 + uy, y1 - ux,
+          x2 + uy, y2 - ux,
+          x2 - uy, y2 + ux,
+          x1 - uy, y1 + ux
+     };
+     GLfloat pos[12];
+     GLfloat edges[24];
+
+     gles2_aa_draw( drv, pos, NULL, edges, gles2_aa_polygon( points, NULL, 4, drv->margin, pos, NULL, edges ) );
+}
+
 static bool
 gles2DrawLine( void      *driver_data,
                void      *device_data,
                DFBRegion *line )
 {
-     GLfloat pos[] = {
+     GLES2DriverData *drv   = driver_data;
+     GLfloat          pos[] = {
           line->x1, line->y1,
           line->x2, line->y2
      };
 
      D_DEBUG_AT( GLES2_2D, "%s( %4d,%4d-%4d,%4d )\n", __FUNCTION__, DFB_REGION_VALS( line ) );
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
+     gles2_pending_prepare( drv, device_data );
+
+     if (drv->antialias) {
+          gles2_aa_line( drv, line );
+     }
+     else {
+          gles2_vertex_positions( drv, pos, 2 );
+
+          glDrawArrays( GL_LINES, 0, 2 );
+     }
 
-     glDrawArrays( GL_LINES, 0, 2 );
+     gles2_pending_release( drv );
 
      return true;
 }
@@ -758,7 +2984,8 @@ gles2FillTriangle( void        *driver_data,
                    void        *device_data,
                    DFBTriangle *tri )
 {
-     GLfloat pos[] = {
+     GLES2DriverData *drv   = driver_data;
+     GLfloat          pos[] = {
           tri->x1, tri->y1,
           tri->x2, tri->y2,
           tri->x3, tri->y3
@@ -766,9 +2993,80 @@ gles2FillTriangle( void        *driver_data,
 
      D_DEBUG_AT( GLES2_2D, "%s( %4d,%4d-%4d,%4d-%4d,%4d )\n", __FUNCTION__, DFB_TRIANGLE_VALS( tri ) );
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
+     gles2_pending_prepare( drv, device_data );
+
+     if (drv->antialias) {
+          GLfloat aa_pos[6];
+          GLfloat edges[12];
+
+          gles2_aa_draw( drv, aa_pos, NULL, edges, gles2_aa_polygon( pos, NULL, 3, drv->margin, aa_pos, NULL, edges ) );
+     }
+     else {
+          gles2_vertex_positions( drv, pos, 3 );
+
+          glDrawArrays( GL_TRIANGLES, 0, 3 );
+     }
+
+     gles2_pending_release( drv );
+
+     return true;
+}
+
+/*
+ * Quadrangles are convex, each one is drawn as two triangles sharing the diagonal from the first to the third point.
+ */
+static bool
+gles2FillQuadrangles( void     *driver_data,
+                      void     *device_data,
+                      DFBPoint *points,
+                      int       num )
+{
+     GLES2DriverData *drv = driver_data;
+     GLfloat          pos[num*12];
+     GLfloat          edges[num*24];
+     int              i, j, n = 0;
+
+     for (i = 0; i < num; i++)
+          D_DEBUG_AT( GLES2_2D, "%s( [%2d] %4d,%4d-%4d,%4d-%4d,%4d-%4d,%4d )\n", __FUNCTION__, i,
+                      points[i*4].x, points[i*4].y, points[i*4+1].x, points[i*4+1].y,
+                      points[i*4+2].x, points[i*4+2].y, points[i*4+3].x, points[i*4+3].y );
+
+     gles2_pending_prepare( drv, device_data );
+
+     for (i = 0; i < num; i++) {
+          const DFBPoint *p = &points[i*4];
 
-     glDrawArrays( GL_TRIANGLES, 0, 3 );
+          if (drv->antialias) {
+               GLfloat quad[] = {
+                    p[0].x, p[0].y,
+                    p[1].x, p[1].y,
+                    p[2].x, p[2].y,
+                    p[3].x, p[3].y
+               };
+
+               n += gles2_aa_polygon( quad, NULL, 4, drv->margin, pos + n * 2, NULL, edges + n * 4 );
+          }
+          else {
+               for (j = 0; j < 6; j++) {
+                    static const int order[6] = { 0, 1, 2, 0, 2, 3 };
+
+                    pos[n*2]   = p[order[j]].x;
+                    pos[n*2+1] = p[order[j]].y;
+                    n++;
+               }
+          }
+     }
+
+     if (drv->antialias) {
+          gles2_aa_draw( drv, pos, NULL, edges, n );
+     }
+     else {
+          gles2_vertex_positions( drv, pos, n );
+
+          glDrawArrays( GL_TRIANGLES, 0, n );
+     }
+
+     gles2_pending_release( drv );
 
      return true;
 }
@@ -780,57 +3078,135 @@ gles2Blit( void         *driver_data,
            int           dx,
            int           dy )
 {
-     GLES2DriverData *drv   = driver_data;
-     float            x1    = dx;
-     float            y1    = dy;
-     float            x2    = rect->w + x1;
-     float            y2    = rect->h + y1;
-     GLfloat          pos[] = {
-          x1, y1,
-          x2, y1,
-          x2, y2,
-          x1, y2
-     };
-     float            tx1   = rect->x;
-     float            ty1   = rect->y;
-     float            tx2   = rect->w + tx1;
-     float            ty2   = rect->h + ty1;
-     GLfloat          tex[8];
-
      D_DEBUG_AT( GLES2_2D, "%s( [%2d], %4d,%4d-%4dx%4d <- %4d,%4d )\n", __FUNCTION__, 0,
                  dx, dy, rect->w, rect->h, rect->x, rect->y );
 
-     if (drv->blittingflags & DSBLIT_ROTATE180) {
-          tex[0] = tx2; tex[1] = ty2;
-          tex[2] = tx1; tex[3] = ty2;
-          tex[4] = tx1; tex[5] = ty1;
-          tex[6] = tx2; tex[7] = ty1;
-     }
-     else if (drv->blittingflags & DSBLIT_ROTATE90) {
-          tex[0] = tx2; tex[1] = ty1;
-          tex[2] = tx2; tex[3] = ty2;
-          tex[4] = tx1; tex[5] = ty2;
-          tex[6] = tx1; tex[7] = ty1;
+     gles2_pending_primitive( driver_data, device_data, GLES2PC_BLIT, rect, dx, dy );
+
+     return true;
+}
+
+/*
+ * Check if the mipmaps of the source are up to date, i.e. generated after the last write to the allocation.
+ * Returns false if they are not and cannot be generated.
+ *
+ * Entries are identified by the texture, the allocation and its object id. An entry with the texture of another
+ * allocation belongs to a deleted texture whose name has been reused, it is replaced first.
+ */
+static bool
+gles2_mipmap_validate( GLES2DriverData *drv )
+{
+     CoreSurfaceAllocation *allocation = drv->source;
+     GLES2Mipmap           *mipmap     = NULL;
+     int                    w          = allocation->config.size.w;
+     int                    h          = allocation->config.size.h;
+     unsigned int           i;
+
+     /* OpenGL ES 2.0 requires power of two sizes for mipmapping without GL_OES_texture_npot. */
+     if (!drv->mipmap_npot && ((w & (w - 1)) || (h & (h - 1))))
+          return false;
+
+     for (i = 0; i < GLES2_MIPMAPS; i++) {
+          if (drv->mipmaps[i].tex == drv->source_tex) {
+               if (drv->mipmaps[i].allocation == allocation && drv->mipmaps[i].id == allocation->object.id) {
+                    mipmap = &drv->mipmaps[i];
+                    break;
+               }
+
+               memset( &drv->mipmaps[i], 0, sizeof(GLES2Mipmap) );
+          }
+
+          /* Replace the least recently used entry. */
+          if (!mipmap || drv->mipmaps[i].used < mipmap->used)
+               mipmap = &drv->mipmaps[i];
      }
-     else if (drv->blittingflags & DSBLIT_ROTATE270) {
-          tex[0] = tx1; tex[1] = ty2;
-          tex[2] = tx1; tex[3] = ty1;
-          tex[4] = tx2; tex[5] = ty1;
-          tex[6] = tx2; tex[7] = ty2;
+
+     mipmap->used = ++drv->mipmap_stamp;
+
+     if (i < GLES2_MIPMAPS && mipmap->serial == allocation->serial.value)
+          return true;
+
+     D_DEBUG_AT( GLES2_2D, "  -> generating mipmaps for texture %u (%dx%d)\n", drv->source_tex, w, h );
+
+     /* The source texture is bound by SetState(). */
+     glGenerateMipmap( GL_TEXTURE_2D );
+
+     mipmap->tex        = drv->source_tex;
+     mipmap->allocation = allocation;
+     mipmap->id         = allocation->object.id;
+     mipmap->serial     = allocation->serial.value;
+
+     return true;
+}
+
+/*
+ * The scaler replaces bilinear filtering of enlarged sources only. A source reduced in either direction or not scaled
+ * at all is drawn with the program of the state without the scaler, the state is applied again for further commands.
+ */
+static void
+gles2_scale_check( GLES2DriverData    *drv,
+                   GLES2DeviceData    *dev,
+                   const DFBRectangle *srect,
+                   const DFBRectangle *drect )
+{
+     GLES2Pending      *pending = drv->pending;
+     GLES2PendingState  state;
+     GLES2DispatchKey   key;
+     int                dw      = drect->w;
+     int                dh      = drect->h;
+
+     if (drv->context->prog_index != BLIT_SCALE && drv->context->prog_index != BLIT_SCALE_MAT)
+          return;
+
+     if (drv->blittingflags & (DSBLIT_ROTATE90 | DSBLIT_ROTATE270)) {
+          dw = drect->h;
+          dh = drect->w;
      }
-     else {
-          tex[0] = tx1; tex[1] = ty1;
-          tex[2] = tx2; tex[3] = ty1;
-          tex[4] = tx2; tex[5] = ty2;
-          tex[6] = tx1; tex[7] = ty2;
+
+     if (dw >= srect->w && dh >= srect->h && (dw > srect->w || dh > srect->h))
+          return;
+
+     D_DEBUG_AT( GLES2_2D, "  -> source not enlarged, drawing without the scaler\n" );
+
+     state = pending->states[pending->num_states - 1];
+     key   = state.dispatch - dev->dispatch[GLES2AC_STRETCHBLIT];
+
+     state.dispatch = &dev->dispatch[GLES2AC_STRETCHBLIT][key & ~GLES2DK_SCALE];
+     state.mod_hw   = SMF_NONE;
+
+     gles2_apply_state( drv, dev, &state );
+
+     drv->reapply = true;
+}
+
+/*
+ * Use trilinear filtering if the source is reduced by more than half, bilinear filtering would skip texels.
+ */
+static void
+gles2_mipmap_filter( GLES2DriverData *drv,
+                     DFBRectangle    *srect,
+                     DFBRectangle    *drect )
+{
+     GLenum min_filter = GL_LINEAR;
+     int    dw         = drect->w;
+     int    dh         = drect->h;
+
+     if (drv->blittingflags & (DSBLIT_ROTATE90 | DSBLIT_ROTATE270)) {
+          dw = drect->h;
+          dh = drect->w;
      }
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
-     glVertexAttribPointer( GLES2VA_TEXCOORDS, 2, GL_FLOAT, GL_FALSE, 0, tex );
+     if ((srect->w > 2 * dw || srect->h > 2 * dh) && gles2_mipmap_validate( drv ))
+          min_filter = GL_LINEAR_MIPMAP_LINEAR;
 
-     glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
+     if (drv->min_filter != min_filter) {
+          if (drv->es3)
+               gles2_es3_sampler( drv, min_filter, drv->mag_filter );
+          else
+               glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter );
 
-     return true;
+          drv->min_filter = min_filter;
+     }
 }
 
 static bool
@@ -850,48 +3226,188 @@ gles2StretchBlit( void         *driver_data,
           x2, y2,
           x1, y2
      };
-     float            tx1   = srect->x;
-     float            ty1   = srect->y;
-     float            tx2   = srect->w + tx1;
-     float            ty2   = srect->h + ty1;
      GLfloat          tex[8];
 
      D_DEBUG_AT( GLES2_2D, "%s( [%2d], %4d,%4d-%4dx%4d <- %4d,%4d-%4dx%4d )\n", __FUNCTION__, 0,
                  DFB_RECTANGLE_VALS( drect ), DFB_RECTANGLE_VALS( srect ) );
 
-     if (drv->blittingflags & DSBLIT_ROTATE180) {
-          tex[0] = tx2; tex[1] = ty2;
-          tex[2] = tx1; tex[3] = ty2;
-          tex[4] = tx1; tex[5] = ty1;
-          tex[6] = tx2; tex[7] = ty1;
-     }
-     else if (drv->blittingflags & DSBLIT_ROTATE90) {
-          tex[0] = tx2; tex[1] = ty1;
-          tex[2] = tx2; tex[3] = ty2;
-          tex[4] = tx1; tex[5] = ty2;
-          tex[6] = tx1; tex[7] = ty1;
-     }
-     else if (drv->blittingflags & DSBLIT_ROTATE270) {
-          tex[0] = tx1; tex[1] = ty2;
-          tex[2] = tx1; tex[3] = ty1;
-          tex[4] = tx2; tex[5] = ty1;
-          tex[6] = tx2; tex[7] = ty2;
-     }
-     else {
-          tex[0] = tx1; tex[1] = ty1;
-          tex[2] = tx2; tex[3] = ty1;
-          tex[4] = tx2; tex[5] = ty2;
-          tex[6] = tx1; tex[7] = ty2;
-     }
+     gles2_pending_prepare( drv, device_data );
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
-     glVertexAttribPointer( GLES2VA_TEXCOORDS, 2, GL_FLOAT, GL_FALSE, 0, tex );
+     gles2_scale_check( drv, device_data, srect, drect );
 
-     glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
+     /* Optionally use mipmaps for minification, not with color keying (nearest filtering). */
+     if (drv->mipmap && drv->filter == GL_LINEAR)
+          gles2_mipmap_filter( drv, srect, drect );
+
+     gles2_texcoords( drv, srect, tex );
+
+     gles2_draw_quad( drv, pos, tex );
+
+     gles2_pending_release( drv );
 
      return true;
 }
 
+/*
+ * BatchBlit() vertex generation, without instanced drawing.
+ *
+ * The corners (x1, y1, x2, y2) of the destination and of the source rectangle are computed with vector instructions if
+ * available, in the same order of operations as scalar code to get the same results. Each rectangle is drawn as two
+ * triangles, positions are emitted in the order (x1,y1) (x2,y1) (x2,y2) (x2,y2) (x1,y1) (x1,y2), texture coordinates
+ * in the order given by the rotation. A kernel is generated for each rotation, to keep the flags out of the loop.
+ */
+
+#if defined(__SSE2__)
+
+typedef __m128 GLES2Corners;
+
+static inline void
+batch_corners( const DFBRectangle *rect,
+               const DFBPoint     *point,
+               GLES2Corners       *pos,
+               GLES2Corners       *tex )
+{
+     __m128 r  = _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*) rect ) );
+     __m128 p  = _mm_cvtepi32_ps( _mm_loadl_epi64( (const __m128i*) point ) );
+     __m128 wh = _mm_shuffle_ps( _mm_setzero_ps(), r, _MM_SHUFFLE( 3, 2, 0, 0 ) );
+
+     *pos = _mm_add_ps( _mm_movelh_ps( p, p ), wh );
+     *tex = _mm_add_ps( _mm_movelh_ps( r, r ), wh );
+}
+
+#define BATCH_STORE(dst,c,i0,i1,i2,i3) _mm_storeu_ps( dst, _mm_shuffle_ps( c, c, _MM_SHUFFLE( i3, i2, i1, i0 ) ) )
+
+#else
+
+typedef struct {
+     GLfloat v[4];
+} GLES2Corners;
+
+static inline void
+batch_corners( const DFBRectangle *rect,
+               const DFBPoint     *point,
+               GLES2Corners       *pos,
+               GLES2Corners       *tex )
+{
+#if defined(__ARM_NEON)
+     float32x4_t r  = vcvtq_f32_s32( vld1q_s32( &rect->x ) );
+     float32x2_t p  = vcvt_f32_s32( vld1_s32( &point->x ) );
+     float32x2_t wh = vget_high_f32( r );
+
+     vst1q_f32( pos->v, vcombine_f32( p, vadd_f32( p, wh ) ) );
+     vst1q_f32( tex->v, vcombine_f32( vget_low_f32( r ), vadd_f32( vget_low_f32( r ), wh ) ) );
+#else
+     pos->v[0] = point->x;
+     pos->v[1] = point->y;
+     pos->v[2] = rect->w + pos->v[0];
+     pos->v[3] = rect->h + pos->v[1];
+
+     tex->v[0] = rect->x;
+     tex->v[1] = rect->y;
+     tex->v[2] = rect->w + tex->v[0];
+     tex->v[3] = rect->h + tex->v[1];
+#endif
+}
+
+#define BATCH_STORE(dst,c,i0,i1,i2,i3)                                             \
+     do {                                                                          \
+          (dst)[0] = (c).v[i0];                                                    \
+          (dst)[1] = (c).v[i1];                                                    \
+          (dst)[2] = (c).v[i2];                                                    \
+          (dst)[3] = (c).v[i3];                                                    \
+     } while (0)
+
+#endif
+
+#define BATCH_KERNEL(rotation,a0,a1,a2,a3,b0,b1,b2,b3,c0,c1,c2,c3)                 \
+static void                                                                        \
+batch_kernel_##rotation( const DFBRectangle *rects,                                \
+                         const DFBPoint     *points,                               \
+                         unsigned int        num,                                  \
+                         GLfloat            *pos,                                  \
+                         GLfloat            *tex )                                 \
+{                                                                                  \
+     unsigned int i;                                                               \
+                                                                                   \
+     for (i = 0; i < num; i++, pos += 12, tex += 12) {                             \
+          GLES2Corners p, t;                                                       \
+                                                                                   \
+          batch_corners( &rects[i], &points[i], &p, &t );                          \
+                                                                                   \
+          BATCH_STORE( pos + 0, p,  0,  1,  2,  1 );                               \
+          BATCH_STORE( pos + 4, p,  2,  3,  2,  3 );                               \
+          BATCH_STORE( pos + 8, p,  0,  1,  0,  3 );                               \
+                                                                                   \
+          BATCH_STORE( tex + 0, t, a0, a1, a2, a3 );                               \
+          BATCH_STORE( tex + 4, t, b0, b1, b2, b3 );                               \
+          BATCH_STORE( tex + 8, t, c0, c1, c2, c3 );                               \
+     }                                                                             \
+}
+
+BATCH_KERNEL( ROTATE0,   0, 1, 2, 1,  2, 3, 2, 3,  0, 1, 0, 3 )
+BATCH_KERNEL( ROTATE90,  2, 1, 2, 3,  0, 3, 0, 3,  2, 1, 0, 1 )
+BATCH_KERNEL( ROTATE180, 2, 3, 0, 3,  0, 1, 0, 1,  2, 3, 2, 1 )
+BATCH_KERNEL( ROTATE270, 0, 3, 0, 1,  2, 1, 2, 1,  0, 3, 2, 3 )
+
+/*
+ * Anti-aliased blits, transformed by the render options matrix, drawn at once.
+ */
+static void
+gles2_aa_batch( GLES2DriverData    *drv,
+                const DFBRectangle *rects,
+                const DFBPoint     *points,
+                unsigned int        num )
+{
+     GLfloat      pos[num*12];
+     GLfloat      tex[num*12];
+     GLfloat      edges[num*24];
+     unsigned int i, n = 0;
+
+     for (i = 0; i < num; i++) {
+          float   x1        = points[i].x;
+          float   y1        = points[i].y;
+          float   x2        = rects[i].w + x1;
+          float   y2        = rects[i].h + y1;
+          GLfloat corners[] = {
+               x1, y1,
+               x2, y1,
+               x2, y2,
+               x1, y2
+          };
+          GLfloat texcoords[8];
+
+          gles2_texcoords( drv, &rects[i], texcoords );
+
+          n += gles2_aa_polygon( corners, texcoords, 4, drv->margin, pos + n * 2, tex + n * 2, edges + n * 4 );
+     }
+
+     gles2_aa_draw( drv, pos, tex, edges, n );
+}
+
+/*
+ * Blits drawn as instances of the unit square.
+ */
+static void
+gles2_batch_instances( GLES2DriverData    *drv,
+                       const DFBRectangle *rects,
+                       const DFBPoint     *points,
+                       unsigned int        num )
+{
+     GLfloat      instances[num*6];
+     unsigned int i;
+
+     for (i = 0; i < num; i++) {
+          instances[i*6+0] = points[i].x;
+          instances[i*6+1] = points[i].y;
+          instances[i*6+2] = rects[i].w;
+          instances[i*6+3] = rects[i].h;
+          instances[i*6+4] = rects[i].x;
+          instances[i*6+5] = rects[i].y;
+     }
+
+     gles2_draw_instances( drv, instances, num, true );
+}
+
 static bool
 gles2BatchBlit( void               *driver_data,
                 void               *device_data,
@@ -900,89 +3416,81 @@ gles2BatchBlit( void               *driver_data,
                 unsigned int        num,
                 unsigned int       *ret_num )
 {
-     GLES2DriverData *drv = driver_data;
-     float            x1, y1, x2, y2;
-     GLfloat          pos[num*12];
-     float            tx1, ty1, tx2, ty2;
-     GLfloat          tex[num*12];
-     int              i;
+     GLES2DriverData       *drv = driver_data;
+     GLfloat                pos[num*12];
+     GLfloat                tex[num*12];
+     GLES2VertexArray       arrays[] = {
+          { GLES2VA_POSITIONS, 2, 0, pos, sizeof(pos) },
+          { GLES2VA_TEXCOORDS, 2, 0, tex, sizeof(tex) }
+     };
+     DFBRectangle           slots[num];
+     const GLES2AtlasEntry *atlas;
+     unsigned int           i;
 
-     for (i = 0; i < num; i++) {
-          D_DEBUG_AT( GLES2_2D, "%s( [%2d] %4d,%4d-%4dx%4d <- %4d,%4d )\n", __FUNCTION__, i,
+     for (i = 0; i < num; i++)
+          D_DEBUG_AT( GLES2_2D, "%s( [%2u] %4d,%4d-%4dx%4d <- %4d,%4d )\n", __FUNCTION__, i,
                       points[i].x, points[i].y, rects[i].w, rects[i].h, rects[i].x, rects[i].y );
 
-          x1 = points[i].x;
-          y1 = points[i].y;
-          x2 = rects[i].w + x1;
-          y2 = rects[i].h + y1;
-
-          pos[i*12+0]  = x1; pos[i*12+1]  = y1;
-          pos[i*12+2]  = x2; pos[i*12+3]  = y1;
-          pos[i*12+4]  = x2; pos[i*12+5]  = y2;
-
-          pos[i*12+6]  = x2; pos[i*12+7]  = y2;
-          pos[i*12+8]  = x1; pos[i*12+9]  = y1;
-          pos[i*12+10] = x1; pos[i*12+11] = y2;
-
-          tx1 = rects[i].x;
-          ty1 = rects[i].y;
-          tx2 = rects[i].w + tx1;
-          ty2 = rects[i].h + ty1;
+     atlas = gles2_pending_source( drv, device_data );
 
-          if (drv->blittingflags & DSBLIT_ROTATE180) {
-               tex[i*12+0]  = tx2; tex[i*12+1]  = ty2;
-               tex[i*12+2]  = tx1; tex[i*12+3]  = ty2;
-               tex[i*12+4]  = tx1; tex[i*12+5]  = ty1;
+     gles2_pending_prepare( drv, device_data );
 
-               tex[i*12+6]  = tx1; tex[i*12+7]  = ty1;
-               tex[i*12+8]  = tx2; tex[i*12+9]  = ty2;
-               tex[i*12+10] = tx2; tex[i*12+11] = ty1;
+     /* Blit from the slot of the copy in the atlas page. */
+     if (atlas) {
+          for (i = 0; i < num; i++) {
+               slots[i]    = rects[i];
+               slots[i].x += atlas->slot.x;
+               slots[i].y += atlas->slot.y;
           }
-          else if (drv->blittingflags & DSBLIT_ROTATE90) {
-               tex[i*12+0]  = tx2; tex[i*12+1]  = ty1;
-               tex[i*12+2]  = tx2; tex[i*12+3]  = ty2;
-               tex[i*12+4]  = tx1; tex[i*12+5]  = ty2;
 
-               tex[i*12+6]  = tx1; tex[i*12+7]  = ty2;
-               tex[i*12+8]  = tx2; tex[i*12+9]  = ty1;
-               tex[i*12+10] = tx1; tex[i*12+11] = ty1;
-          }
-          else if (drv->blittingflags & DSBLIT_ROTATE270) {
-               tex[i*12+0]  = tx1; tex[i*12+1]  = ty2;
-               tex[i*12+2]  = tx1; tex[i*12+3]  = ty1;
-               tex[i*12+4]  = tx2; tex[i*12+5]  = ty1;
+          rects = slots;
+     }
 
-               tex[i*12+6]  = tx2; tex[i*12+7]  = ty1;
-               tex[i*12+8]  = tx1; tex[i*12+9]  = ty2;
-               tex[i*12+10] = tx2; tex[i*12+11] = ty2;
-          }
-          else {
-               tex[i*12+0]  = tx1; tex[i*12+1]  = ty1;
-               tex[i*12+2]  = tx2; tex[i*12+3]  = ty1;
-               tex[i*12+4]  = tx2; tex[i*12+5]  = ty2;
+     if (drv->antialias) {
+          gles2_aa_batch( drv, rects, points, num );
+          gles2_pending_release( drv );
+          return true;
+     }
 
-               tex[i*12+6]  = tx2; tex[i*12+7]  = ty2;
-               tex[i*12+8]  = tx1; tex[i*12+9]  = ty1;
-               tex[i*12+10] = tx1; tex[i*12+11] = ty2;
-          }
+     if (drv->DrawArraysInstanced) {
+          gles2_batch_instances( drv, rects, points, num );
+          gles2_pending_release( drv );
+          return true;
      }
 
-     glVertexAttribPointer( GLES2VA_POSITIONS, 2, GL_FLOAT, GL_FALSE, 0, pos );
-     glVertexAttribPointer( GLES2VA_TEXCOORDS, 2, GL_FLOAT, GL_FALSE, 0, tex );
+     if (drv->blittingflags & DSBLIT_ROTATE180)
+          batch_kernel_ROTATE180( rects, points, num, pos, tex );
+     else if (drv->blittingflags & DSBLIT_ROTATE90)
+          batch_kernel_ROTATE90( rects, points, num, pos, tex );
+     else if (drv->blittingflags & DSBLIT_ROTATE270)
+          batch_kernel_ROTATE270( rects, points, num, pos, tex );
+     else
+          batch_kernel_ROTATE0( rects, points, num, pos, tex );
+
+     gles2_vertex_arrays( drv, arrays, 2 );
 
      glDrawArrays( GL_TRIANGLES, 0, num * 6 );
 
+     gles2_pending_release( drv );
+
      return true;
 }
 
 const GraphicsDeviceFuncs gles2GraphicsDeviceFuncs = {
-     .CheckState    = gles2CheckState,
-     .SetState      = gles2SetState,
-     .FillRectangle = gles2FillRectangle,
-     .DrawRectangle = gles2DrawRectangle,
-     .DrawLine      = gles2DrawLine,
-     .FillTriangle  = gles2FillTriangle,
-     .Blit          = gles2Blit,
-     .StretchBlit   = gles2StretchBlit,
-     .BatchBlit     = gles2BatchBlit
+     .EmitCommands      = gles2EmitCommands,
+     .EngineSync        = gles2EngineSync,
+     .FlushTextureCache = gles2FlushTextureCache,
+     .GetSerial         = gles2GetSerial,
+     .WaitSerial        = gles2WaitSerial,
+     .CheckState        = gles2CheckState,
+     .SetState          = gles2SetState,
+     .FillRectangle     = gles2FillRectangle,
+     .BatchFill         = gles2BatchFill,
+     .DrawRectangle     = gles2DrawRectangle,
+     .DrawLine          = gles2DrawLine,
+     .FillTriangle      = gles2FillTriangle,
+     .FillQuadrangles   = gles2FillQuadrangles,
+     .Blit              = gles2Blit,
+     .StretchBlit       = gles2StretchBlit,
+     .BatchBlit         = gles2BatchBlit
 };
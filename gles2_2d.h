@@ -0,0 +1,53 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_2D_H__
+#define __GLES2_2D_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Precompute the program and the states to validate for each function class and flags combination.
+ */
+void gles2_init_dispatch  ( GLES2DeviceData  *dev );
+
+/*
+ * Initialize the lock of the surfaces listened to for the invalidation of framebuffer objects, or detach the listeners.
+ */
+void gles2_watch_init     ( GLES2DriverData  *drv );
+
+void gles2_watch_deinit   ( GLES2DriverData  *drv );
+
+/*
+ * Delete the framebuffer objects of destination textures cached for a context, only forgetting them if the context
+ * is not current.
+ */
+void gles2_fbo_deinit     ( GLES2Framebuffer *fbos,
+                            bool              current );
+
+/*
+ * Execute a batch of pending commands in a context, switching to it first.
+ */
+void gles2_pending_execute( GLES2DriverData  *drv,
+                            GLES2DeviceData  *dev,
+                            GLES2Pending     *pending,
+                            GLES2Context     *context );
+
+#endif
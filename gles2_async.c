@@ -0,0 +1,320 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/gfxcard.h>
+
+#include "gles2_2d.h"
+#include "gles2_async.h"
+#include "gles2_context.h"
+#include "gles2_es3.h"
+
+D_DEBUG_DOMAIN( GLES2_Async, "GLES2/Async", "OpenGL ES 2.0 Asynchronous Submission" );
+
+/**********************************************************************************************************************/
+
+/*
+ * The ring indices are only written by one side each, the driver writes the head, the submission thread the tail and
+ * the number of completed batches. The lock is only taken for sleeping and waking up.
+ */
+
+static void
+async_execute( GLES2DriverData *drv,
+               unsigned int     slot )
+{
+     GLES2Async *async = &drv->async;
+
+     D_DEBUG_AT( GLES2_Async, "%s( %u )\n", __FUNCTION__, slot );
+
+     /* Wait for the commands issued in the driver context before the batch was submitted, e.g. texture uploads. */
+     if (async->syncs[slot] != EGL_NO_SYNC_KHR) {
+          drv->ClientWaitSyncKHR( drv->display, async->syncs[slot], 0, EGL_FOREVER_KHR );
+          drv->DestroySyncKHR( drv->display, async->syncs[slot] );
+     }
+
+     gles2_pending_execute( drv, async->device_data, &async->slots[slot], &async->context );
+
+     /* Start the execution on the GPU while the next batch is recorded. */
+     glFlush();
+}
+
+static void *
+async_thread( DirectThread *thread,
+              void         *arg )
+{
+     GLES2DriverData *drv   = arg;
+     GLES2Async      *async = &drv->async;
+     unsigned int     tail  = 0;
+     bool             quit  = false;
+     EGLBoolean       current;
+
+     D_DEBUG_AT( GLES2_Async, "%s()\n", __FUNCTION__ );
+
+     eglBindAPI( EGL_OPENGL_ES_API );
+
+     current = eglMakeCurrent( drv->display, EGL_NO_SURFACE, EGL_NO_SURFACE, async->context.context );
+
+     direct_mutex_lock( &async->lock );
+
+     async->started = true;
+     async->failed  = !current;
+
+     direct_waitqueue_broadcast( &async->idle );
+
+     direct_mutex_unlock( &async->lock );
+
+     if (!current) {
+          D_ERROR( "GLES2/Async: Failed to make context current (0x%04x)!\n", eglGetError() );
+          return NULL;
+     }
+
+     while (!quit) {
+          if (__atomic_load_n( &async->head, __ATOMIC_SEQ_CST ) != tail) {
+               async_execute( drv, tail % GLES2_ASYNC_SLOTS );
+
+               __atomic_store_n( &async->tail, ++tail, __ATOMIC_SEQ_CST );
+
+               /* The driver waits for a free slot. */
+               if (__atomic_load_n( &async->waiting, __ATOMIC_SEQ_CST )) {
+                    direct_mutex_lock( &async->lock );
+                    direct_waitqueue_broadcast( &async->idle );
+                    direct_mutex_unlock( &async->lock );
+               }
+
+               continue;
+          }
+
+          /* Complete the executed batches before telling the driver, its context can use the results then. */
+          if (async->completed != tail)
+               glFinish();
+
+          direct_mutex_lock( &async->lock );
+
+          __atomic_store_n( &async->completed, tail, __ATOMIC_RELEASE );
+
+          direct_waitqueue_broadcast( &async->idle );
+
+          __atomic_store_n( &async->sleeping, true, __ATOMIC_SEQ_CST );
+
+          while (__atomic_load_n( &async->head, __ATOMIC_SEQ_CST ) == tail && !async->quit)
+               direct_waitqueue_wait( &async->wakeup, &async->lock );
+
+          __atomic_store_n( &async->sleeping, false, __ATOMIC_SEQ_CST );
+
+          /* All batches have been drained before. */
+          quit = async->quit;
+
+          direct_mutex_unlock( &async->lock );
+     }
+
+     D_DEBUG_AT( GLES2_Async, "  -> exiting after %u batches\n", tail );
+
+     gles2_fbo_deinit( async->context.fbos, true );
+
+     gles2_es3_context_deinit( drv, &async->context, true );
+
+     eglMakeCurrent( drv->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+
+     return NULL;
+}
+
+static void
+async_cleanup( GLES2DriverData *drv )
+{
+     GLES2Async *async = &drv->async;
+
+     direct_waitqueue_deinit( &async->idle );
+     direct_waitqueue_deinit( &async->wakeup );
+     direct_mutex_deinit( &async->lock );
+
+     eglDestroyContext( drv->display, async->context.context );
+
+     D_FREE( async->slots );
+
+     memset( async, 0, sizeof(GLES2Async) );
+
+     drv->pending = &drv->batch;
+}
+
+/**********************************************************************************************************************/
+
+DFBResult
+gles2_async_init( GLES2DriverData *drv,
+                  GLES2DeviceData *dev )
+{
+     DFBResult   ret;
+     GLES2Async *async = &drv->async;
+
+     D_DEBUG_AT( GLES2_Async, "%s()\n", __FUNCTION__ );
+
+     /* Batches wait for the driver context with fences, framebuffer objects are needed without a window surface. */
+     if (!drv->CreateSyncKHR || !drv->fbo_cache) {
+          D_ERROR( "GLES2/Async: Fence sync and framebuffer object cache required!\n" );
+          return DFB_UNSUPPORTED;
+     }
+
+     /* Query objects are not shared between contexts. */
+     if (dev->stats.gpu_timing) {
+          D_ERROR( "GLES2/Async: Not supported with GPU timing!\n" );
+          return DFB_UNSUPPORTED;
+     }
+
+     if (!drv->surfaceless) {
+          D_ERROR( "GLES2/Async: EGL_KHR_surfaceless_context required!\n" );
+          return DFB_UNSUPPORTED;
+     }
+
+     /* The submission thread has its own context, not in the pool of the threads calling the driver. */
+     ret = gles2_context_create( drv, &async->context );
+     if (ret)
+          return ret;
+
+     async->slots = D_CALLOC( GLES2_ASYNC_SLOTS, sizeof(GLES2Pending) );
+     if (!async->slots) {
+          eglDestroyContext( drv->display, async->context.context );
+          memset( &async->context, 0, sizeof(GLES2Context) );
+          return D_OOM();
+     }
+
+     async->device_data = dev;
+
+     direct_mutex_init( &async->lock );
+     direct_waitqueue_init( &async->wakeup );
+     direct_waitqueue_init( &async->idle );
+
+     /* Record the batches in the ring. */
+     drv->pending = &async->slots[0];
+
+     async->thread = direct_thread_create( DTT_DEFAULT, async_thread, drv, "GLES2 Submit" );
+     if (!async->thread) {
+          async_cleanup( drv );
+          return DFB_INIT;
+     }
+
+     direct_mutex_lock( &async->lock );
+
+     while (!async->started)
+          direct_waitqueue_wait( &async->idle, &async->lock );
+
+     direct_mutex_unlock( &async->lock );
+
+     if (async->failed) {
+          direct_thread_join( async->thread );
+          direct_thread_destroy( async->thread );
+
+          async_cleanup( drv );
+          return DFB_INIT;
+     }
+
+     D_INFO( "GLES2/Async: Executing batches rendering offscreen in a submission thread\n" );
+
+     return DFB_OK;
+}
+
+void
+gles2_async_deinit( GLES2DriverData *drv )
+{
+     GLES2Async *async = &drv->async;
+
+     D_DEBUG_AT( GLES2_Async, "%s()\n", __FUNCTION__ );
+
+     if (!async->thread)
+          return;
+
+     gles2_async_drain( drv );
+
+     direct_mutex_lock( &async->lock );
+
+     async->quit = true;
+
+     direct_waitqueue_signal( &async->wakeup );
+
+     direct_mutex_unlock( &async->lock );
+
+     direct_thread_join( async->thread );
+     direct_thread_destroy( async->thread );
+
+     async_cleanup( drv );
+}
+
+GLES2Pending *
+gles2_async_next( GLES2DriverData *drv )
+{
+     GLES2Async   *async = &drv->async;
+     unsigned int  head  = async->head;
+
+     /* The slot after the current one must have been executed. */
+     if (head + 1 - __atomic_load_n( &async->tail, __ATOMIC_ACQUIRE ) >= GLES2_ASYNC_SLOTS) {
+          D_DEBUG_AT( GLES2_Async, "%s() -> waiting for a free slot\n", __FUNCTION__ );
+
+          direct_mutex_lock( &async->lock );
+
+          __atomic_store_n( &async->waiting, true, __ATOMIC_SEQ_CST );
+
+          while (head + 1 - __atomic_load_n( &async->tail, __ATOMIC_SEQ_CST ) >= GLES2_ASYNC_SLOTS)
+               direct_waitqueue_wait( &async->idle, &async->lock );
+
+          __atomic_store_n( &async->waiting, false, __ATOMIC_SEQ_CST );
+
+          direct_mutex_unlock( &async->lock );
+     }
+
+     return &async->slots[(head + 1) % GLES2_ASYNC_SLOTS];
+}
+
+void
+gles2_async_submit( GLES2DriverData *drv )
+{
+     GLES2Async   *async = &drv->async;
+     unsigned int  slot  = async->head % GLES2_ASYNC_SLOTS;
+
+     D_DEBUG_AT( GLES2_Async, "%s( %u ) <- %u commands\n", __FUNCTION__, slot, async->slots[slot].num_commands );
+
+     async->syncs[slot] = drv->CreateSyncKHR( drv->display, EGL_SYNC_FENCE_KHR, NULL );
+
+     /* The fence must be flushed to be signaled, without a fence all commands are completed. */
+     if (async->syncs[slot] != EGL_NO_SYNC_KHR)
+          glFlush();
+     else
+          glFinish();
+
+     __atomic_store_n( &async->head, async->head + 1, __ATOMIC_SEQ_CST );
+
+     if (__atomic_load_n( &async->sleeping, __ATOMIC_SEQ_CST )) {
+          direct_mutex_lock( &async->lock );
+          direct_waitqueue_signal( &async->wakeup );
+          direct_mutex_unlock( &async->lock );
+     }
+}
+
+void
+gles2_async_drain( GLES2DriverData *drv )
+{
+     GLES2Async *async = &drv->async;
+
+     if (__atomic_load_n( &async->completed, __ATOMIC_ACQUIRE ) == async->head)
+          return;
+
+     D_DEBUG_AT( GLES2_Async, "%s() -> waiting for %u batches\n", __FUNCTION__, async->head - async->completed );
+
+     direct_mutex_lock( &async->lock );
+
+     while (async->completed != async->head)
+          direct_waitqueue_wait( &async->idle, &async->lock );
+
+     direct_mutex_unlock( &async->lock );
+}
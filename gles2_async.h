@@ -0,0 +1,52 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_ASYNC_H__
+#define __GLES2_ASYNC_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Batches rendering into offscreen surfaces are executed by a submission thread with its own context sharing the
+ * objects of the driver context. The driver records a batch in a slot of a single producer, single consumer ring
+ * and waits for the thread before executing commands itself.
+ */
+
+DFBResult     gles2_async_init  ( GLES2DriverData *drv,
+                                  GLES2DeviceData *dev );
+
+void          gles2_async_deinit( GLES2DriverData *drv );
+
+/*
+ * Return the slot to record the next batch in, waiting until the submission thread has executed the batch in it.
+ */
+GLES2Pending *gles2_async_next  ( GLES2DriverData *drv );
+
+/*
+ * Pass the batch recorded in the current slot to the submission thread.
+ */
+void          gles2_async_submit( GLES2DriverData *drv );
+
+/*
+ * Wait until the submitted batches have been executed and completed by the GPU.
+ */
+void          gles2_async_drain ( GLES2DriverData *drv );
+
+#endif
@@ -0,0 +1,329 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/state.h>
+#include <core/surface.h>
+#include <core/surface_allocation.h>
+#include <direct/conf.h>
+
+#include "gles2_atlas.h"
+
+D_DEBUG_DOMAIN( GLES2_Atlas, "GLES2/Atlas", "OpenGL ES 2.0 Texture Atlas" );
+
+/**********************************************************************************************************************/
+
+/* Shelves are used by slots of the same height, rounded up to reduce the number of shelves. */
+#define SHELF_HEIGHT(h) (((h) + 7) & ~7)
+
+static void
+atlas_release( GLES2AtlasEntry *entry )
+{
+     D_DEBUG_AT( GLES2_Atlas, "%s( texture %u )\n", __FUNCTION__, entry->tex );
+
+     memset( entry, 0, sizeof(GLES2AtlasEntry) );
+}
+
+/*
+ * Check if the source texture can be attached to a framebuffer object for copying, with the context of the calling
+ * thread.
+ */
+static bool
+atlas_copyable( GLuint tex )
+{
+     GLint  bound;
+     GLuint fbo;
+     GLenum status;
+
+     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &bound );
+
+     glGenFramebuffers( 1, &fbo );
+     glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+     glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0 );
+
+     status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, bound );
+     glDeleteFramebuffers( 1, &fbo );
+
+     return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+/*
+ * Allocate a slot in a shelf of the same height, or in a new shelf.
+ */
+static bool
+atlas_allocate( GLES2AtlasPage *page,
+                int             size,
+                int             w,
+                int             h,
+                DFBPoint       *ret_slot )
+{
+     GLES2AtlasShelf *shelf;
+     int              height = SHELF_HEIGHT( h );
+     unsigned int     i;
+
+     for (i = 0; i < page->num_shelves; i++) {
+          shelf = &page->shelves[i];
+
+          if (shelf->h == height && shelf->x + w <= size)
+               break;
+     }
+
+     if (i == page->num_shelves) {
+          if (page->num_shelves == GLES2_ATLAS_SHELVES || page->top + height > size)
+               return false;
+
+          shelf = &page->shelves[page->num_shelves++];
+
+          shelf->x = 0;
+          shelf->y = page->top;
+          shelf->h = height;
+
+          page->top += height;
+     }
+
+     ret_slot->x = shelf->x;
+     ret_slot->y = shelf->y;
+
+     shelf->x += w;
+
+     return true;
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_atlas_init( GLES2DriverData *drv,
+                  GLES2DeviceData *dev )
+{
+     GLES2Atlas *atlas = &drv->atlas;
+
+     D_DEBUG_AT( GLES2_Atlas, "%s()\n", __FUNCTION__ );
+
+     atlas->size     = D_MIN( GLES2_ATLAS_SIZE, dev->max_texture_size );
+     atlas->max_size = D_MIN( direct_config_get_int_value_with_default( "gles2-atlas", 64 ), atlas->size );
+
+     if (atlas->max_size <= 0) {
+          atlas->max_size = 0;
+          return;
+     }
+
+     D_INFO( "GLES2/Atlas: Copying blit sources up to %dx%d into %dx%d atlas textures\n",
+             atlas->max_size, atlas->max_size, atlas->size, atlas->size );
+}
+
+void
+gles2_atlas_deinit( GLES2DriverData *drv )
+{
+     GLES2Atlas   *atlas = &drv->atlas;
+     unsigned int  i;
+
+     D_DEBUG_AT( GLES2_Atlas, "%s()\n", __FUNCTION__ );
+
+     for (i = 0; i < GLES2_ATLAS_ENTRIES; i++) {
+          if (atlas->entries[i].tex)
+               atlas_release( &atlas->entries[i] );
+     }
+
+     for (i = 0; i < GLES2_ATLAS_PAGES; i++) {
+          if (atlas->pages[i].tex)
+               glDeleteTextures( 1, &atlas->pages[i].tex );
+     }
+
+     memset( atlas, 0, sizeof(GLES2Atlas) );
+}
+
+DFBResult
+gles2_atlas_lookup( GLES2DriverData  *drv,
+                    const CardState  *state,
+                    GLES2AtlasEntry **ret_entry,
+                    bool             *ret_copy )
+{
+     GLES2Atlas            *atlas      = &drv->atlas;
+     GLuint                 tex        = (GLuint)(long) state->src.handle;
+     CoreSurfaceAllocation *allocation = state->src.allocation;
+     int                    w          = state->source->config.size.w;
+     int                    h          = state->source->config.size.h;
+     GLES2AtlasEntry       *entry      = NULL;
+     GLES2AtlasPage        *page;
+     unsigned int           i;
+
+     /* Only formats copied into the RGBA pages without a change of components. */
+     if (!tex || w > atlas->max_size || h > atlas->max_size ||
+         (state->source->config.format != DSPF_ARGB && state->source->config.format != DSPF_ABGR))
+          return DFB_UNSUPPORTED;
+
+     for (i = 0; i < GLES2_ATLAS_ENTRIES; i++) {
+          if (atlas->entries[i].tex == tex) {
+               if (atlas->entries[i].allocation == allocation && atlas->entries[i].id == allocation->object.id) {
+                    entry = &atlas->entries[i];
+                    break;
+               }
+
+               /* The texture name has been reused by another allocation, the copy is outdated. */
+               atlas_release( &atlas->entries[i] );
+          }
+
+          /* Replace the least recently used entry. */
+          if (!entry || atlas->entries[i].used < entry->used)
+               entry = &atlas->entries[i];
+     }
+
+     if (i == GLES2_ATLAS_ENTRIES) {
+          if (eglGetCurrentContext() == EGL_NO_CONTEXT)
+               return DFB_UNSUPPORTED;
+
+          if (entry->tex)
+               atlas_release( entry );
+
+          entry->tex        = tex;
+          entry->allocation = allocation;
+          entry->id         = allocation->object.id;
+
+          /* Remember the texture to not check it again. */
+          if (!atlas_copyable( tex ))
+               entry->changes = GLES2_ATLAS_CHANGES;
+
+          D_DEBUG_AT( GLES2_Atlas, "  -> new entry for texture %u (%dx%d)%s\n", tex, w, h,
+                      entry->changes ? ", not copyable" : "" );
+     }
+
+     entry->used = ++atlas->stamp;
+
+     if (entry->page) {
+          if (entry->serial == allocation->serial.value) {
+               entry->page->used = atlas->stamp;
+
+               *ret_entry = entry;
+               *ret_copy  = false;
+
+               return DFB_OK;
+          }
+
+          /* Slots are not reused, pending commands may still draw from the previous copy. */
+          entry->page = NULL;
+          entry->changes++;
+     }
+
+     /* Sources modified frequently are not copied. */
+     if (entry->changes >= GLES2_ATLAS_CHANGES)
+          return DFB_UNSUPPORTED;
+
+     for (i = 0; i < GLES2_ATLAS_PAGES; i++) {
+          page = &atlas->pages[i];
+
+          if (atlas_allocate( page, atlas->size, w, h, &entry->slot )) {
+               D_DEBUG_AT( GLES2_Atlas, "  -> copying texture %u to page %u at %d,%d\n",
+                           tex, i, entry->slot.x, entry->slot.y );
+
+               entry->page   = page;
+               entry->serial = allocation->serial.value;
+               page->used    = atlas->stamp;
+
+               *ret_entry = entry;
+               *ret_copy  = true;
+
+               return DFB_OK;
+          }
+     }
+
+     return DFB_LIMITEXCEEDED;
+}
+
+bool
+gles2_atlas_valid( const GLES2AtlasEntry *entry,
+                   const GLES2AtlasPage  *page,
+                   const CardState       *state )
+{
+     return entry->page == page && entry->tex == (GLuint)(long) state->src.handle &&
+            entry->allocation == state->src.allocation && entry->id == state->src.allocation->object.id &&
+            entry->serial == state->src.allocation->serial.value;
+}
+
+void
+gles2_atlas_evict( GLES2DriverData *drv )
+{
+     GLES2Atlas     *atlas = &drv->atlas;
+     GLES2AtlasPage *page  = &atlas->pages[0];
+     unsigned int    i;
+
+     for (i = 1; i < GLES2_ATLAS_PAGES; i++) {
+          if (atlas->pages[i].used < page->used)
+               page = &atlas->pages[i];
+     }
+
+     D_DEBUG_AT( GLES2_Atlas, "%s( page %u )\n", __FUNCTION__, (unsigned int) (page - atlas->pages) );
+
+     /* The sources are copied again on their next use. */
+     for (i = 0; i < GLES2_ATLAS_ENTRIES; i++) {
+          if (atlas->entries[i].page == page)
+               atlas->entries[i].page = NULL;
+     }
+
+     page->num_shelves = 0;
+     page->top         = 0;
+}
+
+void
+gles2_atlas_upload( GLES2DriverData        *drv,
+                    const GLES2AtlasUpload *uploads,
+                    unsigned int            num )
+{
+     GLint        bound_fbo, bound_tex;
+     GLuint       fbo;
+     unsigned int i;
+
+     D_DEBUG_AT( GLES2_Atlas, "%s( %u )\n", __FUNCTION__, num );
+
+     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &bound_fbo );
+     glGetIntegerv( GL_TEXTURE_BINDING_2D, &bound_tex );
+
+     /* The source is read by attaching it to a framebuffer object, which is not shared between contexts. */
+     glGenFramebuffers( 1, &fbo );
+     glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+
+     for (i = 0; i < num; i++) {
+          const GLES2AtlasUpload *upload = &uploads[i];
+          GLES2AtlasPage         *page   = upload->page;
+
+          if (!page->tex) {
+               glGenTextures( 1, &page->tex );
+               glBindTexture( GL_TEXTURE_2D, page->tex );
+               glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, drv->atlas.size, drv->atlas.size, 0, GL_RGBA,
+                             GL_UNSIGNED_BYTE, NULL );
+
+               glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+               glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+               glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+               glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+               D_DEBUG_AT( GLES2_Atlas, "  -> created page texture %u\n", page->tex );
+          }
+          else
+               glBindTexture( GL_TEXTURE_2D, page->tex );
+
+          glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, upload->tex, 0 );
+
+          glCopyTexSubImage2D( GL_TEXTURE_2D, 0, upload->slot.x, upload->slot.y, 0, 0, upload->w, upload->h );
+     }
+
+     glBindFramebuffer( GL_FRAMEBUFFER, bound_fbo );
+     glDeleteFramebuffers( 1, &fbo );
+
+     glBindTexture( GL_TEXTURE_2D, bound_tex );
+}
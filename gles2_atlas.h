@@ -0,0 +1,71 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_ATLAS_H__
+#define __GLES2_ATLAS_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Small blit sources are copied into shared atlas textures on first use, blits from different sources in the same page
+ * are then drawn with one texture binding. The pages are filled with shelves of slots, a page is evicted as a whole
+ * when there's no room left. A source modified after its copy is copied again into a new slot, up to
+ * GLES2_ATLAS_CHANGES times. Entries are identified by the texture, the allocation and its object id, no listener is
+ * attached to the sources.
+ */
+
+/*
+ * Enable the atlas for sources up to the size given by the gles2-atlas option.
+ */
+void      gles2_atlas_init  ( GLES2DriverData        *drv,
+                              GLES2DeviceData        *dev );
+
+void      gles2_atlas_deinit( GLES2DriverData        *drv );
+
+/*
+ * Look up the copy of the source of a blitting state, allocating a slot for a new or modified source. Returns
+ * DFB_UNSUPPORTED if the source is not copied and DFB_LIMITEXCEEDED if there's no room left in the pages, otherwise
+ * tells whether the source still has to be copied into the slot.
+ */
+DFBResult gles2_atlas_lookup( GLES2DriverData        *drv,
+                              const CardState        *state,
+                              GLES2AtlasEntry       **ret_entry,
+                              bool                   *ret_copy );
+
+/*
+ * Check if the copy in the page is up to date, i.e. made after the last write to the source of the state.
+ */
+bool      gles2_atlas_valid ( const GLES2AtlasEntry  *entry,
+                              const GLES2AtlasPage   *page,
+                              const CardState        *state );
+
+/*
+ * Free all slots of the least recently used page, after the commands drawing from it have been submitted.
+ */
+void      gles2_atlas_evict ( GLES2DriverData        *drv );
+
+/*
+ * Copy the sources into their slots, creating the pages on first use. The bound framebuffer and texture are kept.
+ */
+void      gles2_atlas_upload( GLES2DriverData        *drv,
+                              const GLES2AtlasUpload *uploads,
+                              unsigned int            num );
+
+#endif
@@ -0,0 +1,272 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/gfxcard.h>
+
+#include "gles2_2d.h"
+#include "gles2_context.h"
+#include "gles2_es3.h"
+
+D_DEBUG_DOMAIN( GLES2_Context, "GLES2/Context", "OpenGL ES 2.0 Contexts" );
+
+/**********************************************************************************************************************/
+
+static void
+context_reset( GLES2Context *context )
+{
+     int i;
+
+     /* No program is used yet. */
+     context->prog_index = INVALID_PROGRAM;
+
+     for (i = 0; i < NUM_PROGRAMS; i++)
+          context->flags[i] = NONE;
+
+     /* The framebuffer bound by the system module is remembered when binding the first framebuffer object. */
+     context->cached   = 0;
+     context->restored = 0;
+
+     /* The constant rectangle attributes are set before the first primitive. */
+     context->rects  = false;
+     context->issued = false;
+     context->sync   = EGL_NO_SYNC_KHR;
+
+     /* Objects of the OpenGL ES 3.x path are created on first use. */
+     memset( context->vaos, 0, sizeof(context->vaos) );
+
+     context->layout  = -1;
+     context->ring    = 0;
+     context->sampler = 0;
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_context_init( GLES2DriverData *drv )
+{
+     GLES2Context *context   = &drv->pool[0];
+     EGLint        config_id = 0;
+     EGLint        num_configs;
+     EGLint        attribs[] = { EGL_CONFIG_ID, 0, EGL_NONE };
+     const char   *extensions;
+
+     D_DEBUG_AT( GLES2_Context, "%s()\n", __FUNCTION__ );
+
+     context->context = eglGetCurrentContext();
+     context->owned   = false;
+
+     context_reset( context );
+
+     drv->num_contexts = 1;
+     drv->context      = context;
+
+     /* Shared contexts are created with the config and client version of the first one. */
+     drv->config         = (EGLConfig) 0;
+     drv->client_version = 2;
+
+     eglQueryContext( drv->display, context->context, EGL_CONFIG_ID, &config_id );
+     eglQueryContext( drv->display, context->context, EGL_CONTEXT_CLIENT_VERSION, &drv->client_version );
+
+     if (config_id) {
+          attribs[1] = config_id;
+
+          if (!eglChooseConfig( drv->display, attribs, &drv->config, 1, &num_configs ) || !num_configs)
+               drv->config = (EGLConfig) 0;
+     }
+
+     extensions = eglQueryString( drv->display, EGL_EXTENSIONS );
+
+     drv->surfaceless = extensions && strstr( extensions, "EGL_KHR_surfaceless_context" );
+
+     /* Let the GPU wait for the commands of the previous context, instead of the calling thread. */
+     if (extensions && strstr( extensions, "EGL_KHR_wait_sync" ))
+          drv->WaitSyncKHR = (PFNEGLWAITSYNCKHRPROC) eglGetProcAddress( "eglWaitSyncKHR" );
+}
+
+void
+gles2_context_deinit( GLES2DriverData *drv )
+{
+     EGLContext   current = eglGetCurrentContext();
+     unsigned int i;
+
+     D_DEBUG_AT( GLES2_Context, "%s()\n", __FUNCTION__ );
+
+     for (i = 0; i < drv->num_contexts; i++) {
+          GLES2Context *context = &drv->pool[i];
+
+          if (context->sync != EGL_NO_SYNC_KHR)
+               drv->DestroySyncKHR( drv->display, context->sync );
+
+          /* Framebuffer objects of contexts current in other threads are deleted with the context. */
+          gles2_fbo_deinit( context->fbos, context->context == current );
+
+          gles2_es3_context_deinit( drv, context, context->context == current );
+
+          if (context->owned) {
+               if (context->context == current)
+                    eglMakeCurrent( drv->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+
+               /* Deleted when no longer current in its thread. */
+               eglDestroyContext( drv->display, context->context );
+          }
+     }
+
+     drv->num_contexts = 0;
+     drv->context      = NULL;
+}
+
+DFBResult
+gles2_context_create( GLES2DriverData *drv,
+                      GLES2Context    *context )
+{
+     EGLint attribs[] = { EGL_CONTEXT_CLIENT_VERSION, drv->client_version, EGL_NONE };
+
+     D_DEBUG_AT( GLES2_Context, "%s()\n", __FUNCTION__ );
+
+     context->context = eglCreateContext( drv->display, drv->config, drv->pool[0].context, attribs );
+     if (context->context == EGL_NO_CONTEXT) {
+          D_ERROR( "GLES2/Context: Failed to create shared context (0x%04x)!\n", eglGetError() );
+          return DFB_INIT;
+     }
+
+     context->owned = true;
+
+     context_reset( context );
+
+     return DFB_OK;
+}
+
+GLES2Context *
+gles2_context_get( GLES2DriverData *drv )
+{
+     EGLContext    current = eglGetCurrentContext();
+     GLES2Context *context;
+     unsigned int  i;
+
+     /* The context that executed the last commands may be the one of the submission thread, still executing. */
+     for (i = 0; i < drv->num_contexts; i++) {
+          if (drv->pool[i].context == current)
+               return &drv->pool[i];
+     }
+
+     if (drv->num_contexts == GLES2_CONTEXTS) {
+          D_ONCE( "no more contexts for threads calling the driver" );
+          return NULL;
+     }
+
+     context = &drv->pool[drv->num_contexts];
+
+     if (current != EGL_NO_CONTEXT) {
+          /* Use another context of the system module as it is. */
+          context->context = current;
+          context->owned   = false;
+
+          context_reset( context );
+     }
+     else {
+          if (!drv->surfaceless) {
+               D_ONCE( "EGL_KHR_surfaceless_context required for threads without context" );
+               return NULL;
+          }
+
+          if (gles2_context_create( drv, context ))
+               return NULL;
+
+          eglBindAPI( EGL_OPENGL_ES_API );
+
+          if (!eglMakeCurrent( drv->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->context )) {
+               D_ERROR( "GLES2/Context: Failed to make context current (0x%04x)!\n", eglGetError() );
+               eglDestroyContext( drv->display, context->context );
+               memset( context, 0, sizeof(GLES2Context) );
+               return NULL;
+          }
+     }
+
+     D_DEBUG_AT( GLES2_Context, "%s() -> context %u %s\n", __FUNCTION__, drv->num_contexts,
+                 context->owned ? "created" : "of the system module" );
+
+     drv->num_contexts++;
+
+     return context;
+}
+
+void
+gles2_context_switch( GLES2DriverData *drv,
+                      GLES2Context    *context )
+{
+     GLES2Context *previous = drv->context;
+     int           i;
+
+     if (previous == context)
+          return;
+
+     D_DEBUG_AT( GLES2_Context, "%s( %p ) <- %p\n", __FUNCTION__, context, previous );
+
+     /* The commands of the previous context may render into textures used here. The fence is kept until the previous
+        context inserts the next one, a server wait may still use it. */
+     if (previous->sync != EGL_NO_SYNC_KHR) {
+          if (drv->WaitSyncKHR)
+               drv->WaitSyncKHR( drv->display, previous->sync, 0 );
+          else
+               drv->ClientWaitSyncKHR( drv->display, previous->sync, 0, EGL_FOREVER_KHR );
+     }
+
+     context->prog_index = INVALID_PROGRAM;
+
+     for (i = 0; i < NUM_PROGRAMS; i++)
+          context->flags[i] = NONE;
+
+     /* Bind the vertex array object, the ring buffer and the sampler object again. */
+     context->layout  = -1;
+     context->sampler = 0;
+
+     drv->context = context;
+     drv->reapply = true;
+}
+
+void
+gles2_context_release( GLES2DriverData *drv )
+{
+     GLES2Context *context = drv->context;
+
+     if (!context->issued)
+          return;
+
+     D_DEBUG_AT( GLES2_Context, "%s( %p )\n", __FUNCTION__, context );
+
+     context->issued = false;
+
+     /* Without fences, the commands are completed when switching between contexts. */
+     if (!drv->CreateSyncKHR) {
+          if (drv->num_contexts > 1)
+               glFinish();
+
+          return;
+     }
+
+     if (context->sync != EGL_NO_SYNC_KHR)
+          drv->DestroySyncKHR( drv->display, context->sync );
+
+     context->sync = drv->CreateSyncKHR( drv->display, EGL_SYNC_FENCE_KHR, NULL );
+
+     /* The fence must be flushed to be signaled. */
+     if (context->sync != EGL_NO_SYNC_KHR)
+          glFlush();
+     else
+          glFinish();
+}
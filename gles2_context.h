@@ -0,0 +1,63 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_CONTEXT_H__
+#define __GLES2_CONTEXT_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Each thread calling the driver renders with its own context. The context current at initialization keeps being
+ * used by its thread, a thread without context gets a context sharing its objects, made current without a surface.
+ * Commands are executed in one context after the other, the next context waits for a fence after the commands of the
+ * previous one.
+ */
+
+void          gles2_context_init   ( GLES2DriverData *drv );
+
+void          gles2_context_deinit ( GLES2DriverData *drv );
+
+/*
+ * Create a context sharing the objects of the first context, it's not made current.
+ */
+DFBResult     gles2_context_create ( GLES2DriverData *drv,
+                                     GLES2Context    *context );
+
+/*
+ * Return the context of the calling thread, a context is created and made current if the thread has none.
+ * Returns NULL if there's no context for the thread, its functions are not accelerated then.
+ */
+GLES2Context *gles2_context_get    ( GLES2DriverData *drv );
+
+/*
+ * Make the context the one executing commands, after the commands of the previous one. The validation flags are
+ * cleared when switching, the hardware states and the uniforms of the shared programs may have been changed.
+ */
+void          gles2_context_switch ( GLES2DriverData *drv,
+                                     GLES2Context    *context );
+
+/*
+ * Insert a fence after the commands issued in the context of the calling thread, other contexts wait for it when
+ * switching. A thread calling the driver for the first time waits for the commands of the other contexts up to
+ * their last fence.
+ */
+void          gles2_context_release( GLES2DriverData *drv );
+
+#endif
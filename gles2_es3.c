@@ -0,0 +1,248 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <EGL/egl.h>
+
+#include "gles2_es3.h"
+
+D_DEBUG_DOMAIN( GLES2_ES3, "GLES2/ES3", "OpenGL ES 3.0 Objects" );
+
+/**********************************************************************************************************************/
+
+#define RING_ALIGN(size) (((size) + 15) & ~15)
+
+static const GLenum min_filters[3] = { GL_NEAREST, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR };
+
+/**********************************************************************************************************************/
+
+void
+gles2_es3_init( GLES2DriverData *drv )
+{
+     const char *version = (const char*) glGetString( GL_VERSION );
+     int         i, j;
+
+     D_DEBUG_AT( GLES2_ES3, "%s()\n", __FUNCTION__ );
+
+     if (!version || strncmp( version, "OpenGL ES 3", 11 ))
+          return;
+
+     drv->GenVertexArrays    = (PFNGLGENVERTEXARRAYSPROC)    eglGetProcAddress( "glGenVertexArrays" );
+     drv->DeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC) eglGetProcAddress( "glDeleteVertexArrays" );
+     drv->BindVertexArray    = (PFNGLBINDVERTEXARRAYPROC)    eglGetProcAddress( "glBindVertexArray" );
+     drv->MapBufferRange     = (PFNGLMAPBUFFERRANGEPROC)     eglGetProcAddress( "glMapBufferRange" );
+     drv->UnmapBuffer        = (PFNGLUNMAPBUFFERPROC)        eglGetProcAddress( "glUnmapBuffer" );
+     drv->GenSamplers        = (PFNGLGENSAMPLERSPROC)        eglGetProcAddress( "glGenSamplers" );
+     drv->DeleteSamplers     = (PFNGLDELETESAMPLERSPROC)     eglGetProcAddress( "glDeleteSamplers" );
+     drv->BindSampler        = (PFNGLBINDSAMPLERPROC)        eglGetProcAddress( "glBindSampler" );
+     drv->SamplerParameteri  = (PFNGLSAMPLERPARAMETERIPROC)  eglGetProcAddress( "glSamplerParameteri" );
+
+     if (!drv->GenVertexArrays || !drv->DeleteVertexArrays || !drv->BindVertexArray || !drv->MapBufferRange ||
+         !drv->UnmapBuffer || !drv->GenSamplers || !drv->DeleteSamplers || !drv->BindSampler ||
+         !drv->SamplerParameteri) {
+          D_ERROR( "GLES2/ES3: Failed to get OpenGL ES 3.0 functions, using the OpenGL ES 2.0 path!\n" );
+          return;
+     }
+
+     /* Sampler objects are shared by the contexts, with the wrap mode required for non power of two sources. */
+     drv->GenSamplers( 6, &drv->samplers[0][0] );
+
+     for (i = 0; i < 3; i++) {
+          for (j = 0; j < 2; j++) {
+               GLuint sampler = drv->samplers[i][j];
+
+               drv->SamplerParameteri( sampler, GL_TEXTURE_MIN_FILTER, min_filters[i] );
+               drv->SamplerParameteri( sampler, GL_TEXTURE_MAG_FILTER, j ? GL_LINEAR : GL_NEAREST );
+               drv->SamplerParameteri( sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+               drv->SamplerParameteri( sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+          }
+     }
+
+     /* Invalidate the previous contents of the destination, also without GL_EXT_discard_framebuffer. */
+     drv->DiscardFramebufferEXT = (PFNGLDISCARDFRAMEBUFFEREXTPROC) eglGetProcAddress( "glInvalidateFramebuffer" );
+
+     drv->es3 = true;
+
+     D_INFO( "GLES2/ES3: Using vertex array objects, mapped ring buffers and sampler objects\n" );
+}
+
+void
+gles2_es3_deinit( GLES2DriverData *drv )
+{
+     D_DEBUG_AT( GLES2_ES3, "%s()\n", __FUNCTION__ );
+
+     if (!drv->es3)
+          return;
+
+     drv->DeleteSamplers( 6, &drv->samplers[0][0] );
+
+     drv->es3 = false;
+}
+
+void
+gles2_es3_context_deinit( GLES2DriverData *drv,
+                          GLES2Context    *context,
+                          bool             current )
+{
+     int i;
+
+     D_DEBUG_AT( GLES2_ES3, "%s( %p, %scurrent )\n", __FUNCTION__, context, current ? "" : "not " );
+
+     if (!drv->es3 || !current)
+          return;
+
+     for (i = 0; i < GLES2_LAYOUTS; i++) {
+          if (context->vaos[i])
+               drv->DeleteVertexArrays( 1, &context->vaos[i] );
+
+          context->vaos[i] = 0;
+     }
+
+     if (context->ring)
+          glDeleteBuffers( 1, &context->ring );
+
+     context->ring   = 0;
+     context->layout = -1;
+}
+
+void
+gles2_es3_layout( GLES2DriverData *drv,
+                  bool             texcoords,
+                  bool             edges )
+{
+     GLES2Context *context = drv->context;
+     int           layout  = (texcoords ? 1 : 0) | (edges ? 2 : 0);
+
+     if (context->layout == layout)
+          return;
+
+     D_DEBUG_AT( GLES2_ES3, "%s( %d )\n", __FUNCTION__, layout );
+
+     if (!context->vaos[layout]) {
+          drv->GenVertexArrays( 1, &context->vaos[layout] );
+          drv->BindVertexArray( context->vaos[layout] );
+
+          glEnableVertexAttribArray( GLES2VA_POSITIONS );
+
+          if (texcoords)
+               glEnableVertexAttribArray( GLES2VA_TEXCOORDS );
+
+          if (edges)
+               glEnableVertexAttribArray( GLES2VA_EDGES );
+
+          /* The arrays of the rectangle attributes are enabled by instanced drawing only. */
+          if (drv->VertexAttribDivisor) {
+               drv->VertexAttribDivisor( GLES2VA_RECTS, 1 );
+               drv->VertexAttribDivisor( GLES2VA_TEXPOS, 1 );
+          }
+     }
+     else
+          drv->BindVertexArray( context->vaos[layout] );
+
+     /* The ring buffer is created with the first vertex array object, its binding is not part of the objects. */
+     if (!context->ring) {
+          glGenBuffers( 1, &context->ring );
+          glBindBuffer( GL_ARRAY_BUFFER, context->ring );
+          glBufferData( GL_ARRAY_BUFFER, GLES2_RING_SIZE, NULL, GL_STREAM_DRAW );
+
+          context->ring_size   = GLES2_RING_SIZE;
+          context->ring_offset = 0;
+     }
+     else if (context->layout < 0)
+          glBindBuffer( GL_ARRAY_BUFFER, context->ring );
+
+     context->layout = layout;
+}
+
+void
+gles2_es3_arrays( GLES2DriverData        *drv,
+                  const GLES2VertexArray *arrays,
+                  unsigned int            num )
+{
+     GLES2Context *context = drv->context;
+     GLbitfield    access  = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+     GLsizeiptr    size    = 0;
+     GLintptr      offset;
+     u8           *map;
+     unsigned int  i;
+
+     D_ASSERT( context->layout >= 0 );
+
+     for (i = 0; i < num; i++)
+          size += RING_ALIGN( arrays[i].length );
+
+     /* Start over with a new store when the ring is full, the GPU may still read the previous one. Otherwise the
+        written range is not used by commands issued before, no synchronization is needed. */
+     if (context->ring_offset + size > context->ring_size) {
+          if (size > context->ring_size) {
+               context->ring_size = (size + GLES2_RING_SIZE - 1) / GLES2_RING_SIZE * GLES2_RING_SIZE;
+
+               glBufferData( GL_ARRAY_BUFFER, context->ring_size, NULL, GL_STREAM_DRAW );
+          }
+
+          access               = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+          context->ring_offset = 0;
+     }
+
+     map = drv->MapBufferRange( GL_ARRAY_BUFFER, context->ring_offset, size, access );
+
+     for (i = 0, offset = context->ring_offset; i < num; i++) {
+          if (map)
+               memcpy( map + (offset - context->ring_offset), arrays[i].data, arrays[i].length );
+          else
+               glBufferSubData( GL_ARRAY_BUFFER, offset, arrays[i].length, arrays[i].data );
+
+          offset += RING_ALIGN( arrays[i].length );
+     }
+
+     if (map)
+          drv->UnmapBuffer( GL_ARRAY_BUFFER );
+     else
+          D_ONCE( "mapping the ring buffer failed" );
+
+     for (i = 0, offset = context->ring_offset; i < num; i++) {
+          glVertexAttribPointer( arrays[i].index, arrays[i].size, GL_FLOAT, GL_FALSE, arrays[i].stride,
+                                 (const void*) offset );
+
+          offset += RING_ALIGN( arrays[i].length );
+     }
+
+     context->ring_offset += size;
+}
+
+void
+gles2_es3_sampler( GLES2DriverData *drv,
+                   GLenum           min_filter,
+                   GLenum           mag_filter )
+{
+     GLES2Context *context = drv->context;
+     GLuint        sampler;
+     int           i;
+
+     for (i = 0; i < 2; i++) {
+          if (min_filters[i] == min_filter)
+               break;
+     }
+
+     sampler = drv->samplers[i][mag_filter == GL_LINEAR];
+
+     if (context->sampler != sampler) {
+          drv->BindSampler( 0, sampler );
+
+          context->sampler = sampler;
+     }
+}
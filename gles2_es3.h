@@ -0,0 +1,67 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_ES3_H__
+#define __GLES2_ES3_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * On OpenGL ES 3.x contexts, the enabled vertex arrays are recorded in a vertex array object per layout, the vertices
+ * are written to a ring buffer through unsynchronized mappings and sources are filtered by sampler objects. Vertex
+ * array objects are not shared, each context has its own objects, created on first use.
+ */
+
+/*
+ * Detect an OpenGL ES 3.x context and create the sampler objects, the OpenGL ES 2.0 path is used otherwise.
+ */
+void gles2_es3_init           ( GLES2DriverData        *drv );
+
+void gles2_es3_deinit         ( GLES2DriverData        *drv );
+
+/*
+ * Delete the objects of a context, only if it's current. Otherwise they are deleted with the context.
+ */
+void gles2_es3_context_deinit ( GLES2DriverData        *drv,
+                                GLES2Context           *context,
+                                bool                    current );
+
+/*
+ * Bind the vertex array object enabling the positions, the texture coordinates and the edge distances if used.
+ */
+void gles2_es3_layout         ( GLES2DriverData        *drv,
+                                bool                    texcoords,
+                                bool                    edges );
+
+/*
+ * Copy the client arrays to the ring buffer of the context and point their vertex attributes to the copies.
+ */
+void gles2_es3_arrays         ( GLES2DriverData        *drv,
+                                const GLES2VertexArray *arrays,
+                                unsigned int            num );
+
+/*
+ * Bind the sampler object with the filters, GL_NEAREST, GL_LINEAR or GL_LINEAR_MIPMAP_LINEAR for minification.
+ */
+void gles2_es3_sampler        ( GLES2DriverData        *drv,
+                                GLenum                  min_filter,
+                                GLenum                  mag_filter );
+
+#endif
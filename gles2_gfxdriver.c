@@ -17,10 +17,19 @@
 */
 
 #include <core/graphics_driver.h>
+#include <direct/conf.h>
+#include <EGL/egl.h>
 #include <misc/conf.h>
 
-#include "gles2_gfxdriver.h"
+#include "gles2_2d.h"
+#include "gles2_async.h"
+#include "gles2_atlas.h"
+#include "gles2_context.h"
+#include "gles2_es3.h"
 #include "gles2_shaders.h"
+#include "gles2_stats.h"
+#include "gles2_sync.h"
+#include "gles2_trace.h"
 
 D_DEBUG_DOMAIN( GLES2_Driver, "GLES2/Driver", "OpenGL ES 2.0 Driver" );
 
@@ -110,6 +119,15 @@ init_program( const char *vert_prog_src,
      if (texcoords)
           glBindAttribLocation( prog_obj, GLES2VA_TEXCOORDS, "dfbUV" );
 
+     /* Bind the rectangles and source positions of instanced primitives to "dfbRect" and "dfbTexPos". */
+     glBindAttribLocation( prog_obj, GLES2VA_RECTS, "dfbRect" );
+
+     if (texcoords)
+          glBindAttribLocation( prog_obj, GLES2VA_TEXPOS, "dfbTexPos" );
+
+     /* Bind edge distances to "dfbEdge", only used by the anti-aliasing programs. */
+     glBindAttribLocation( prog_obj, GLES2VA_EDGES, "dfbEdge" );
+
      /* Link the program object. */
      glLinkProgram( prog_obj );
 
@@ -135,6 +153,220 @@ init_program( const char *vert_prog_src,
      return prog_obj;
 }
 
+/*
+ * The fetch programs read the destination, they are optional and only used for destination premultiplication and
+ * demultiplication the blend functions can't do.
+ */
+static void
+init_fetch_programs( GraphicsDeviceInfo *device_info,
+                     GLES2DeviceData    *dev )
+{
+     GLuint prog_obj;
+
+     prog_obj = init_program( draw_vert_src, draw_fetch_frag_src, DFB_FALSE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[DRAW_FETCH].obj          = prog_obj;
+     dev->progs[DRAW_FETCH].name         = "draw_fetch";
+     dev->progs[DRAW_FETCH].dfbColor     = glGetUniformLocation( dev->progs[DRAW_FETCH].obj, "dfbColor" );
+     dev->progs[DRAW_FETCH].dfbScale     = glGetUniformLocation( dev->progs[DRAW_FETCH].obj, "dfbScale" );
+     dev->progs[DRAW_FETCH].dfbRotMatrix = glGetUniformLocation( dev->progs[DRAW_FETCH].obj, "dfbRotMatrix" );
+     dev->progs[DRAW_FETCH].dfbBlend     = glGetUniformLocation( dev->progs[DRAW_FETCH].obj, "dfbBlend" );
+     dev->progs[DRAW_FETCH].dfbMultiply  = glGetUniformLocation( dev->progs[DRAW_FETCH].obj, "dfbMultiply" );
+
+     prog_obj = init_program( draw_mat_vert_src, draw_fetch_frag_src, DFB_FALSE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[DRAW_FETCH_MAT].obj          = prog_obj;
+     dev->progs[DRAW_FETCH_MAT].name         = "draw_fetch_mat";
+     dev->progs[DRAW_FETCH_MAT].dfbColor     = glGetUniformLocation( dev->progs[DRAW_FETCH_MAT].obj, "dfbColor" );
+     dev->progs[DRAW_FETCH_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[DRAW_FETCH_MAT].obj, "dfbROMatrix" );
+     dev->progs[DRAW_FETCH_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[DRAW_FETCH_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[DRAW_FETCH_MAT].dfbBlend     = glGetUniformLocation( dev->progs[DRAW_FETCH_MAT].obj, "dfbBlend" );
+     dev->progs[DRAW_FETCH_MAT].dfbMultiply  = glGetUniformLocation( dev->progs[DRAW_FETCH_MAT].obj, "dfbMultiply" );
+
+     prog_obj = init_program( blit_vert_src, blit_fetch_frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_FETCH].obj          = prog_obj;
+     dev->progs[BLIT_FETCH].name         = "blit_fetch";
+     dev->progs[BLIT_FETCH].dfbColor     = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbColor" );
+     dev->progs[BLIT_FETCH].dfbScale     = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbScale" );
+     dev->progs[BLIT_FETCH].dfbRotMatrix = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbRotMatrix" );
+     dev->progs[BLIT_FETCH].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbTexScale" );
+     dev->progs[BLIT_FETCH].dfbBlend     = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbBlend" );
+     dev->progs[BLIT_FETCH].dfbMultiply  = glGetUniformLocation( dev->progs[BLIT_FETCH].obj, "dfbMultiply" );
+
+     prog_obj = init_program( blit_mat_vert_src, blit_fetch_frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_FETCH_MAT].obj          = prog_obj;
+     dev->progs[BLIT_FETCH_MAT].name         = "blit_fetch_mat";
+     dev->progs[BLIT_FETCH_MAT].dfbColor     = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbColor" );
+     dev->progs[BLIT_FETCH_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbROMatrix" );
+     dev->progs[BLIT_FETCH_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[BLIT_FETCH_MAT].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbTexScale" );
+     dev->progs[BLIT_FETCH_MAT].dfbBlend     = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbBlend" );
+     dev->progs[BLIT_FETCH_MAT].dfbMultiply  = glGetUniformLocation( dev->progs[BLIT_FETCH_MAT].obj, "dfbMultiply" );
+
+     dev->fetch = true;
+
+     device_info->caps.blitting |= DSBLIT_DEMULTIPLY;
+     device_info->caps.drawing  |= DSDRAW_DEMULTIPLY;
+
+     dev->caps = device_info->caps;
+
+     D_INFO( "GLES2/Driver: Using framebuffer fetch for destination premultiplication and demultiplication\n" );
+
+     return;
+
+fail:
+     D_ERROR( "GLES2/Driver: Failed to create fetch programs!\n" );
+
+     glDeleteProgram( dev->progs[DRAW_FETCH].obj );
+     glDeleteProgram( dev->progs[DRAW_FETCH_MAT].obj );
+     glDeleteProgram( dev->progs[BLIT_FETCH].obj );
+
+     dev->progs[DRAW_FETCH].obj     = 0;
+     dev->progs[DRAW_FETCH_MAT].obj = 0;
+     dev->progs[BLIT_FETCH].obj     = 0;
+}
+
+/*
+ * The anti-aliasing programs compute the coverage of the fragments from the distances to the edges, they are optional
+ * and only used with DSRO_ANTIALIAS.
+ */
+static void
+init_aa_programs( GLES2DeviceData *dev )
+{
+     GLuint prog_obj;
+
+     prog_obj = init_program( draw_aa_vert_src, draw_aa_frag_src, DFB_FALSE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[DRAW_AA].obj          = prog_obj;
+     dev->progs[DRAW_AA].name         = "draw_aa";
+     dev->progs[DRAW_AA].dfbColor     = glGetUniformLocation( dev->progs[DRAW_AA].obj, "dfbColor" );
+     dev->progs[DRAW_AA].dfbScale     = glGetUniformLocation( dev->progs[DRAW_AA].obj, "dfbScale" );
+     dev->progs[DRAW_AA].dfbRotMatrix = glGetUniformLocation( dev->progs[DRAW_AA].obj, "dfbRotMatrix" );
+     dev->progs[DRAW_AA].dfbCoverage  = glGetUniformLocation( dev->progs[DRAW_AA].obj, "dfbCoverage" );
+
+     prog_obj = init_program( draw_aa_mat_vert_src, draw_aa_frag_src, DFB_FALSE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[DRAW_AA_MAT].obj          = prog_obj;
+     dev->progs[DRAW_AA_MAT].name         = "draw_aa_mat";
+     dev->progs[DRAW_AA_MAT].dfbColor     = glGetUniformLocation( dev->progs[DRAW_AA_MAT].obj, "dfbColor" );
+     dev->progs[DRAW_AA_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[DRAW_AA_MAT].obj, "dfbROMatrix" );
+     dev->progs[DRAW_AA_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[DRAW_AA_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[DRAW_AA_MAT].dfbCoverage  = glGetUniformLocation( dev->progs[DRAW_AA_MAT].obj, "dfbCoverage" );
+
+     prog_obj = init_program( blit_aa_vert_src, blit_aa_frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_AA].obj          = prog_obj;
+     dev->progs[BLIT_AA].name         = "blit_aa";
+     dev->progs[BLIT_AA].dfbColor     = glGetUniformLocation( dev->progs[BLIT_AA].obj, "dfbColor" );
+     dev->progs[BLIT_AA].dfbScale     = glGetUniformLocation( dev->progs[BLIT_AA].obj, "dfbScale" );
+     dev->progs[BLIT_AA].dfbRotMatrix = glGetUniformLocation( dev->progs[BLIT_AA].obj, "dfbRotMatrix" );
+     dev->progs[BLIT_AA].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_AA].obj, "dfbTexScale" );
+     dev->progs[BLIT_AA].dfbCoverage  = glGetUniformLocation( dev->progs[BLIT_AA].obj, "dfbCoverage" );
+
+     prog_obj = init_program( blit_aa_mat_vert_src, blit_aa_frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_AA_MAT].obj          = prog_obj;
+     dev->progs[BLIT_AA_MAT].name         = "blit_aa_mat";
+     dev->progs[BLIT_AA_MAT].dfbColor     = glGetUniformLocation( dev->progs[BLIT_AA_MAT].obj, "dfbColor" );
+     dev->progs[BLIT_AA_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[BLIT_AA_MAT].obj, "dfbROMatrix" );
+     dev->progs[BLIT_AA_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[BLIT_AA_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[BLIT_AA_MAT].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_AA_MAT].obj, "dfbTexScale" );
+     dev->progs[BLIT_AA_MAT].dfbCoverage  = glGetUniformLocation( dev->progs[BLIT_AA_MAT].obj, "dfbCoverage" );
+
+     dev->antialias = true;
+
+     D_INFO( "GLES2/Driver: Using edge coverage for anti-aliasing\n" );
+
+     return;
+
+fail:
+     D_ERROR( "GLES2/Driver: Failed to create anti-aliasing programs!\n" );
+
+     glDeleteProgram( dev->progs[DRAW_AA].obj );
+     glDeleteProgram( dev->progs[DRAW_AA_MAT].obj );
+     glDeleteProgram( dev->progs[BLIT_AA].obj );
+
+     dev->progs[DRAW_AA].obj     = 0;
+     dev->progs[DRAW_AA_MAT].obj = 0;
+     dev->progs[BLIT_AA].obj     = 0;
+}
+
+/*
+ * The scaler programs replace bilinear filtering of StretchBlit() with DSRO_SMOOTH_UPSCALE by a bicubic or lanczos
+ * kernel, they are optional and only used if selected by the "gles2-scaler" option.
+ */
+static void
+init_scale_programs( GLES2DeviceData *dev,
+                     const char      *scaler )
+{
+     GLuint      prog_obj;
+     const char *frag_src;
+
+     if (!strcmp( scaler, "bicubic" )) {
+          frag_src = blit_bicubic_frag_src;
+     }
+     else if (!strcmp( scaler, "lanczos" )) {
+          frag_src = blit_lanczos_frag_src;
+     }
+     else {
+          D_ERROR( "GLES2/Driver: Unknown scaler '%s' (bicubic or lanczos)!\n", scaler );
+          return;
+     }
+
+     prog_obj = init_program( blit_texel_vert_src, frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_SCALE].obj          = prog_obj;
+     dev->progs[BLIT_SCALE].name         = "blit_scale";
+     dev->progs[BLIT_SCALE].dfbColor     = glGetUniformLocation( dev->progs[BLIT_SCALE].obj, "dfbColor" );
+     dev->progs[BLIT_SCALE].dfbScale     = glGetUniformLocation( dev->progs[BLIT_SCALE].obj, "dfbScale" );
+     dev->progs[BLIT_SCALE].dfbRotMatrix = glGetUniformLocation( dev->progs[BLIT_SCALE].obj, "dfbRotMatrix" );
+     dev->progs[BLIT_SCALE].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_SCALE].obj, "dfbTexScale" );
+
+     prog_obj = init_program( blit_texel_mat_vert_src, frag_src, DFB_TRUE );
+     if (!prog_obj)
+          goto fail;
+
+     dev->progs[BLIT_SCALE_MAT].obj          = prog_obj;
+     dev->progs[BLIT_SCALE_MAT].name         = "blit_scale_mat";
+     dev->progs[BLIT_SCALE_MAT].dfbColor     = glGetUniformLocation( dev->progs[BLIT_SCALE_MAT].obj, "dfbColor" );
+     dev->progs[BLIT_SCALE_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[BLIT_SCALE_MAT].obj, "dfbROMatrix" );
+     dev->progs[BLIT_SCALE_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[BLIT_SCALE_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[BLIT_SCALE_MAT].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_SCALE_MAT].obj, "dfbTexScale" );
+
+     dev->scale = true;
+
+     D_INFO( "GLES2/Driver: Using %s scaler for smooth StretchBlit() upscaling\n", scaler );
+
+     return;
+
+fail:
+     D_ERROR( "GLES2/Driver: Failed to create scaler programs!\n" );
+
+     glDeleteProgram( dev->progs[BLIT_SCALE].obj );
+
+     dev->progs[BLIT_SCALE].obj = 0;
+}
+
 /**********************************************************************************************************************/
 
 static int
@@ -162,12 +394,19 @@ driver_init_driver( GraphicsDeviceFuncs *funcs,
                     void                *device_data,
                     CoreDFB             *core )
 {
+     GLES2DriverData *drv = driver_data;
+
      D_DEBUG_AT( GLES2_Driver, "%s()\n", __FUNCTION__ );
 
      dfb_config->font_format = DSPF_ARGB;
 
+     drv->core = core;
+
      *funcs = gles2GraphicsDeviceFuncs;
 
+     /* Optionally record the calls to a trace file. */
+     gles2_trace_init( driver_data, funcs );
+
      return DFB_OK;
 }
 
@@ -176,7 +415,11 @@ driver_init_device( GraphicsDeviceInfo *device_info,
                     void               *driver_data,
                     void               *device_data )
 {
+     GLES2DriverData *drv = driver_data;
      GLES2DeviceData *dev = device_data;
+     const char      *extensions;
+     const char      *scaler;
+     const char      *version;
      GLuint           prog_obj;
      int              i;
 
@@ -186,25 +429,42 @@ driver_init_device( GraphicsDeviceInfo *device_info,
      snprintf( device_info->name,   DFB_GRAPHICS_DEVICE_INFO_NAME_LENGTH,   "%s", glGetString( GL_RENDERER ) );
      snprintf( device_info->vendor, DFB_GRAPHICS_DEVICE_INFO_VENDOR_LENGTH, "OpenGL ES" );
      device_info->caps.flags    = CCF_CLIPPING | CCF_RENDEROPTS;
-     device_info->caps.accel    = DFXL_FILLRECTANGLE | DFXL_DRAWRECTANGLE | DFXL_DRAWLINE | DFXL_FILLTRIANGLE |
-                                  DFXL_BLIT          | DFXL_STRETCHBLIT;
+     device_info->caps.accel    = DFXL_FILLRECTANGLE  | DFXL_DRAWRECTANGLE | DFXL_DRAWLINE | DFXL_FILLTRIANGLE |
+                                  DFXL_FILLQUADRANGLE | DFXL_BLIT          | DFXL_STRETCHBLIT;
      device_info->caps.blitting = DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA | DSBLIT_COLORIZE         |
                                   DSBLIT_SRC_COLORKEY       | DSBLIT_SRC_PREMULTIPLY  | DSBLIT_SRC_PREMULTCOLOR |
-                                  DSBLIT_ROTATE180          | DSBLIT_ROTATE90         | DSBLIT_ROTATE270;
-     device_info->caps.drawing  = DSDRAW_BLEND | DSDRAW_SRC_PREMULTIPLY;
+                                  DSBLIT_ROTATE180          | DSBLIT_ROTATE90         | DSBLIT_ROTATE270        |
+                                  DSBLIT_DST_PREMULTIPLY    | DSBLIT_SRC_COLORMATRIX  | DSBLIT_SRC_CONVOLUTION;
+     device_info->caps.drawing  = DSDRAW_BLEND | DSDRAW_SRC_PREMULTIPLY | DSDRAW_DST_PREMULTIPLY;
+
+     /* Cache the capabilities and size limits for CheckState(), and precompute the program selection for SetState(). */
+     dev->caps = device_info->caps;
+
+     glGetIntegerv( GL_MAX_TEXTURE_SIZE, &dev->max_texture_size );
+     glGetIntegerv( GL_MAX_VIEWPORT_DIMS, dev->max_viewport );
+
+     D_DEBUG_AT( GLES2_Driver, "  -> max texture size %d, max viewport %dx%d\n",
+                 dev->max_texture_size, dev->max_viewport[0], dev->max_viewport[1] );
+
+     gles2_init_dispatch( dev );
 
      /* Initialize program information. */
      for (i = 0; i < NUM_PROGRAMS; i++) {
-          dev->progs[i].obj          =  0;
-          dev->progs[i].dfbScale     = -1;
-          dev->progs[i].dfbRotMatrix = -1;
-          dev->progs[i].dfbROMatrix  = -1;
-          dev->progs[i].dfbMVPMatrix = -1;
-          dev->progs[i].dfbColor     = -1;
-          dev->progs[i].dfbColorkey  = -1;
-          dev->progs[i].dfbTexScale  = -1;
-          dev->progs[i].flags        =  NONE;
-          dev->progs[i].name         = "invalid";
+          dev->progs[i].obj            =  0;
+          dev->progs[i].dfbScale       = -1;
+          dev->progs[i].dfbRotMatrix   = -1;
+          dev->progs[i].dfbROMatrix    = -1;
+          dev->progs[i].dfbMVPMatrix   = -1;
+          dev->progs[i].dfbColor       = -1;
+          dev->progs[i].dfbColorkey    = -1;
+          dev->progs[i].dfbTexScale    = -1;
+          dev->progs[i].dfbBlend       = -1;
+          dev->progs[i].dfbMultiply    = -1;
+          dev->progs[i].dfbCoverage    = -1;
+          dev->progs[i].dfbColorMatrix = -1;
+          dev->progs[i].dfbKernel      = -1;
+          dev->progs[i].dfbBias        = -1;
+          dev->progs[i].name           = "invalid";
      }
 
      /*
@@ -362,8 +622,164 @@ driver_init_device( GraphicsDeviceInfo *device_info,
      dev->progs[BLIT_PREMULTIPLY_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[BLIT_PREMULTIPLY_MAT].obj, "dfbMVPMatrix" );
      dev->progs[BLIT_PREMULTIPLY_MAT].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_PREMULTIPLY_MAT].obj, "dfbTexScale" );
 
-     /* No program is used yet. */
-     dev->prog_index = INVALID_PROGRAM;
+     /*
+      * The blit_colormatrix program transforms the source frag color by the source color matrix before the modulation
+      * of the blit_color program, optionally followed by the pre-multiplication of the blit_premultiply program.
+      */
+
+     prog_obj = init_program( blit_vert_src, blit_colormatrix_frag_src, DFB_TRUE );
+     if (!prog_obj) {
+          D_ERROR( "GLES2/Driver: Failed to create blit_colormatrix program!\n" );
+          goto fail;
+     }
+
+     dev->progs[BLIT_COLORMATRIX].obj            = prog_obj;
+     dev->progs[BLIT_COLORMATRIX].name           = "blit_colormatrix";
+     dev->progs[BLIT_COLORMATRIX].dfbColor       = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbColor" );
+     dev->progs[BLIT_COLORMATRIX].dfbScale       = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbScale" );
+     dev->progs[BLIT_COLORMATRIX].dfbRotMatrix   = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbRotMatrix" );
+     dev->progs[BLIT_COLORMATRIX].dfbTexScale    = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbTexScale" );
+     dev->progs[BLIT_COLORMATRIX].dfbMultiply    = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbMultiply" );
+     dev->progs[BLIT_COLORMATRIX].dfbColorMatrix = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX].obj, "dfbColorMatrix" );
+
+     prog_obj = init_program( blit_mat_vert_src, blit_colormatrix_frag_src, DFB_TRUE );
+     if (!prog_obj) {
+          D_ERROR( "GLES2/Driver: Failed to create blit_colormatrix_mat program!\n" );
+          goto fail;
+     }
+
+     dev->progs[BLIT_COLORMATRIX_MAT].obj            = prog_obj;
+     dev->progs[BLIT_COLORMATRIX_MAT].name           = "blit_colormatrix_mat";
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbColor       = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbColor" );
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbROMatrix    = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbROMatrix" );
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbMVPMatrix   = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbTexScale    = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbTexScale" );
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbMultiply    = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbMultiply" );
+     dev->progs[BLIT_COLORMATRIX_MAT].dfbColorMatrix = glGetUniformLocation( dev->progs[BLIT_COLORMATRIX_MAT].obj, "dfbColorMatrix" );
+
+     /*
+      * The blit_convolution program filters the 3x3 neighborhood of each source texel, then modulates and optionally
+      * pre-multiplies like the blit_colormatrix program. Texture coords and texel size are passed in texels.
+      */
+
+     prog_obj = init_program( blit_texel_vert_src, blit_convolution_frag_src, DFB_TRUE );
+     if (!prog_obj) {
+          D_ERROR( "GLES2/Driver: Failed to create blit_convolution program!\n" );
+          goto fail;
+     }
+
+     dev->progs[BLIT_CONVOLUTION].obj          = prog_obj;
+     dev->progs[BLIT_CONVOLUTION].name         = "blit_convolution";
+     dev->progs[BLIT_CONVOLUTION].dfbColor     = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbColor" );
+     dev->progs[BLIT_CONVOLUTION].dfbScale     = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbScale" );
+     dev->progs[BLIT_CONVOLUTION].dfbRotMatrix = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbRotMatrix" );
+     dev->progs[BLIT_CONVOLUTION].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbTexScale" );
+     dev->progs[BLIT_CONVOLUTION].dfbMultiply  = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbMultiply" );
+     dev->progs[BLIT_CONVOLUTION].dfbKernel    = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbKernel" );
+     dev->progs[BLIT_CONVOLUTION].dfbBias      = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION].obj, "dfbBias" );
+
+     prog_obj = init_program( blit_texel_mat_vert_src, blit_convolution_frag_src, DFB_TRUE );
+     if (!prog_obj) {
+          D_ERROR( "GLES2/Driver: Failed to create blit_convolution_mat program!\n" );
+          goto fail;
+     }
+
+     dev->progs[BLIT_CONVOLUTION_MAT].obj          = prog_obj;
+     dev->progs[BLIT_CONVOLUTION_MAT].name         = "blit_convolution_mat";
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbColor     = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbColor" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbROMatrix  = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbROMatrix" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbMVPMatrix = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbMVPMatrix" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbTexScale  = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbTexScale" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbMultiply  = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbMultiply" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbKernel    = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbKernel" );
+     dev->progs[BLIT_CONVOLUTION_MAT].dfbBias      = glGetUniformLocation( dev->progs[BLIT_CONVOLUTION_MAT].obj, "dfbBias" );
+
+     extensions = (const char*) glGetString( GL_EXTENSIONS );
+
+     /* Optionally generate mipmaps of StretchBlit() sources for high reduction ratios. */
+     if (direct_config_has_name( "gles2-mipmap" )) {
+          version = (const char*) glGetString( GL_VERSION );
+
+          drv->mipmap      = true;
+          drv->mipmap_npot = (extensions && strstr( extensions, "GL_OES_texture_npot" )) ||
+                             (version && !strncmp( version, "OpenGL ES 3", 11 ));
+
+          D_INFO( "GLES2/Driver: Using mipmaps for StretchBlit() minification%s\n",
+                  drv->mipmap_npot ? "" : " (power of two sources only)" );
+     }
+
+     /* Optionally copy small blit sources into shared atlas textures. */
+     if (direct_config_has_name( "gles2-atlas" ))
+          gles2_atlas_init( drv, dev );
+
+     /* Blend in the shader where blend functions can't premultiply or demultiply the destination. */
+     if (extensions && strstr( extensions, "GL_EXT_shader_framebuffer_fetch" ))
+          init_fetch_programs( device_info, dev );
+
+     /* Anti-alias with the coverage computed from screen space derivatives. */
+     if (extensions && strstr( extensions, "GL_OES_standard_derivatives" ))
+          init_aa_programs( dev );
+
+     /* Optionally scale StretchBlit() sources by a bicubic or lanczos kernel. */
+     scaler = direct_config_get_value( "gles2-scaler" );
+     if (scaler)
+          init_scale_programs( dev, scaler );
+
+     /* Tell tile based GPUs when the previous contents of the destination are not needed. */
+     if (extensions && strstr( extensions, "GL_EXT_discard_framebuffer" ))
+          drv->DiscardFramebufferEXT = (PFNGLDISCARDFRAMEBUFFEREXTPROC) eglGetProcAddress( "glDiscardFramebufferEXT" );
+
+     /* Draw rectangles as instances of a unit square, with one attribute record per rectangle. */
+     version = (const char*) glGetString( GL_VERSION );
+
+     if (version && !strncmp( version, "OpenGL ES 3", 11 )) {
+          drv->DrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC) eglGetProcAddress( "glDrawArraysInstanced" );
+          drv->VertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC) eglGetProcAddress( "glVertexAttribDivisor" );
+     }
+     else if (extensions && strstr( extensions, "GL_EXT_instanced_arrays" )) {
+          drv->DrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC) eglGetProcAddress( "glDrawArraysInstancedEXT" );
+          drv->VertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC) eglGetProcAddress( "glVertexAttribDivisorEXT" );
+     }
+     else if (extensions && strstr( extensions, "GL_ANGLE_instanced_arrays" )) {
+          drv->DrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC) eglGetProcAddress( "glDrawArraysInstancedANGLE" );
+          drv->VertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC) eglGetProcAddress( "glVertexAttribDivisorANGLE" );
+     }
+
+     if (!drv->DrawArraysInstanced || !drv->VertexAttribDivisor) {
+          drv->DrawArraysInstanced = NULL;
+          drv->VertexAttribDivisor = NULL;
+     }
+     else
+          D_INFO( "GLES2/Driver: Using instanced drawing of rectangles\n" );
+
+     /* Use vertex array objects, mapped ring buffers and sampler objects on OpenGL ES 3.x contexts. */
+     if (!direct_config_has_name( "gles2-no-es3" ))
+          gles2_es3_init( drv );
+
+     /* Number batches and insert fences for waiting on them. */
+     gles2_sync_init( drv );
+
+     /* Track the contexts of the threads calling the driver. */
+     gles2_context_init( drv );
+
+     /* Render into destination textures via cached framebuffer objects. */
+     drv->fbo_cache = !direct_config_has_name( "gles2-no-fbo-cache" );
+
+     /* Listen to the destination surfaces for releasing their framebuffer objects. */
+     gles2_watch_init( drv );
+
+     /* Commands are queued in the batch of the driver data. */
+     drv->pending = &drv->batch;
+
+     /* Group queued primitives by state where they don't overlap. */
+     drv->reorder = !direct_config_has_name( "gles2-no-reorder" );
+
+     /* Initialize statistics, including optional GPU timing. */
+     gles2_stats_init( driver_data, dev );
+
+     /* Optionally execute batches rendering offscreen in a submission thread, otherwise they are executed here. */
+     if (direct_config_has_name( "gles2-async" ))
+          gles2_async_init( drv, dev );
 
      return DFB_OK;
 
@@ -380,11 +796,29 @@ static void
 driver_close_device( void *driver_data,
                      void *device_data )
 {
+     GLES2DriverData *drv = driver_data;
+
      D_DEBUG_AT( GLES2_Driver, "%s()\n", __FUNCTION__ );
+
+     gles2_async_deinit( drv );
+
+     gles2_context_deinit( drv );
+
+     gles2_watch_deinit( drv );
+
+     gles2_atlas_deinit( drv );
+
+     gles2_es3_deinit( drv );
+
+     gles2_sync_deinit( drv );
+
+     gles2_stats_deinit( drv, device_data );
 }
 
 static void
 driver_close_driver( void *driver_data )
 {
      D_DEBUG_AT( GLES2_Driver, "%s()\n", __FUNCTION__ );
+
+     gles2_trace_deinit( driver_data );
 }
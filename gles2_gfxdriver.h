@@ -19,15 +19,33 @@
 #ifndef __GLES2_GFXDRIVER_H__
 #define __GLES2_GFXDRIVER_H__
 
+#include <direct/mutex.h>
+#include <direct/thread.h>
+#include <direct/waitqueue.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
 
 /**********************************************************************************************************************/
 
 typedef enum {
      GLES2VA_POSITIONS = 0,
-     GLES2VA_TEXCOORDS = 1
+     GLES2VA_TEXCOORDS = 1,
+     GLES2VA_EDGES     = 2,
+     GLES2VA_RECTS     = 3,
+     GLES2VA_TEXPOS    = 4
 } GLES2VertexAttribs;
 
+typedef struct {
+     GLES2VertexAttribs  index;  /* vertex attribute */
+     GLint               size;   /* number of components */
+     GLsizei             stride; /* distance between records in bytes, 0 if tightly packed */
+     const GLfloat      *data;   /* client array */
+     GLsizeiptr          length; /* size of the client array in bytes */
+} GLES2VertexArray;
+
 typedef enum {
      NONE        = 0x00000000,
 
@@ -40,23 +58,32 @@ typedef enum {
 
      SOURCE      = 0x00000100,
      COLOR_BLIT  = 0x00000200,
+     COLORMATRIX = 0x00000400,
+     CONVOLUTION = 0x00000800,
 
      BLENDING    = 0x00010000,
+     FETCH       = 0x00020000,
+     ANTIALIAS   = 0x00040000,
 
-     ALL         = 0x00010337
+     ALL         = 0x00070F37
 } GLES2ValidationFlags;
 
 typedef struct {
-     GLuint                obj;          /* the program object */
-     GLint                 dfbScale;     /* location of scale factors for clipped coordinates */
-     GLint                 dfbRotMatrix; /* location of layer rotation matrix */
-     GLint                 dfbROMatrix;  /* location of render options matrix */
-     GLint                 dfbMVPMatrix; /* location of model-view-projection matrix */
-     GLint                 dfbColor;     /* location of global RGBA color */
-     GLint                 dfbColorkey;  /* location of colorkey RGB color */
-     GLint                 dfbTexScale;  /* location of scale factors for normalized tex coordinates */
-     char                 *name;         /* program object name for debugging */
-     GLES2ValidationFlags  flags;        /* validation flags */
+     GLuint                obj;            /* the program object */
+     GLint                 dfbScale;       /* location of scale factors for clipped coordinates */
+     GLint                 dfbRotMatrix;   /* location of layer rotation matrix */
+     GLint                 dfbROMatrix;    /* location of render options matrix */
+     GLint                 dfbMVPMatrix;   /* location of model-view-projection matrix */
+     GLint                 dfbColor;       /* location of global RGBA color */
+     GLint                 dfbColorkey;    /* location of colorkey RGB color */
+     GLint                 dfbTexScale;    /* location of scale factors for normalized tex coordinates */
+     GLint                 dfbBlend;       /* location of src and dst blend functions for blending in the shader */
+     GLint                 dfbMultiply;    /* location of src premultiply, dst premultiply and demultiply factors */
+     GLint                 dfbCoverage;    /* location of the factors applying the edge coverage */
+     GLint                 dfbColorMatrix; /* location of the source color matrix */
+     GLint                 dfbKernel;      /* location of the scaled convolution kernel */
+     GLint                 dfbBias;        /* location of the convolution bias */
+     char                 *name;           /* program object name for debugging */
 } GLES2ProgramInfo;
 
 typedef enum {
@@ -70,19 +97,460 @@ typedef enum {
      BLIT_COLORKEY_MAT,
      BLIT_PREMULTIPLY,
      BLIT_PREMULTIPLY_MAT,
+     BLIT_COLORMATRIX,
+     BLIT_COLORMATRIX_MAT,
+     BLIT_CONVOLUTION,
+     BLIT_CONVOLUTION_MAT,
+     DRAW_FETCH,
+     DRAW_FETCH_MAT,
+     BLIT_FETCH,
+     BLIT_FETCH_MAT,
+     DRAW_AA,
+     DRAW_AA_MAT,
+     BLIT_AA,
+     BLIT_AA_MAT,
+     BLIT_SCALE,
+     BLIT_SCALE_MAT,
      NUM_PROGRAMS,
      INVALID_PROGRAM
 } GLES2ProgramIndex;
 
+typedef enum {
+     GLES2AC_DRAW        = 0, /* drawing functions */
+     GLES2AC_BLIT        = 1, /* DFXL_BLIT */
+     GLES2AC_STRETCHBLIT = 2, /* DFXL_STRETCHBLIT */
+     NUM_ACCEL_CLASSES
+} GLES2AccelClass;
+
+typedef enum {
+     GLES2DK_NONE        = 0x00000000,
+
+     GLES2DK_MATRIX      = 0x00000001, /* DSRO_MATRIX */
+     GLES2DK_BLEND       = 0x00000002, /* DSDRAW_BLEND, DSBLIT_BLEND_ALPHACHANNEL or DSBLIT_BLEND_COLORALPHA */
+     GLES2DK_COLORKEY    = 0x00000004, /* DSBLIT_SRC_COLORKEY */
+     GLES2DK_PREMULTIPLY = 0x00000008, /* DSBLIT_SRC_PREMULTIPLY */
+     GLES2DK_COLOR       = 0x00000010, /* DSBLIT_COLORIZE, DSBLIT_BLEND_COLORALPHA or DSBLIT_SRC_PREMULTCOLOR */
+     GLES2DK_DST_PREMUL  = 0x00000020, /* DSBLIT/DSDRAW_DST_PREMULTIPLY with a destination blend function of one */
+     GLES2DK_FETCH       = 0x00000040, /* other uses of DSBLIT/DSDRAW_DST_PREMULTIPLY or DSBLIT/DSDRAW_DEMULTIPLY */
+     GLES2DK_ANTIALIAS   = 0x00000080, /* DSRO_ANTIALIAS */
+     GLES2DK_SCALE       = 0x00000100, /* DSRO_SMOOTH_UPSCALE with a StretchBlit() scaler */
+     GLES2DK_COLORMATRIX = 0x00000200, /* DSBLIT_SRC_COLORMATRIX */
+     GLES2DK_CONVOLUTION = 0x00000400, /* DSBLIT_SRC_CONVOLUTION */
+
+     NUM_DISPATCH_KEYS   = 0x00000800
+} GLES2DispatchKey;
+
+typedef enum {
+     GLES2BM_DISABLED,   /* no blending */
+     GLES2BM_STATE,      /* blend functions of the state */
+     GLES2BM_COLORKEY,   /* source over blending of the fragments not discarded by color keying */
+     GLES2BM_DST_PREMUL, /* blend functions of the state, premultiplying the destination color by its alpha */
+     GLES2BM_FETCH,      /* blending in the shader, reading the destination with framebuffer fetch */
+     GLES2BM_COVERAGE    /* mixing with the destination by the edge coverage, for anti-aliasing without blending */
+} GLES2BlendMode;
+
+typedef struct {
+     GLES2ProgramIndex    prog_index; /* program to use */
+     GLES2ValidationFlags validation; /* states to validate */
+     GLES2BlendMode       blend;      /* blending setup */
+     GLenum               filter;     /* texture filter, GL_LINEAR if it is chosen by the smooth scaling options */
+} GLES2Dispatch;
+
+#define GLES2_TIMER_QUERIES   64
+#define GLES2_STATS_SURFACES  16
+#define GLES2_STATS_FALLBACKS 64
+
+typedef struct {
+     GLuint            obj;        /* the query object */
+     GLES2ProgramIndex prog_index; /* program in use while the query was active */
+     u32               surface_id; /* destination surface object id */
+     unsigned int      flush;      /* flush the query was issued before */
+} GLES2TimerQuery;
+
+typedef struct {
+     unsigned long long time_ns; /* accumulated GPU time in nanoseconds */
+     unsigned int       batches; /* number of timed batches */
+} GLES2TimingCounter;
+
+typedef struct {
+     u32                surface_id; /* destination surface object id, 0 if unused */
+     GLES2TimingCounter counter;    /* GPU time spent rendering into this surface */
+} GLES2SurfaceTiming;
+
+typedef struct {
+     DFBAccelerationMask   accel;      /* rejected function */
+     u32                   rejected;   /* rejected function, drawing or blitting flag bits, 0 for surface size */
+     DFBSurfacePixelFormat src_format; /* source pixel format, DSPF_UNKNOWN for drawing */
+     DFBSurfacePixelFormat dst_format; /* destination pixel format */
+     unsigned int          count;      /* number of rejected checks */
+     unsigned long long    pixels;     /* accumulated clip area, an upper bound of the pixels rendered in software */
+} GLES2Fallback;
+
+typedef struct {
+     bool               gpu_timing;                       /* GL_EXT_disjoint_timer_query based timing enabled */
+     unsigned int       interval;                         /* report every n flushes, 0 for a report at close only */
+     unsigned int       flushes;                          /* number of flushes ending batches, not frames */
+
+     GLES2TimerQuery    queries[GLES2_TIMER_QUERIES];     /* ring of query objects */
+     unsigned int       query_head;                       /* next query to issue */
+     unsigned int       query_tail;                       /* oldest query not yet retired */
+     bool               query_active;                     /* query at head - 1 is between begin and end */
+     unsigned int       queries_dropped;                  /* batches not timed because the ring was full */
+     unsigned int       queries_disjoint;                 /* results discarded due to a disjoint operation */
+
+     GLES2TimingCounter progs[NUM_PROGRAMS];              /* GPU time per program */
+     GLES2SurfaceTiming surfaces[GLES2_STATS_SURFACES];   /* GPU time per destination surface */
+
+     unsigned int       timed_flush;                      /* flush being accumulated from retired queries */
+     unsigned long long timed_flush_ns;                   /* GPU time of the flush being accumulated */
+     unsigned long long max_flush_ns;                     /* longest flush GPU time */
+     unsigned int       timed_flushes;                    /* number of flushes with complete GPU time */
+     unsigned long long total_flush_ns;                   /* GPU time of all complete flushes */
+
+     bool               fallback_profiler;                /* CheckState() rejections are recorded */
+     GLES2Fallback      fallbacks[GLES2_STATS_FALLBACKS]; /* rejections by function, flags and formats */
+     unsigned int       num_fallbacks;                    /* number of used entries */
+     unsigned int       fallbacks_dropped;                /* rejections not recorded because the table is full */
+
+     unsigned int       culled;                           /* primitives dropped by overdraw culling */
+     unsigned long long culled_pixels;                    /* pixels of the dropped primitives within the clip */
+     unsigned int       reordered;                        /* primitives moved back to an earlier equal state */
+} GLES2Statistics;
+
+typedef struct __GLES2Trace GLES2Trace;
+
+#define GLES2_MIPMAPS 16
+
+typedef struct {
+     GLuint                 tex;        /* texture object, 0 if unused */
+     CoreSurfaceAllocation *allocation; /* source allocation the texture belongs to */
+     FusionObjectID         id;         /* object id of the allocation, another one may get the same address */
+     u32                    serial;     /* allocation serial when the mipmaps were generated */
+     unsigned int           used;       /* last use, for replacement */
+} GLES2Mipmap;
+
+#define GLES2_FBOS 16
+
+typedef struct {
+     GLuint                 tex;        /* destination texture, 0 if unused */
+     CoreSurfaceAllocation *allocation; /* destination allocation the texture belongs to */
+     FusionObjectID         id;         /* object id of the allocation, another one may get the same address */
+     FusionObjectID         surface;    /* object id of the destination surface, released when it's destroyed or
+                                           reallocated */
+     GLuint                 fbo;        /* framebuffer object, 0 if the texture is not color renderable */
+     unsigned int           used;       /* last use, for replacement */
+} GLES2Framebuffer;
+
+#define GLES2_FBO_WATCHES   64
+#define GLES2_FBO_DESTROYED 32
+
+typedef struct {
+     CoreSurface           *surface;    /* surface listened to, NULL if unused */
+     FusionObjectID         id;         /* object id of the surface */
+     Reaction               reaction;   /* surface listener */
+} GLES2FramebufferWatch;
+
+#define GLES2_ATLAS_PAGES   4
+#define GLES2_ATLAS_SIZE    1024
+#define GLES2_ATLAS_SHELVES 64
+#define GLES2_ATLAS_ENTRIES 256
+#define GLES2_ATLAS_CHANGES 2
+
+typedef struct {
+     int                    x;          /* first free column */
+     int                    y;          /* first row */
+     int                    h;          /* height of the slots */
+} GLES2AtlasShelf;
+
+typedef struct {
+     GLuint                 tex;                          /* atlas texture, 0 if not created yet */
+     GLES2AtlasShelf        shelves[GLES2_ATLAS_SHELVES]; /* rows of slots */
+     unsigned int           num_shelves;                  /* number of used shelves */
+     int                    top;                          /* first row not used by a shelf */
+     unsigned int           used;                         /* last use, for eviction */
+} GLES2AtlasPage;
+
+typedef struct {
+     GLuint                 tex;        /* source texture, 0 if unused */
+     CoreSurfaceAllocation *allocation; /* source allocation the texture belongs to */
+     FusionObjectID         id;         /* object id of the allocation, another one may get the same address */
+     u32                    serial;     /* allocation serial when the source was copied */
+     unsigned int           changes;    /* number of modifications after a copy, not copied again after
+                                           GLES2_ATLAS_CHANGES */
+     GLES2AtlasPage        *page;       /* page holding the copy, NULL if not copied */
+     DFBPoint               slot;       /* position of the copy within the page */
+     unsigned int           used;       /* last use, for replacement */
+} GLES2AtlasEntry;
+
 typedef struct {
-     DFBSurfaceBlittingFlags blittingflags; /* blitting flags */
-     float                   aspect;        /* layer aspect scaling */
-     int                     rotation;      /* layer rotation */
+     GLuint                 tex;        /* source texture */
+     int                    w;          /* source width */
+     int                    h;          /* source height */
+     GLES2AtlasPage        *page;       /* destination page */
+     DFBPoint               slot;       /* position within the page */
+     CoreSurfaceAllocation *allocation; /* source allocation, referenced while the upload is kept */
+} GLES2AtlasUpload;
+
+typedef struct {
+     int                    max_size;                     /* maximum width and height of copied sources, 0 if
+                                                             disabled */
+     int                    size;                         /* width and height of the pages */
+     GLES2AtlasPage         pages[GLES2_ATLAS_PAGES];     /* atlas textures */
+     GLES2AtlasEntry        entries[GLES2_ATLAS_ENTRIES]; /* sources with a copy */
+     unsigned int           stamp;                        /* use counter for replacement */
+     const GLES2AtlasPage  *bound;                        /* page bound as the source of the applied state, NULL
+                                                             if the source texture is bound */
+} GLES2Atlas;
+
+#define GLES2_CONTEXTS 8
+
+#define GLES2_LAYOUTS 4
+
+#define GLES2_RING_SIZE (512 * 1024)
+
+typedef struct {
+     EGLContext           context;             /* EGL context, EGL_NO_CONTEXT if unused */
+     bool                 owned;               /* created by the driver, sharing objects with the first context */
+     GLES2ProgramIndex    prog_index;          /* current program in use */
+     GLES2ValidationFlags flags[NUM_PROGRAMS]; /* validation flags of each program */
+     GLES2Framebuffer     fbos[GLES2_FBOS];    /* framebuffer objects of destination textures, not shared */
+     GLuint               cached;              /* framebuffer object of the cache bound, 0 if none */
+     GLint                system;              /* framebuffer bound by the system module before, bound again
+                                                  after the commands */
+     GLuint               restored;            /* framebuffer object of the cache unbound by the restoration,
+                                                  bound again before further commands */
+     unsigned int         destroyed;           /* number of destroyed surfaces whose framebuffer objects have been
+                                                  released */
+     bool                 edges;               /* edge distances vertex attribute array is enabled */
+     bool                 rects;               /* constant rectangle attributes for primitives not instanced are
+                                                  set */
+     GLuint               vaos[GLES2_LAYOUTS]; /* vertex array objects by layout, OpenGL ES 3.x path only */
+     int                  layout;              /* layout of the bound vertex array object, -1 if not bound */
+     GLuint               ring;                /* vertex buffer written as a ring, OpenGL ES 3.x path only */
+     GLsizeiptr           ring_size;           /* size of the ring buffer */
+     GLintptr             ring_offset;         /* offset of the next write to the ring buffer */
+     GLuint               sampler;             /* bound sampler object, 0 if not bound */
+     bool                 issued;              /* commands have been issued since the last fence */
+     EGLSyncKHR           sync;                /* fence after the commands issued last, waited for by the next
+                                                  context executing commands */
+} GLES2Context;
+
+#define GLES2_FENCES 16
+
+typedef struct {
+     EGLSyncKHR         sync;   /* fence inserted after the batch */
+     CoreGraphicsSerial serial; /* serial of the batch, completed when the fence is signaled */
+} GLES2Fence;
+
+#define GLES2_PENDING_STATES   32
+#define GLES2_PENDING_COMMANDS 256
+#define GLES2_PENDING_UPLOADS  32
+#define GLES2_PENDING_REFS     (GLES2_PENDING_STATES * 2 + GLES2_PENDING_UPLOADS)
+
+typedef enum {
+     GLES2PC_STATE         = 0, /* apply a state passed to SetState() */
+     GLES2PC_FILLRECTANGLE = 1, /* FillRectangle() */
+     GLES2PC_BLIT          = 2  /* Blit() */
+} GLES2PendingType;
+
+typedef struct {
+     const GLES2Dispatch     *dispatch;            /* program and validation looked up by SetState() */
+     StateModificationFlags   mod_hw;              /* modifications since the previous state */
+
+     CoreSurfaceAllocation   *dst_allocation;      /* destination allocation, identifies the destination */
+     FusionObjectID           dst_id;              /* object id of the destination allocation */
+     GLuint                   dst_tex;             /* destination texture, 0 if not rendered via a texture */
+     DFBDimension             dst_size;            /* destination size */
+     u32                      surface_id;          /* destination surface object id, for statistics */
+     GLint                    framebuffer;         /* framebuffer bound by the system module for the destination */
+
+     CoreSurfaceAllocation   *src_allocation;      /* source allocation, NULL if not blitting */
+     GLuint                   src_tex;             /* source texture */
+     DFBDimension             src_size;            /* source size */
+
+     DFBRegion                clip;                /* fields of the state passed to SetState() used for the */
+     DFBColor                 color;               /* validation of the hardware states */
+     DFBSurfaceDrawingFlags   drawingflags;
+     DFBSurfaceBlittingFlags  blittingflags;
+     DFBSurfaceRenderOptions  render_options;
+     DFBSurfaceBlendFunction  src_blend;
+     DFBSurfaceBlendFunction  dst_blend;
+     u32                      src_colorkey;
+     s32                      matrix[9];
+     s32                      src_colormatrix[12];
+     DFBConvolutionFilter     src_convolution;
+
+     bool                     opaque;              /* primitives replace the destination within their rectangle */
+     bool                     offscreen;           /* destination is a texture of a surface not shown by a layer,
+                                                      bound via the framebuffer object cache, the primitives can be
+                                                      kept across operations and rendered by the submission
+                                                      thread */
+     GLES2AtlasEntry         *atlas;               /* copy of the source blitted from, NULL if the source texture
+                                                      is bound */
+     GLES2AtlasPage          *page;                /* page holding the copy when the state was queued */
+} GLES2PendingState;
+
+typedef struct {
+     GLES2PendingType     type;     /* command type */
+     unsigned int         state;    /* index of the state in effect */
+     bool                 culled;   /* covered by a later opaque primitive with the same destination and clip */
+     DFBRectangle         rect;     /* rectangle to fill or source rectangle */
+     DFBPoint             point;    /* destination of a blit */
+} GLES2PendingCommand;
+
+typedef struct {
+     GLES2PendingState      states[GLES2_PENDING_STATES];     /* states referenced by the commands, the first one may
+                                                                 have been applied already */
+     unsigned int           num_states;                       /* number of states */
+     GLES2PendingCommand    commands[GLES2_PENDING_COMMANDS]; /* commands in submission order */
+     unsigned int           num_commands;                     /* number of commands */
+     GLES2AtlasUpload       uploads[GLES2_PENDING_UPLOADS];   /* sources copied into atlas pages before the
+                                                                 commands are executed */
+     unsigned int           num_uploads;                      /* number of uploads */
+     bool                   onscreen;                         /* a command renders into the framebuffer bound by
+                                                                 the system module */
+     bool                   kept;                             /* kept across operations, the framebuffer bound by
+                                                                 the system module may have changed */
+     CoreSurfaceAllocation *refs[GLES2_PENDING_REFS];         /* allocations referenced while the batch is kept,
+                                                                 until it has been executed */
+     unsigned int           num_refs;                         /* number of referenced allocations */
+} GLES2Pending;
+
+#define GLES2_ASYNC_SLOTS 4
+
+typedef struct {
+     DirectThread          *thread;                       /* submission thread, NULL if disabled */
+     GLES2Context           context;                      /* context of the submission thread */
+     void                  *device_data;                  /* device data for the execution of batches */
+
+     GLES2Pending          *slots;                        /* ring of batches */
+     EGLSyncKHR             syncs[GLES2_ASYNC_SLOTS];     /* fences of the driver context a batch waits for */
+     unsigned int           head;                         /* number of submitted batches */
+     unsigned int           tail;                         /* number of executed batches */
+     unsigned int           completed;                    /* number of batches completed by the GPU */
+
+     DirectMutex            lock;                         /* lock for sleeping and waking up */
+     DirectWaitQueue        wakeup;                       /* signaled when a batch is submitted */
+     DirectWaitQueue        idle;                         /* signaled when a batch has been executed or completed */
+     bool                   sleeping;                     /* submission thread waits for a batch */
+     bool                   waiting;                      /* driver waits for a free slot */
+     bool                   started;                      /* submission thread has made its context current */
+     bool                   failed;                       /* submission thread failed to make its context current */
+     bool                   quit;                         /* submission thread exits when idle */
+} GLES2Async;
+
+typedef struct {
+     DFBSurfaceBlittingFlags            blittingflags;          /* blitting flags */
+     float                              aspect;                 /* layer aspect scaling */
+     int                                rotation;               /* layer rotation */
+
+     PFNGLGENQUERIESEXTPROC             GenQueriesEXT;          /* GL_EXT_disjoint_timer_query entry points */
+     PFNGLDELETEQUERIESEXTPROC          DeleteQueriesEXT;
+     PFNGLBEGINQUERYEXTPROC             BeginQueryEXT;
+     PFNGLENDQUERYEXTPROC               EndQueryEXT;
+     PFNGLGETQUERYOBJECTUIVEXTPROC      GetQueryObjectuivEXT;
+     PFNGLGETQUERYOBJECTUI64VEXTPROC    GetQueryObjectui64vEXT;
+     PFNGLDISCARDFRAMEBUFFEREXTPROC     DiscardFramebufferEXT;  /* GL_EXT_discard_framebuffer entry point or
+                                                                   glInvalidateFramebuffer(), NULL if not supported */
+     PFNGLDRAWARRAYSINSTANCEDEXTPROC    DrawArraysInstanced;    /* OpenGL ES 3.0, GL_EXT_instanced_arrays or
+                                                                   GL_ANGLE_instanced_arrays entry points, NULL if
+                                                                   not supported */
+     PFNGLVERTEXATTRIBDIVISOREXTPROC    VertexAttribDivisor;
+
+     bool                               es3;                    /* OpenGL ES 3.x path with vertex array objects,
+                                                                   ring buffers and sampler objects */
+     PFNGLGENVERTEXARRAYSPROC           GenVertexArrays;        /* OpenGL ES 3.0 entry points */
+     PFNGLDELETEVERTEXARRAYSPROC        DeleteVertexArrays;
+     PFNGLBINDVERTEXARRAYPROC           BindVertexArray;
+     PFNGLMAPBUFFERRANGEPROC            MapBufferRange;
+     PFNGLUNMAPBUFFERPROC               UnmapBuffer;
+     PFNGLGENSAMPLERSPROC               GenSamplers;
+     PFNGLDELETESAMPLERSPROC            DeleteSamplers;
+     PFNGLBINDSAMPLERPROC               BindSampler;
+     PFNGLSAMPLERPARAMETERIPROC         SamplerParameteri;
+     GLuint                             samplers[3][2];         /* sampler objects by minification filter (nearest,
+                                                                   linear, trilinear) and magnification filter */
+
+     GLES2Trace                        *trace;                  /* trace recorder, NULL if not recording */
+
+     bool                               mipmap;                 /* mipmaps are used for high StretchBlit() ratios */
+     bool                               mipmap_npot;            /* mipmaps of non power of two textures supported */
+     GLES2Mipmap                        mipmaps[GLES2_MIPMAPS]; /* sources with generated mipmaps */
+     unsigned int                       mipmap_stamp;           /* use counter for replacement */
+
+     GLES2Atlas                         atlas;                  /* copies of small blit sources */
+
+     CoreDFB                           *core;                   /* DirectFB core, NULL in the tools harness whose
+                                                                   surfaces are no core objects */
+
+     bool                               fbo_cache;              /* destination textures of surfaces not shown by a
+                                                                   layer are bound via driver FBOs */
+     unsigned int                       fbo_stamp;              /* use counter for replacement */
+     DirectMutex                        fbo_lock;               /* lock for the watched and destroyed surfaces */
+     GLES2FramebufferWatch              fbo_watches[GLES2_FBO_WATCHES];     /* surfaces rendered via the cache,
+                                                                               listened to for invalidation */
+     FusionObjectID                     fbo_destroyed[GLES2_FBO_DESTROYED]; /* surfaces destroyed or reallocated
+                                                                               last, written by the listener */
+     unsigned int                       fbo_num_destroyed;      /* number of destroyed surfaces, the last ones are
+                                                                   in the ring */
+     bool                               offscreen;              /* destination of the current state is an FBO */
+
+     bool                               reorder;                /* primitives are moved back to earlier equal
+                                                                   states across primitives not overlapping them */
+     GLES2Pending                       batch;                  /* commands queued until they are flushed */
+     CardState                         *state;                  /* state passed to SetState() last, with the
+                                                                   allocations locked for the current operation */
+     GLES2Pending                      *pending;                /* batch being recorded, a slot of the ring in
+                                                                   asynchronous mode */
+     GLES2Async                         async;                  /* asynchronous execution in a submission thread */
+
+     GLES2Context                       pool[GLES2_CONTEXTS];   /* contexts of the threads calling the driver, the
+                                                                   first one is current at initialization */
+     unsigned int                       num_contexts;           /* number of used contexts */
+     GLES2Context                      *context;                /* context that executed the last commands */
+     bool                               reapply;                /* the last state has to be applied again, in
+                                                                   another context or another framebuffer */
+     EGLConfig                          config;                 /* config of the first context */
+     EGLint                             client_version;         /* client version of the first context */
+     bool                               surfaceless;            /* EGL_KHR_surfaceless_context supported */
+     PFNEGLWAITSYNCKHRPROC              WaitSyncKHR;            /* EGL_KHR_wait_sync entry point, NULL if not
+                                                                   supported */
+
+     EGLDisplay                         display;                /* display the fences are created on */
+     PFNEGLCREATESYNCKHRPROC            CreateSyncKHR;          /* EGL_KHR_fence_sync entry points, NULL if not
+                                                                   supported */
+     PFNEGLDESTROYSYNCKHRPROC           DestroySyncKHR;
+     PFNEGLCLIENTWAITSYNCKHRPROC        ClientWaitSyncKHR;
+     PFNEGLGETSYNCATTRIBKHRPROC         GetSyncAttribKHR;
+     CoreGraphicsSerial                 serial;                 /* serial of the current batch */
+     bool                               serial_used;            /* serial of the current batch has been queried */
+     CoreGraphicsSerial                 done;                   /* last serial known to be completed */
+     GLES2Fence                         fences[GLES2_FENCES];   /* fences of submitted batches, oldest first */
+     unsigned int                       num_fences;             /* number of fences */
+
+     CoreSurfaceAllocation             *source;                 /* source allocation of the current state */
+     GLuint                             source_tex;             /* source texture of the current state */
+     GLenum                             filter;                 /* minification filter of the current state */
+     GLenum                             min_filter;             /* minification filter set for the source texture */
+     GLenum                             mag_filter;             /* magnification filter set for the source texture */
+
+     bool                               antialias;              /* current state draws anti-aliased primitives */
+     float                              margin;                 /* expansion of anti-aliased primitives to cover
+                                                                   partially covered pixels, in local units */
 } GLES2DriverData;
 
 typedef struct {
-     GLES2ProgramInfo  progs[NUM_PROGRAMS]; /* program info */
-     GLES2ProgramIndex prog_index;          /* current program in use */
+     CardCapabilities  caps;                                           /* cached device capabilities */
+     GLint             max_texture_size;                               /* GL_MAX_TEXTURE_SIZE, limit of sources */
+     GLint             max_viewport[2];                                /* GL_MAX_VIEWPORT_DIMS, limit of destinations */
+     GLES2Dispatch     dispatch[NUM_ACCEL_CLASSES][NUM_DISPATCH_KEYS]; /* program and validation lookup */
+
+     GLES2ProgramInfo  progs[NUM_PROGRAMS];                            /* program info, shared by the contexts */
+     bool              fetch;                                          /* programs blending with framebuffer fetch */
+     bool              antialias;                                      /* programs with edge coverage */
+     bool              scale;                                          /* StretchBlit() scaler programs */
+
+     GLES2Statistics   stats;                                          /* driver statistics */
 } GLES2DeviceData;
 
 #endif
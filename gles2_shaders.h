@@ -16,17 +16,22 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
 */
 
-/* Transform input 2D positions "dfbPos" by scale and offset to get GLES clip coordinates. */
+/*
+ * Transform input 2D positions "dfbPos" by scale and offset to get GLES clip coordinates. Instanced primitives pass the
+ * corners of a unit square, moved and scaled into the rectangle "dfbRect" of the instance, it's (0, 0, 1, 1) otherwise.
+ */
 static const char *draw_vert_src = "                                     \
 attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
 uniform   vec3 dfbScale;                                                 \
 uniform   mat3 dfbRotMatrix;                                             \
                                                                          \
 void main(void)                                                          \
 {                                                                        \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
      vec3 pos;                                                           \
-     pos.x = dfbScale.x * dfbPos.x - 1.0;                                \
-     pos.y = dfbScale.y * dfbPos.y + dfbScale.z;                         \
+     pos.x = dfbScale.x * p.x - 1.0;                                     \
+     pos.y = dfbScale.y * p.y + dfbScale.z;                              \
      pos.z = 0.0;                                                        \
      gl_Position = vec4(dfbRotMatrix * pos, 1.0);                        \
 }";
@@ -34,12 +39,14 @@ void main(void)                                                          \
 /* Transform input 2D positions "dfbPos" by the render options matrix before transforming to GLES clip coordinates. */
 static const char *draw_mat_vert_src = "                                 \
 attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
 uniform   mat3 dfbMVPMatrix;                                             \
 uniform   mat3 dfbROMatrix;                                              \
                                                                          \
 void main(void)                                                          \
 {                                                                        \
-     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(dfbPos, 0.0);          \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
+     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(p, 0.0);               \
      gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);                         \
 }";
 
@@ -54,10 +61,12 @@ void main(void)                                                          \
      gl_FragColor = dfbColor;                                            \
 }";
 
-/* This is the same as draw_vert_src with the addition of texture coords "dfbUV". */
+/* This is the same as draw_vert_src with the addition of texture coords "dfbUV", moved to "dfbTexPos" if instanced. */
 static const char *blit_vert_src = "                                     \
 attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
 attribute vec2 dfbUV;                                                    \
+attribute vec2 dfbTexPos;                                                \
 uniform   vec3 dfbScale;                                                 \
 uniform   mat3 dfbRotMatrix;                                             \
 uniform   vec2 dfbTexScale;                                              \
@@ -65,19 +74,23 @@ varying   vec2 varTexCoord;                                              \
                                                                          \
 void main(void)                                                          \
 {                                                                        \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
      vec3 pos;                                                           \
-     pos.x = dfbScale.x * dfbPos.x - 1.0;                                \
-     pos.y = dfbScale.y * dfbPos.y + dfbScale.z;                         \
+     pos.x = dfbScale.x * p.x - 1.0;                                     \
+     pos.y = dfbScale.y * p.y + dfbScale.z;                              \
      pos.z = 0.0;                                                        \
      gl_Position = vec4(dfbRotMatrix * pos, 1.0);                        \
-     varTexCoord.s = dfbTexScale.x * dfbUV.x;                            \
-     varTexCoord.t = dfbTexScale.y * dfbUV.y;                            \
+     vec2 uv = dfbTexPos + dfbRect.zw * dfbUV;                           \
+     varTexCoord.s = dfbTexScale.x * uv.x;                               \
+     varTexCoord.t = dfbTexScale.y * uv.y;                               \
 }";
 
 /* This is the same as draw_mat_vert_src with the addition of texture coords "dfbUV". */
 static const char *blit_mat_vert_src = "                                 \
 attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
 attribute vec2 dfbUV;                                                    \
+attribute vec2 dfbTexPos;                                                \
 uniform   mat3 dfbMVPMatrix;                                             \
 uniform   mat3 dfbROMatrix;                                              \
 uniform   vec2 dfbTexScale;                                              \
@@ -85,10 +98,12 @@ varying   vec2 varTexCoord;                                              \
                                                                          \
 void main(void)                                                          \
 {                                                                        \
-     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(dfbPos, 0.0);          \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
+     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(p, 0.0);               \
      gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);                         \
-     varTexCoord.s = dfbTexScale.x * dfbUV.x;                            \
-     varTexCoord.t = dfbTexScale.y * dfbUV.y;                            \
+     vec2 uv = dfbTexPos + dfbRect.zw * dfbUV;                           \
+     varTexCoord.s = dfbTexScale.x * uv.x;                               \
+     varTexCoord.t = dfbTexScale.y * uv.y;                               \
 }";
 
 /* Sample texture. */
@@ -150,3 +165,371 @@ void main(void)                                                          \
      gl_FragColor *= dfbColor;                                           \
      gl_FragColor.rgb *= gl_FragColor.a;                                 \
 }";
+
+/*
+ * Sample texture, transform the color by the source color matrix, modulate by static color and optionally premultiply
+ * by alpha. The matrix has the offsets in its last column, the factor of "dfbMultiply" is 0.0 or 1.0.
+ */
+static const char *blit_colormatrix_frag_src = "                         \
+precision mediump float;                                                 \
+                                                                         \
+uniform sampler2D dfbSampler;                                            \
+uniform vec4      dfbColor;                                              \
+uniform mat4      dfbColorMatrix;                                        \
+uniform vec3      dfbMultiply;                                           \
+varying vec2      varTexCoord;                                           \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec4 c = texture2D(dfbSampler, varTexCoord);                        \
+     c.rgb  = clamp((dfbColorMatrix * vec4(c.rgb, 1.0)).rgb, 0.0, 1.0);  \
+     c     *= dfbColor;                                                  \
+     c.rgb *= mix(1.0, c.a, dfbMultiply.x);                              \
+     gl_FragColor = c;                                                   \
+}";
+
+/*
+ * Blend with the destination read by GL_EXT_shader_framebuffer_fetch, in the order of the DirectFB pipeline: the
+ * destination color is premultiplied by its alpha, blended with the source using the DirectFB blend functions
+ * (DSBF_UNKNOWN meaning no blending), and the result is demultiplied. The factors of "dfbMultiply" are 0.0 or 1.0.
+ */
+#define BLEND_FETCH_SRC "                                                \
+uniform ivec2 dfbBlend;                                                  \
+uniform vec3  dfbMultiply;                                               \
+                                                                         \
+vec4 dfbFactor(int f, vec4 s, vec4 d)                                    \
+{                                                                        \
+     if (f == 1)  return vec4(0.0);                                      \
+     if (f == 2)  return vec4(1.0);                                      \
+     if (f == 3)  return s;                                              \
+     if (f == 4)  return vec4(1.0) - s;                                  \
+     if (f == 5)  return vec4(s.a);                                      \
+     if (f == 6)  return vec4(1.0 - s.a);                                \
+     if (f == 7)  return vec4(d.a);                                      \
+     if (f == 8)  return vec4(1.0 - d.a);                                \
+     if (f == 9)  return d;                                              \
+     if (f == 10) return vec4(1.0) - d;                                  \
+     return vec4(vec3(min(s.a, 1.0 - d.a)), 1.0);                        \
+}                                                                        \
+                                                                         \
+vec4 dfbBlendFetch(vec4 s)                                               \
+{                                                                        \
+     vec4 d = gl_LastFragData[0];                                        \
+     d.rgb *= mix(1.0, d.a, dfbMultiply.y);                              \
+     if (dfbBlend.x != 0)                                                \
+          s = clamp(s * dfbFactor(dfbBlend.x, s, d) +                    \
+                    d * dfbFactor(dfbBlend.y, s, d), 0.0, 1.0);          \
+     if (dfbMultiply.z != 0.0 && s.a != 0.0)                             \
+          s.rgb = min(s.rgb / s.a, 1.0);                                 \
+     return s;                                                           \
+}"
+
+/* Draw fragment in a constant color, blended in the shader. */
+static const char *draw_fetch_frag_src = "                               \
+#extension GL_EXT_shader_framebuffer_fetch : require                     \n\
+precision mediump float;                                                 \
+                                                                         \
+uniform vec4 dfbColor;                                                   \
+" BLEND_FETCH_SRC "                                                      \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     gl_FragColor = dfbBlendFetch(dfbColor);                             \
+}";
+
+/* Sample texture, modulate by static color, optionally premultiply by alpha, and blend in the shader. */
+static const char *blit_fetch_frag_src = "                               \
+#extension GL_EXT_shader_framebuffer_fetch : require                     \n\
+precision mediump float;                                                 \
+                                                                         \
+uniform sampler2D dfbSampler;                                            \
+uniform vec4      dfbColor;                                              \
+varying vec2      varTexCoord;                                           \
+" BLEND_FETCH_SRC "                                                      \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec4 c = texture2D(dfbSampler, varTexCoord) * dfbColor;             \
+     c.rgb *= mix(1.0, c.a, dfbMultiply.x);                              \
+     gl_FragColor = dfbBlendFetch(c);                                    \
+}";
+
+/* This is the same as draw_vert_src with the addition of the distances "dfbEdge" to the edges of the primitive. */
+static const char *draw_aa_vert_src = "                                  \
+attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbEdge;                                                  \
+uniform   vec3 dfbScale;                                                 \
+uniform   mat3 dfbRotMatrix;                                             \
+varying   vec4 varEdge;                                                  \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec3 pos;                                                           \
+     pos.x = dfbScale.x * dfbPos.x - 1.0;                                \
+     pos.y = dfbScale.y * dfbPos.y + dfbScale.z;                         \
+     pos.z = 0.0;                                                        \
+     gl_Position = vec4(dfbRotMatrix * pos, 1.0);                        \
+     varEdge = dfbEdge;                                                  \
+}";
+
+/* This is the same as draw_mat_vert_src with the addition of the distances "dfbEdge" to the edges of the primitive. */
+static const char *draw_aa_mat_vert_src = "                              \
+attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbEdge;                                                  \
+uniform   mat3 dfbMVPMatrix;                                             \
+uniform   mat3 dfbROMatrix;                                              \
+varying   vec4 varEdge;                                                  \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(dfbPos, 0.0);          \
+     gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);                         \
+     varEdge = dfbEdge;                                                  \
+}";
+
+/* This is the same as blit_vert_src with the addition of the distances "dfbEdge" to the edges of the primitive. */
+static const char *blit_aa_vert_src = "                                  \
+attribute vec2 dfbPos;                                                   \
+attribute vec2 dfbUV;                                                    \
+attribute vec4 dfbEdge;                                                  \
+uniform   vec3 dfbScale;                                                 \
+uniform   mat3 dfbRotMatrix;                                             \
+uniform   vec2 dfbTexScale;                                              \
+varying   vec2 varTexCoord;                                              \
+varying   vec4 varEdge;                                                  \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec3 pos;                                                           \
+     pos.x = dfbScale.x * dfbPos.x - 1.0;                                \
+     pos.y = dfbScale.y * dfbPos.y + dfbScale.z;                         \
+     pos.z = 0.0;                                                        \
+     gl_Position = vec4(dfbRotMatrix * pos, 1.0);                        \
+     varTexCoord.s = dfbTexScale.x * dfbUV.x;                            \
+     varTexCoord.t = dfbTexScale.y * dfbUV.y;                            \
+     varEdge = dfbEdge;                                                  \
+}";
+
+/* This is the same as blit_mat_vert_src with the addition of the distances "dfbEdge" to the edges of the primitive. */
+static const char *blit_aa_mat_vert_src = "                              \
+attribute vec2 dfbPos;                                                   \
+attribute vec2 dfbUV;                                                    \
+attribute vec4 dfbEdge;                                                  \
+uniform   mat3 dfbMVPMatrix;                                             \
+uniform   mat3 dfbROMatrix;                                              \
+uniform   vec2 dfbTexScale;                                              \
+varying   vec2 varTexCoord;                                              \
+varying   vec4 varEdge;                                                  \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(dfbPos, 0.0);          \
+     gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);                         \
+     varTexCoord.s = dfbTexScale.x * dfbUV.x;                            \
+     varTexCoord.t = dfbTexScale.y * dfbUV.y;                            \
+     varEdge = dfbEdge;                                                  \
+}";
+
+/* High precision if available, for values in the units of the positions or texels. */
+#define HIGHP_SRC "                                                      \
+#ifdef GL_FRAGMENT_PRECISION_HIGH                                        \n\
+precision highp float;                                                   \n\
+#else                                                                    \n\
+precision mediump float;                                                 \n\
+#endif                                                                   \n\
+"
+
+/*
+ * Anti-aliasing by the coverage of the fragment, computed from the interpolated distances to the (up to four) edges of
+ * a convex primitive and their screen space derivatives, which need GL_OES_standard_derivatives. The distances are in
+ * the units of the positions and can be large, high precision is used if available. The factors of "dfbCoverage" are
+ * 0.0 or 1.0: the color is scaled by the coverage if it is not scaled by the alpha in blending, the coverage replaces
+ * the alpha if the destination is mixed by the blend functions without blending, and the source is premultiplied.
+ * Fragments not covered at all are discarded.
+ */
+#define COVERAGE_SRC "                                                   \
+#extension GL_OES_standard_derivatives : enable                          \n\
+" HIGHP_SRC "                                                            \
+uniform vec3 dfbCoverage;                                                \
+varying vec4 varEdge;                                                    \
+                                                                         \
+vec4 dfbApplyCoverage(vec4 s)                                            \
+{                                                                        \
+     vec4  dx = dFdx(varEdge);                                           \
+     vec4  dy = dFdy(varEdge);                                           \
+     vec4  w  = max(sqrt(dx * dx + dy * dy), vec4(1.0e-4));              \
+     vec4  e  = clamp(clamp(varEdge, -w, w) / w + 0.5, 0.0, 1.0);        \
+     float c  = min(min(e.x, e.y), min(e.z, e.w));                       \
+     if (c <= 0.0)                                                       \
+          discard;                                                       \
+     return vec4(s.rgb * mix(1.0, c, dfbCoverage.x),                     \
+                 mix(s.a, 1.0, dfbCoverage.y) * c);                      \
+}"
+
+/* Draw fragment in a constant color, anti-aliased. */
+static const char *draw_aa_frag_src = COVERAGE_SRC "                     \
+                                                                         \
+uniform vec4 dfbColor;                                                   \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     gl_FragColor = dfbApplyCoverage(dfbColor);                          \
+}";
+
+/* Sample texture, modulate by static color, optionally premultiply by alpha, and anti-alias. */
+static const char *blit_aa_frag_src = COVERAGE_SRC "                     \
+                                                                         \
+uniform sampler2D dfbSampler;                                            \
+uniform vec4      dfbColor;                                              \
+varying vec2      varTexCoord;                                           \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec4 c = texture2D(dfbSampler, varTexCoord) * dfbColor;             \
+     c.rgb *= mix(1.0, c.a, dfbCoverage.z);                              \
+     gl_FragColor = dfbApplyCoverage(c);                                 \
+}";
+
+/* This is the same as blit_vert_src passing the texture coords in texels and the size of a texel for sampling. */
+static const char *blit_texel_vert_src = "                               \
+attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
+attribute vec2 dfbUV;                                                    \
+attribute vec2 dfbTexPos;                                                \
+uniform   vec3 dfbScale;                                                 \
+uniform   mat3 dfbRotMatrix;                                             \
+uniform   vec2 dfbTexScale;                                              \
+varying   vec2 varTexCoord;                                              \
+varying   vec2 varTexScale;                                              \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
+     vec3 pos;                                                           \
+     pos.x = dfbScale.x * p.x - 1.0;                                     \
+     pos.y = dfbScale.y * p.y + dfbScale.z;                              \
+     pos.z = 0.0;                                                        \
+     gl_Position = vec4(dfbRotMatrix * pos, 1.0);                        \
+     varTexCoord = dfbTexPos + dfbRect.zw * dfbUV;                       \
+     varTexScale = dfbTexScale;                                          \
+}";
+
+/* This is the same as blit_mat_vert_src passing the texture coords in texels and the size of a texel. */
+static const char *blit_texel_mat_vert_src = "                           \
+attribute vec2 dfbPos;                                                   \
+attribute vec4 dfbRect;                                                  \
+attribute vec2 dfbUV;                                                    \
+attribute vec2 dfbTexPos;                                                \
+uniform   mat3 dfbMVPMatrix;                                             \
+uniform   mat3 dfbROMatrix;                                              \
+uniform   vec2 dfbTexScale;                                              \
+varying   vec2 varTexCoord;                                              \
+varying   vec2 varTexScale;                                              \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec2 p = dfbRect.xy + dfbRect.zw * dfbPos;                          \
+     vec3 pos = dfbMVPMatrix * dfbROMatrix * vec3(p, 0.0);               \
+     gl_Position = vec4(pos.x, pos.y, 0.0, 1.0);                         \
+     varTexCoord = dfbTexPos + dfbRect.zw * dfbUV;                       \
+     varTexScale = dfbTexScale;                                          \
+}";
+
+/*
+ * Scale the source by a separable kernel of 4x4 texels, weighted by "dfbWeight()" of the distance to the texel centers,
+ * which is defined by the bicubic or lanczos scaler. The texels are sampled at their centers, without filtering, the
+ * negative lobes of the kernels can exceed the range of the color.
+ */
+#define SCALE_SRC HIGHP_SRC "                                            \
+                                                                         \
+uniform sampler2D dfbSampler;                                            \
+uniform vec4      dfbColor;                                              \
+varying vec2      varTexCoord;                                           \
+varying vec2      varTexScale;                                           \
+                                                                         \
+float dfbWeight(float x);                                                \
+                                                                         \
+vec4 dfbWeights(float f)                                                 \
+{                                                                        \
+     return vec4(dfbWeight(1.0 + f), dfbWeight(f),                       \
+                 dfbWeight(1.0 - f), dfbWeight(2.0 - f));                \
+}                                                                        \
+                                                                         \
+vec4 dfbRow(vec2 p, vec4 w)                                              \
+{                                                                        \
+     vec2 dx = vec2(varTexScale.x, 0.0);                                 \
+     return texture2D(dfbSampler, p - dx)       * w.x +                  \
+            texture2D(dfbSampler, p)            * w.y +                  \
+            texture2D(dfbSampler, p + dx)       * w.z +                  \
+            texture2D(dfbSampler, p + 2.0 * dx) * w.w;                   \
+}                                                                        \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec2 t  = varTexCoord - 0.5;                                        \
+     vec2 f  = fract(t);                                                 \
+     vec2 p  = (t - f + 0.5) * varTexScale;                              \
+     vec2 dy = vec2(0.0, varTexScale.y);                                 \
+     vec4 wx = dfbWeights(f.x);                                          \
+     vec4 wy = dfbWeights(f.y);                                          \
+     vec4 c  = dfbRow(p - dy,       wx) * wy.x +                         \
+               dfbRow(p,            wx) * wy.y +                         \
+               dfbRow(p + dy,       wx) * wy.z +                         \
+               dfbRow(p + 2.0 * dy, wx) * wy.w;                          \
+     c /= dot(wx, vec4(1.0)) * dot(wy, vec4(1.0));                       \
+     gl_FragColor = clamp(c, 0.0, 1.0) * dfbColor;                       \
+}"
+
+/* Bicubic (Catmull-Rom) scaler, modulating by static color. */
+static const char *blit_bicubic_frag_src = SCALE_SRC "                   \
+                                                                         \
+float dfbWeight(float x)                                                 \
+{                                                                        \
+     x = abs(x);                                                         \
+     return x < 1.0 ? (1.5 * x - 2.5) * x * x + 1.0 :                    \
+                      ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;            \
+}";
+
+/* Lanczos scaler with two lobes, modulating by static color. */
+static const char *blit_lanczos_frag_src = SCALE_SRC "                   \
+                                                                         \
+float dfbWeight(float x)                                                 \
+{                                                                        \
+     x = max(abs(x), 1.0e-4) * 3.14159265;                               \
+     return 2.0 * sin(x) * sin(0.5 * x) / (x * x);                       \
+}";
+
+/*
+ * Convolve the 3x3 neighborhood of the source with the kernel, whose columns are the rows of the DirectFB kernel
+ * multiplied by its scale, and add the bias. The result is modulated by static color and optionally premultiplied by
+ * alpha, the factor of "dfbMultiply" is 0.0 or 1.0.
+ */
+static const char *blit_convolution_frag_src = HIGHP_SRC "               \
+                                                                         \
+uniform sampler2D dfbSampler;                                            \
+uniform vec4      dfbColor;                                              \
+uniform mat3      dfbKernel;                                             \
+uniform float     dfbBias;                                               \
+uniform vec3      dfbMultiply;                                           \
+varying vec2      varTexCoord;                                           \
+varying vec2      varTexScale;                                           \
+                                                                         \
+vec4 dfbRow(vec2 p, vec3 k)                                              \
+{                                                                        \
+     vec2 dx = vec2(varTexScale.x, 0.0);                                 \
+     return texture2D(dfbSampler, p - dx) * k.x +                        \
+            texture2D(dfbSampler, p)      * k.y +                        \
+            texture2D(dfbSampler, p + dx) * k.z;                         \
+}                                                                        \
+                                                                         \
+void main(void)                                                          \
+{                                                                        \
+     vec2 p  = varTexCoord * varTexScale;                                \
+     vec2 dy = vec2(0.0, varTexScale.y);                                 \
+     vec4 c  = dfbRow(p - dy, dfbKernel[0]) +                            \
+               dfbRow(p,      dfbKernel[1]) +                            \
+               dfbRow(p + dy, dfbKernel[2]);                             \
+     c      = clamp(c + dfbBias, 0.0, 1.0) * dfbColor;                   \
+     c.rgb *= mix(1.0, c.a, dfbMultiply.x);                              \
+     gl_FragColor = c;                                                   \
+}";
@@ -0,0 +1,494 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/gfxcard.h>
+#include <core/state.h>
+#include <direct/conf.h>
+#include <EGL/egl.h>
+#include <misc/util.h>
+
+#include "gles2_stats.h"
+
+D_DEBUG_DOMAIN( GLES2_Stats, "GLES2/Stats", "OpenGL ES 2.0 Statistics" );
+
+/**********************************************************************************************************************/
+
+static void
+stats_account_flush( GLES2Statistics *stats )
+{
+     if (!stats->timed_flush_ns)
+          return;
+
+     stats->timed_flushes++;
+     stats->total_flush_ns += stats->timed_flush_ns;
+
+     if (stats->max_flush_ns < stats->timed_flush_ns)
+          stats->max_flush_ns = stats->timed_flush_ns;
+
+     stats->timed_flush_ns = 0;
+}
+
+static void
+stats_account_query( GLES2Statistics       *stats,
+                     const GLES2TimerQuery *query,
+                     GLuint64               time_ns )
+{
+     GLES2SurfaceTiming *surface = NULL;
+     int                 i;
+
+     stats->progs[query->prog_index].time_ns += time_ns;
+     stats->progs[query->prog_index].batches++;
+
+     /* Look up the destination surface, reusing the entry with the least GPU time if the table is full. */
+     for (i = 0; i < GLES2_STATS_SURFACES; i++) {
+          if (stats->surfaces[i].surface_id == query->surface_id) {
+               surface = &stats->surfaces[i];
+               break;
+          }
+
+          if (!surface || surface->counter.time_ns > stats->surfaces[i].counter.time_ns)
+               surface = &stats->surfaces[i];
+     }
+
+     if (surface->surface_id != query->surface_id) {
+          surface->surface_id      = query->surface_id;
+          surface->counter.time_ns = 0;
+          surface->counter.batches = 0;
+     }
+
+     surface->counter.time_ns += time_ns;
+     surface->counter.batches++;
+
+     /* Queries retire in order, so a query of a newer flush completes the flush being accumulated. */
+     if (query->flush != stats->timed_flush) {
+          stats_account_flush( stats );
+
+          stats->timed_flush = query->flush;
+     }
+
+     stats->timed_flush_ns += time_ns;
+}
+
+/*
+ * Retire all queries whose results are available, without ever waiting for the GPU.
+ */
+static void
+stats_retire_queries( GLES2DriverData *drv,
+                      GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats   = &dev->stats;
+     unsigned int     pending = stats->query_head - (stats->query_active ? 1 : 0);
+     unsigned int     tail    = stats->query_tail;
+     GLuint64         times[GLES2_TIMER_QUERIES];
+     unsigned int     num     = 0;
+     GLuint           available;
+     GLint            disjoint;
+
+     while (tail != pending) {
+          GLES2TimerQuery *query = &stats->queries[tail % GLES2_TIMER_QUERIES];
+
+          drv->GetQueryObjectuivEXT( query->obj, GL_QUERY_RESULT_AVAILABLE_EXT, &available );
+          if (!available)
+               break;
+
+          drv->GetQueryObjectui64vEXT( query->obj, GL_QUERY_RESULT_EXT, &times[num++] );
+
+          tail++;
+     }
+
+     if (!num)
+          return;
+
+     /* Results are meaningless if a disjoint operation (e.g. a frequency change) occurred meanwhile. */
+     glGetIntegerv( GL_GPU_DISJOINT_EXT, &disjoint );
+     if (disjoint) {
+          D_DEBUG_AT( GLES2_Stats, "  -> discarding %u results (disjoint)\n", num );
+
+          stats->queries_disjoint += num;
+     }
+     else {
+          unsigned int i;
+
+          for (i = 0; i < num; i++)
+               stats_account_query( stats, &stats->queries[(stats->query_tail + i) % GLES2_TIMER_QUERIES], times[i] );
+     }
+
+     stats->query_tail = tail;
+}
+
+static void
+stats_end_query( GLES2DriverData *drv,
+                 GLES2DeviceData *dev )
+{
+     if (dev->stats.query_active) {
+          drv->EndQueryEXT( GL_TIME_ELAPSED_EXT );
+
+          dev->stats.query_active = false;
+     }
+}
+
+/*
+ * Check if GPU timing is enabled. Query objects are not shared between contexts, timing ends when another thread
+ * calls the driver. The queries are ended and deleted in the first context, otherwise they are left to it.
+ */
+static bool
+stats_timing( GLES2DriverData *drv,
+              GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats = &dev->stats;
+     int              i;
+
+     if (!stats->gpu_timing)
+          return false;
+
+     /* No context is left after the driver's contexts have been deinitialized. */
+     if (drv->num_contexts <= 1)
+          return true;
+
+     D_INFO( "GLES2/Stats: GPU timing disabled, query objects are not shared with the contexts of other threads\n" );
+
+     if (drv->context == &drv->pool[0]) {
+          stats_end_query( drv, dev );
+
+          for (i = 0; i < GLES2_TIMER_QUERIES; i++)
+               drv->DeleteQueriesEXT( 1, &stats->queries[i].obj );
+     }
+
+     stats->gpu_timing = false;
+
+     return false;
+}
+
+static const char *
+stats_accel_name( DFBAccelerationMask accel )
+{
+     switch (accel) {
+          case DFXL_FILLRECTANGLE:
+               return "FillRectangle";
+          case DFXL_DRAWRECTANGLE:
+               return "DrawRectangle";
+          case DFXL_DRAWLINE:
+               return "DrawLine";
+          case DFXL_FILLTRIANGLE:
+               return "FillTriangle";
+          case DFXL_FILLTRAPEZOID:
+               return "FillTrapezoid";
+          case DFXL_FILLQUADRANGLE:
+               return "FillQuadrangle";
+          case DFXL_FILLSPAN:
+               return "FillSpan";
+          case DFXL_DRAWMONOGLYPH:
+               return "DrawMonoGlyph";
+          case DFXL_BLIT:
+               return "Blit";
+          case DFXL_STRETCHBLIT:
+               return "StretchBlit";
+          case DFXL_TEXTRIANGLES:
+               return "TextureTriangles";
+          case DFXL_BLIT2:
+               return "Blit2";
+          case DFXL_TILEBLIT:
+               return "TileBlit";
+          default:
+               return "unknown";
+     }
+}
+
+static int
+stats_fallback_compare( const void *a,
+                        const void *b )
+{
+     const GLES2Fallback *fa = a;
+     const GLES2Fallback *fb = b;
+
+     if (fa->count != fb->count)
+          return fa->count < fb->count ? 1 : -1;
+
+     if (fa->pixels != fb->pixels)
+          return fa->pixels < fb->pixels ? 1 : -1;
+
+     return 0;
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_stats_init( GLES2DriverData *drv,
+                  GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats = &dev->stats;
+     const char      *extensions;
+     GLint            disjoint;
+     int              i;
+
+     D_DEBUG_AT( GLES2_Stats, "%s()\n", __FUNCTION__ );
+
+     memset( stats, 0, sizeof(GLES2Statistics) );
+
+     stats->interval = direct_config_get_int_value( "gles2-stats-interval" );
+
+     stats->fallback_profiler = direct_config_has_name( "gles2-fallback-profiler" );
+
+     if (!direct_config_has_name( "gles2-gpu-timing" ))
+          return;
+
+     extensions = (const char*) glGetString( GL_EXTENSIONS );
+     if (!extensions || !strstr( extensions, "GL_EXT_disjoint_timer_query" )) {
+          D_INFO( "GLES2/Stats: GL_EXT_disjoint_timer_query not supported, GPU timing disabled\n" );
+          return;
+     }
+
+     drv->GenQueriesEXT          = (PFNGLGENQUERIESEXTPROC)          eglGetProcAddress( "glGenQueriesEXT" );
+     drv->DeleteQueriesEXT       = (PFNGLDELETEQUERIESEXTPROC)       eglGetProcAddress( "glDeleteQueriesEXT" );
+     drv->BeginQueryEXT          = (PFNGLBEGINQUERYEXTPROC)          eglGetProcAddress( "glBeginQueryEXT" );
+     drv->EndQueryEXT            = (PFNGLENDQUERYEXTPROC)            eglGetProcAddress( "glEndQueryEXT" );
+     drv->GetQueryObjectuivEXT   = (PFNGLGETQUERYOBJECTUIVEXTPROC)   eglGetProcAddress( "glGetQueryObjectuivEXT" );
+     drv->GetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC) eglGetProcAddress( "glGetQueryObjectui64vEXT" );
+
+     if (!drv->GenQueriesEXT || !drv->DeleteQueriesEXT || !drv->BeginQueryEXT || !drv->EndQueryEXT ||
+         !drv->GetQueryObjectuivEXT || !drv->GetQueryObjectui64vEXT) {
+          D_ERROR( "GLES2/Stats: Failed to get timer query functions!\n" );
+          return;
+     }
+
+     for (i = 0; i < GLES2_TIMER_QUERIES; i++)
+          drv->GenQueriesEXT( 1, &stats->queries[i].obj );
+
+     /* Reset the disjoint state. */
+     glGetIntegerv( GL_GPU_DISJOINT_EXT, &disjoint );
+
+     stats->gpu_timing = true;
+}
+
+void
+gles2_stats_deinit( GLES2DriverData *drv,
+                    GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats = &dev->stats;
+     int              i;
+
+     D_DEBUG_AT( GLES2_Stats, "%s()\n", __FUNCTION__ );
+
+     if (!stats_timing( drv, dev )) {
+          /* Report the flushes timed before another thread called the driver. */
+          if (stats->fallback_profiler || stats->timed_flushes)
+               gles2_stats_dump( dev );
+
+          return;
+     }
+
+     /* Collect the outstanding results, waiting is fine at this point. */
+     stats_end_query( drv, dev );
+
+     glFinish();
+
+     stats_retire_queries( drv, dev );
+     stats_account_flush( stats );
+
+     gles2_stats_dump( dev );
+
+     for (i = 0; i < GLES2_TIMER_QUERIES; i++)
+          drv->DeleteQueriesEXT( 1, &stats->queries[i].obj );
+
+     stats->gpu_timing = false;
+}
+
+void
+gles2_stats_batch( GLES2DriverData *drv,
+                   GLES2DeviceData *dev,
+                   u32              surface_id )
+{
+     GLES2Statistics *stats = &dev->stats;
+     GLES2TimerQuery *query;
+
+     if (!stats_timing( drv, dev ))
+          return;
+
+     /* Keep timing the current batch as long as program and destination don't change. */
+     if (stats->query_active) {
+          query = &stats->queries[(stats->query_head - 1) % GLES2_TIMER_QUERIES];
+
+          if (query->prog_index == drv->context->prog_index && query->surface_id == surface_id)
+               return;
+
+          stats_end_query( drv, dev );
+     }
+
+     if (stats->query_head - stats->query_tail == GLES2_TIMER_QUERIES) {
+          stats_retire_queries( drv, dev );
+
+          /* Never stall, rather leave this batch untimed. */
+          if (stats->query_head - stats->query_tail == GLES2_TIMER_QUERIES) {
+               stats->queries_dropped++;
+               return;
+          }
+     }
+
+     query = &stats->queries[stats->query_head % GLES2_TIMER_QUERIES];
+
+     query->prog_index = drv->context->prog_index;
+     query->surface_id = surface_id;
+     query->flush      = stats->flushes;
+
+     drv->BeginQueryEXT( GL_TIME_ELAPSED_EXT, query->obj );
+
+     stats->query_head++;
+     stats->query_active = true;
+}
+
+void
+gles2_stats_flush( GLES2DriverData *drv,
+                   GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats = &dev->stats;
+
+     if (stats_timing( drv, dev )) {
+          /* The next primitive applies its state again, starting the query of the next batch, even if the state is
+             not modified. */
+          if (stats->query_active)
+               drv->reapply = true;
+
+          stats_end_query( drv, dev );
+          stats_retire_queries( drv, dev );
+     }
+
+     stats->flushes++;
+
+     if (stats->interval && !(stats->flushes % stats->interval))
+          gles2_stats_dump( dev );
+}
+
+void
+gles2_stats_fallback( GLES2DeviceData     *dev,
+                      CardState           *state,
+                      DFBAccelerationMask  accel,
+                      u32                  rejected )
+{
+     GLES2Statistics       *stats = &dev->stats;
+     GLES2Fallback         *fallback;
+     DFBSurfacePixelFormat  src_format;
+     DFBSurfacePixelFormat  dst_format;
+     unsigned int           i;
+
+     if (!stats->fallback_profiler)
+          return;
+
+     src_format = DFB_BLITTING_FUNCTION( accel ) && state->source ? state->source->config.format : DSPF_UNKNOWN;
+     dst_format = state->destination ? state->destination->config.format : DSPF_UNKNOWN;
+
+     for (i = 0; i < stats->num_fallbacks; i++) {
+          fallback = &stats->fallbacks[i];
+
+          if (fallback->accel == accel && fallback->rejected == rejected &&
+              fallback->src_format == src_format && fallback->dst_format == dst_format)
+               break;
+     }
+
+     if (i == stats->num_fallbacks) {
+          if (stats->num_fallbacks == GLES2_STATS_FALLBACKS) {
+               stats->fallbacks_dropped++;
+               return;
+          }
+
+          fallback = &stats->fallbacks[stats->num_fallbacks++];
+
+          fallback->accel      = accel;
+          fallback->rejected   = rejected;
+          fallback->src_format = src_format;
+          fallback->dst_format = dst_format;
+          fallback->count      = 0;
+          fallback->pixels     = 0;
+     }
+
+     fallback->count++;
+     fallback->pixels += (unsigned long long) (state->clip.x2 - state->clip.x1 + 1) *
+                         (state->clip.y2 - state->clip.y1 + 1);
+}
+
+void
+gles2_stats_culled( GLES2DeviceData *dev,
+                    const DFBRegion *region )
+{
+     GLES2Statistics *stats = &dev->stats;
+
+     stats->culled++;
+
+     if (region)
+          stats->culled_pixels += (unsigned long long) (region->x2 - region->x1 + 1) * (region->y2 - region->y1 + 1);
+}
+
+void
+gles2_stats_reordered( GLES2DeviceData *dev )
+{
+     dev->stats.reordered++;
+}
+
+void
+gles2_stats_dump( GLES2DeviceData *dev )
+{
+     GLES2Statistics *stats = &dev->stats;
+     unsigned int     i;
+
+     D_INFO( "GLES2/Stats: %u flushes, %u primitives culled by overdraw (%llu pixels), %u primitives reordered\n",
+             stats->flushes, stats->culled, stats->culled_pixels, stats->reordered );
+
+     if (stats->gpu_timing || stats->timed_flushes) {
+          D_INFO( "GLES2/Stats: GPU time %llu us in %u flushes (average %llu us, max %llu us), "
+                  "%u batches untimed, %u results disjoint\n",
+                  stats->total_flush_ns / 1000, stats->timed_flushes,
+                  stats->timed_flushes ? stats->total_flush_ns / stats->timed_flushes / 1000 : 0,
+                  stats->max_flush_ns / 1000, stats->queries_dropped, stats->queries_disjoint );
+
+          for (i = 0; i < NUM_PROGRAMS; i++) {
+               if (!stats->progs[i].batches)
+                    continue;
+
+               D_INFO( "GLES2/Stats:   program %-20s %8u batches %10llu us\n",
+                       dev->progs[i].name, stats->progs[i].batches, stats->progs[i].time_ns / 1000 );
+          }
+
+          for (i = 0; i < GLES2_STATS_SURFACES; i++) {
+               if (!stats->surfaces[i].counter.batches)
+                    continue;
+
+               D_INFO( "GLES2/Stats:   surface %-20u %8u batches %10llu us\n",
+                       stats->surfaces[i].surface_id, stats->surfaces[i].counter.batches,
+                       stats->surfaces[i].counter.time_ns / 1000 );
+          }
+     }
+
+     if (stats->fallback_profiler) {
+          GLES2Fallback fallbacks[GLES2_STATS_FALLBACKS];
+
+          D_INFO( "GLES2/Stats: %u software fallback paths (%u not recorded)\n",
+                  stats->num_fallbacks, stats->fallbacks_dropped );
+
+          /* Sort a copy, most frequent fallback first. */
+          memcpy( fallbacks, stats->fallbacks, stats->num_fallbacks * sizeof(GLES2Fallback) );
+
+          qsort( fallbacks, stats->num_fallbacks, sizeof(GLES2Fallback), stats_fallback_compare );
+
+          for (i = 0; i < stats->num_fallbacks; i++) {
+               D_INFO( "GLES2/Stats:   %-16s rejected 0x%08x %8s -> %-8s %8u checks %12llu pixels\n",
+                       stats_accel_name( fallbacks[i].accel ), fallbacks[i].rejected,
+                       fallbacks[i].src_format ? dfb_pixelformat_name( fallbacks[i].src_format ) : "-",
+                       dfb_pixelformat_name( fallbacks[i].dst_format ),
+                       fallbacks[i].count, fallbacks[i].pixels );
+          }
+     }
+}
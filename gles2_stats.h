@@ -0,0 +1,68 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_STATS_H__
+#define __GLES2_STATS_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+void gles2_stats_init    ( GLES2DriverData *drv,
+                           GLES2DeviceData *dev );
+
+void gles2_stats_deinit  ( GLES2DriverData *drv,
+                           GLES2DeviceData *dev );
+
+/*
+ * Called after the program and destination have been validated for the next primitive, (re)starts GPU timing of a
+ * batch.
+ */
+void gles2_stats_batch   ( GLES2DriverData *drv,
+                           GLES2DeviceData *dev,
+                           u32              surface_id );
+
+/*
+ * Called when pending commands are emitted, ends the current batch and counts a flush. The driver doesn't see
+ * flips, an operation may flush several times and several operations may be flushed at once.
+ */
+void gles2_stats_flush   ( GLES2DriverData *drv,
+                           GLES2DeviceData *dev );
+
+/*
+ * Called when CheckState() rejects a function, records the software fallback.
+ */
+void gles2_stats_fallback( GLES2DeviceData     *dev,
+                           CardState           *state,
+                           DFBAccelerationMask  accel,
+                           u32                  rejected );
+
+/*
+ * Called when a pending primitive is dropped because a later opaque primitive covers it.
+ */
+void gles2_stats_culled  ( GLES2DeviceData     *dev,
+                           const DFBRegion     *region );
+
+/*
+ * Called when a pending primitive is moved back to be drawn with the primitives of an earlier equal state.
+ */
+void gles2_stats_reordered( GLES2DeviceData     *dev );
+
+void gles2_stats_dump    ( GLES2DeviceData *dev );
+
+#endif
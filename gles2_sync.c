@@ -0,0 +1,205 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/gfxcard.h>
+
+#include "gles2_sync.h"
+
+D_DEBUG_DOMAIN( GLES2_Sync, "GLES2/Sync", "OpenGL ES 2.0 Synchronization" );
+
+/**********************************************************************************************************************/
+
+static inline bool
+serial_reached( const CoreGraphicsSerial *serial,
+                const CoreGraphicsSerial *reached )
+{
+     return serial->generation < reached->generation ||
+            (serial->generation == reached->generation && serial->serial <= reached->serial);
+}
+
+/*
+ * Mark the batches up to the n-th fence as completed and delete their fences.
+ */
+static void
+sync_retire( GLES2DriverData *drv,
+             unsigned int     n )
+{
+     unsigned int i;
+
+     drv->done = drv->fences[n-1].serial;
+
+     for (i = 0; i < n; i++)
+          drv->DestroySyncKHR( drv->display, drv->fences[i].sync );
+
+     drv->num_fences -= n;
+
+     memmove( &drv->fences[0], &drv->fences[n], drv->num_fences * sizeof(GLES2Fence) );
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_sync_init( GLES2DriverData *drv )
+{
+     const char *egl_extensions;
+     const char *gl_extensions;
+
+     D_DEBUG_AT( GLES2_Sync, "%s()\n", __FUNCTION__ );
+
+     /* Serial 0 is used by allocations not accessed yet. */
+     drv->serial.serial     = 1;
+     drv->serial.generation = 0;
+     drv->done.serial       = 0;
+     drv->done.generation   = 0;
+
+     drv->display = eglGetCurrentDisplay();
+
+     egl_extensions = eglQueryString( drv->display, EGL_EXTENSIONS );
+     gl_extensions  = (const char*) glGetString( GL_EXTENSIONS );
+
+     if (!egl_extensions || !strstr( egl_extensions, "EGL_KHR_fence_sync" ) ||
+         !gl_extensions  || !strstr( gl_extensions, "GL_OES_EGL_sync" )) {
+          D_INFO( "GLES2/Sync: EGL_KHR_fence_sync not supported, waiting for all commands to complete\n" );
+          return;
+     }
+
+     drv->CreateSyncKHR     = (PFNEGLCREATESYNCKHRPROC)     eglGetProcAddress( "eglCreateSyncKHR" );
+     drv->DestroySyncKHR    = (PFNEGLDESTROYSYNCKHRPROC)    eglGetProcAddress( "eglDestroySyncKHR" );
+     drv->ClientWaitSyncKHR = (PFNEGLCLIENTWAITSYNCKHRPROC) eglGetProcAddress( "eglClientWaitSyncKHR" );
+     drv->GetSyncAttribKHR  = (PFNEGLGETSYNCATTRIBKHRPROC)  eglGetProcAddress( "eglGetSyncAttribKHR" );
+
+     if (!drv->CreateSyncKHR || !drv->DestroySyncKHR || !drv->ClientWaitSyncKHR || !drv->GetSyncAttribKHR) {
+          D_ERROR( "GLES2/Sync: Failed to get fence sync functions!\n" );
+          drv->CreateSyncKHR = NULL;
+     }
+}
+
+void
+gles2_sync_deinit( GLES2DriverData *drv )
+{
+     D_DEBUG_AT( GLES2_Sync, "%s()\n", __FUNCTION__ );
+
+     if (drv->num_fences)
+          sync_retire( drv, drv->num_fences );
+}
+
+void
+gles2_sync_submit( GLES2DriverData *drv )
+{
+     EGLint       status;
+     unsigned int n;
+
+     if (!drv->serial_used)
+          return;
+
+     D_DEBUG_AT( GLES2_Sync, "%s( %u:%u )\n", __FUNCTION__, drv->serial.generation, drv->serial.serial );
+
+     if (drv->CreateSyncKHR) {
+          /* Retire signaled fences without waiting, they are signaled in order. */
+          for (n = 0; n < drv->num_fences; n++) {
+               if (!drv->GetSyncAttribKHR( drv->display, drv->fences[n].sync, EGL_SYNC_STATUS_KHR, &status ) ||
+                   status != EGL_SIGNALED_KHR)
+                    break;
+          }
+
+          if (n)
+               sync_retire( drv, n );
+
+          /* Without room, the batches of the oldest fence are covered by the next one. */
+          if (drv->num_fences == GLES2_FENCES) {
+               drv->DestroySyncKHR( drv->display, drv->fences[0].sync );
+
+               drv->num_fences--;
+
+               memmove( &drv->fences[0], &drv->fences[1], drv->num_fences * sizeof(GLES2Fence) );
+          }
+
+          drv->fences[drv->num_fences].sync = drv->CreateSyncKHR( drv->display, EGL_SYNC_FENCE_KHR, NULL );
+
+          if (drv->fences[drv->num_fences].sync != EGL_NO_SYNC_KHR) {
+               drv->fences[drv->num_fences].serial = drv->serial;
+               drv->num_fences++;
+          }
+          else
+               D_ERROR( "GLES2/Sync: Failed to create fence!\n" );
+     }
+
+     /* Start the next batch. */
+     if (!++drv->serial.serial)
+          drv->serial.generation++;
+
+     drv->serial_used = false;
+}
+
+void
+gles2_sync_get( GLES2DriverData    *drv,
+                CoreGraphicsSerial *serial )
+{
+     *serial = drv->serial;
+
+     drv->serial_used = true;
+}
+
+DFBResult
+gles2_sync_wait( GLES2DriverData          *drv,
+                 const CoreGraphicsSerial *serial )
+{
+     unsigned int n;
+
+     D_DEBUG_AT( GLES2_Sync, "%s( %u:%u ) <- done %u:%u\n", __FUNCTION__,
+                 serial->generation, serial->serial, drv->done.generation, drv->done.serial );
+
+     if (serial_reached( serial, &drv->done ))
+          return DFB_OK;
+
+     /* End the current batch, inserting a fence. */
+     if (serial_reached( &drv->serial, serial )) {
+          drv->serial_used = true;
+
+          gles2_sync_submit( drv );
+     }
+
+     /* Wait for the first fence of a batch not before the serial. */
+     for (n = 0; n < drv->num_fences; n++) {
+          if (serial_reached( serial, &drv->fences[n].serial ))
+               break;
+     }
+
+     if (n < drv->num_fences) {
+          if (drv->ClientWaitSyncKHR( drv->display, drv->fences[n].sync, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                                      EGL_FOREVER_KHR ) == EGL_CONDITION_SATISFIED_KHR) {
+               sync_retire( drv, n + 1 );
+               return DFB_OK;
+          }
+
+          D_ERROR( "GLES2/Sync: Failed to wait for fence!\n" );
+     }
+
+     /* No fence, wait for all commands. */
+     glFinish();
+
+     if (drv->num_fences)
+          sync_retire( drv, drv->num_fences );
+
+     drv->done = drv->serial;
+
+     if (!drv->done.serial--)
+          drv->done.generation--;
+
+     return DFB_OK;
+}
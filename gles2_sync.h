@@ -0,0 +1,52 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_SYNC_H__
+#define __GLES2_SYNC_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Batches are numbered by serials, a batch ends when the pending commands are emitted. Fences are only inserted
+ * after batches whose serial has been queried, i.e. that accessed a surface allocation.
+ */
+
+void      gles2_sync_init  ( GLES2DriverData          *drv );
+
+void      gles2_sync_deinit( GLES2DriverData          *drv );
+
+/*
+ * Called when the commands of the current batch have been issued, ends the batch.
+ */
+void      gles2_sync_submit( GLES2DriverData          *drv );
+
+/*
+ * Return the serial of the current batch.
+ */
+void      gles2_sync_get   ( GLES2DriverData          *drv,
+                             CoreGraphicsSerial       *serial );
+
+/*
+ * Wait until the batch with the serial has been completed, the current batch is ended if needed.
+ */
+DFBResult gles2_sync_wait  ( GLES2DriverData          *drv,
+                             const CoreGraphicsSerial *serial );
+
+#endif
@@ -0,0 +1,457 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/graphics_driver.h>
+#include <core/state.h>
+#include <direct/conf.h>
+
+#include "gles2_trace.h"
+
+D_DEBUG_DOMAIN( GLES2_Trace, "GLES2/Trace", "OpenGL ES 2.0 Trace Recorder" );
+
+/**********************************************************************************************************************/
+
+typedef struct {
+     GLES2TraceSurface       destination;
+     GLES2TraceSurface       source;
+     DFBRegion               clip;
+     DFBColor                color;
+     u32                     drawingflags;
+     u32                     blittingflags;
+     u32                     blend[2];
+     u32                     src_colorkey;
+     u32                     render_options;
+     s32                     matrix[9];
+     s32                     src_colormatrix[12];
+     DFBConvolutionFilter    src_convolution;
+} GLES2TraceState;
+
+struct __GLES2Trace {
+     FILE                *file;         /* trace file */
+     GraphicsDeviceFuncs  funcs;        /* device functions being traced */
+
+     GLES2TraceState      last;         /* state last recorded */
+     bool                 recorded;     /* a state has been recorded */
+
+     u32                 *surfaces;     /* surfaces whose contents have been recorded */
+     unsigned int         num_surfaces;
+     unsigned int         max_surfaces;
+};
+
+/**********************************************************************************************************************/
+
+static void
+trace_record( GLES2Trace           *trace,
+              GLES2TraceRecordType  type,
+              u32                   size )
+{
+     GLES2TraceRecord record;
+
+     record.type     = type;
+     record.reserved = 0;
+     record.size     = size;
+
+     fwrite( &record, sizeof(record), 1, trace->file );
+}
+
+static void
+trace_surface_ref( GLES2TraceSurface *ref,
+                   CoreSurface       *surface )
+{
+     ref->id     = surface->object.id;
+     ref->w      = surface->config.size.w;
+     ref->h      = surface->config.size.h;
+     ref->format = surface->config.format;
+}
+
+/*
+ * Record the contents of a source surface the first time it is used.
+ */
+static void
+trace_source_contents( GLES2Trace *trace,
+                       CardState  *state )
+{
+     GLES2TraceSurface  ref;
+     GLuint             tex = (GLuint)(long) state->src.handle;
+     GLint              fbo;
+     GLuint             read_fbo;
+     u8                *pixels;
+     unsigned int       i;
+
+     trace_surface_ref( &ref, state->source );
+
+     for (i = 0; i < trace->num_surfaces; i++) {
+          if (trace->surfaces[i] == ref.id)
+               return;
+     }
+
+     if (trace->num_surfaces == trace->max_surfaces) {
+          u32 *surfaces = D_REALLOC( trace->surfaces, (trace->max_surfaces + 32) * sizeof(u32) );
+          if (!surfaces) {
+               D_OOM();
+               return;
+          }
+
+          trace->surfaces      = surfaces;
+          trace->max_surfaces += 32;
+     }
+
+     trace->surfaces[trace->num_surfaces++] = ref.id;
+
+     pixels = D_MALLOC( ref.w * ref.h * 4 );
+     if (!pixels) {
+          D_OOM();
+          return;
+     }
+
+     /* Read back the texture through a temporary framebuffer object. */
+     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
+
+     glGenFramebuffers( 1, &read_fbo );
+     glBindFramebuffer( GL_FRAMEBUFFER, read_fbo );
+     glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0 );
+
+     if (glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE) {
+          glReadPixels( 0, 0, ref.w, ref.h, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+
+          trace_record( trace, GLES2TR_SURFACE, sizeof(ref) + ref.w * ref.h * 4 );
+          fwrite( &ref, sizeof(ref), 1, trace->file );
+          fwrite( pixels, ref.w * 4, ref.h, trace->file );
+     }
+     else
+          D_DEBUG_AT( GLES2_Trace, "  -> cannot read back surface %u\n", ref.id );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+     glDeleteFramebuffers( 1, &read_fbo );
+
+     D_FREE( pixels );
+}
+
+/**********************************************************************************************************************/
+
+static void
+traceSetState( void                *driver_data,
+               void                *device_data,
+               GraphicsDeviceFuncs *funcs,
+               CardState           *state,
+               DFBAccelerationMask  accel )
+{
+     GLES2DriverData    *drv   = driver_data;
+     GLES2Trace         *trace = drv->trace;
+     GLES2TraceState     cur;
+     GLES2TraceSetState  set;
+     u32                 size  = sizeof(set);
+
+     memset( &cur, 0, sizeof(cur) );
+
+     trace_surface_ref( &cur.destination, state->destination );
+
+     if (DFB_BLITTING_FUNCTION( accel )) {
+          trace_surface_ref( &cur.source, state->source );
+          trace_source_contents( trace, state );
+     }
+     else
+          cur.source = trace->last.source;
+
+     cur.clip           = state->clip;
+     cur.color          = state->color;
+     cur.drawingflags   = state->drawingflags;
+     cur.blittingflags  = state->blittingflags;
+     cur.blend[0]       = state->src_blend;
+     cur.blend[1]       = state->dst_blend;
+     cur.src_colorkey   = state->src_colorkey;
+     cur.render_options = state->render_options;
+
+     memcpy( cur.matrix, state->matrix, sizeof(cur.matrix) );
+     memcpy( cur.src_colormatrix, state->src_colormatrix, sizeof(cur.src_colormatrix) );
+
+     cur.src_convolution = state->src_convolution;
+
+     /* Record the fields that changed since the last call, the first call records all fields. */
+     set.accel  = accel;
+     set.mod_hw = state->mod_hw;
+     set.fields = GLES2TF_NONE;
+
+#define TRACE_FIELD(flag,field)                                                    \
+     do {                                                                          \
+          if (!trace->recorded ||                                                  \
+              memcmp( &cur.field, &trace->last.field, sizeof(cur.field) )) {       \
+               set.fields |= flag;                                                 \
+               size       += sizeof(cur.field);                                    \
+          }                                                                        \
+     } while (0)
+
+     TRACE_FIELD( GLES2TF_DESTINATION,    destination );
+     TRACE_FIELD( GLES2TF_SOURCE,         source );
+     TRACE_FIELD( GLES2TF_CLIP,           clip );
+     TRACE_FIELD( GLES2TF_COLOR,          color );
+     TRACE_FIELD( GLES2TF_DRAWINGFLAGS,   drawingflags );
+     TRACE_FIELD( GLES2TF_BLITTINGFLAGS,  blittingflags );
+     TRACE_FIELD( GLES2TF_BLEND,          blend );
+     TRACE_FIELD( GLES2TF_SRC_COLORKEY,   src_colorkey );
+     TRACE_FIELD( GLES2TF_RENDER_OPTIONS, render_options );
+     TRACE_FIELD( GLES2TF_MATRIX,         matrix );
+     TRACE_FIELD( GLES2TF_COLORMATRIX,    src_colormatrix );
+     TRACE_FIELD( GLES2TF_CONVOLUTION,    src_convolution );
+
+#undef TRACE_FIELD
+
+     trace_record( trace, GLES2TR_SETSTATE, size );
+     fwrite( &set, sizeof(set), 1, trace->file );
+
+#define TRACE_WRITE(flag,field)                                                    \
+     do {                                                                          \
+          if (set.fields & flag)                                                   \
+               fwrite( &cur.field, sizeof(cur.field), 1, trace->file );            \
+     } while (0)
+
+     TRACE_WRITE( GLES2TF_DESTINATION,    destination );
+     TRACE_WRITE( GLES2TF_SOURCE,         source );
+     TRACE_WRITE( GLES2TF_CLIP,           clip );
+     TRACE_WRITE( GLES2TF_COLOR,          color );
+     TRACE_WRITE( GLES2TF_DRAWINGFLAGS,   drawingflags );
+     TRACE_WRITE( GLES2TF_BLITTINGFLAGS,  blittingflags );
+     TRACE_WRITE( GLES2TF_BLEND,          blend );
+     TRACE_WRITE( GLES2TF_SRC_COLORKEY,   src_colorkey );
+     TRACE_WRITE( GLES2TF_RENDER_OPTIONS, render_options );
+     TRACE_WRITE( GLES2TF_MATRIX,         matrix );
+     TRACE_WRITE( GLES2TF_COLORMATRIX,    src_colormatrix );
+     TRACE_WRITE( GLES2TF_CONVOLUTION,    src_convolution );
+
+#undef TRACE_WRITE
+
+     trace->last     = cur;
+     trace->recorded = true;
+
+     trace->funcs.SetState( driver_data, device_data, funcs, state, accel );
+}
+
+static void
+traceEmitCommands( void *driver_data,
+                   void *device_data )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_EMITCOMMANDS, 0 );
+
+     fflush( trace->file );
+
+     trace->funcs.EmitCommands( driver_data, device_data );
+}
+
+static bool
+traceFillRectangle( void         *driver_data,
+                    void         *device_data,
+                    DFBRectangle *rect )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_FILLRECTANGLE, sizeof(DFBRectangle) );
+     fwrite( rect, sizeof(DFBRectangle), 1, trace->file );
+
+     return trace->funcs.FillRectangle( driver_data, device_data, rect );
+}
+
+static bool
+traceDrawRectangle( void         *driver_data,
+                    void         *device_data,
+                    DFBRectangle *rect )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_DRAWRECTANGLE, sizeof(DFBRectangle) );
+     fwrite( rect, sizeof(DFBRectangle), 1, trace->file );
+
+     return trace->funcs.DrawRectangle( driver_data, device_data, rect );
+}
+
+static bool
+traceDrawLine( void      *driver_data,
+               void      *device_data,
+               DFBRegion *line )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_DRAWLINE, sizeof(DFBRegion) );
+     fwrite( line, sizeof(DFBRegion), 1, trace->file );
+
+     return trace->funcs.DrawLine( driver_data, device_data, line );
+}
+
+static bool
+traceFillTriangle( void        *driver_data,
+                   void        *device_data,
+                   DFBTriangle *tri )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_FILLTRIANGLE, sizeof(DFBTriangle) );
+     fwrite( tri, sizeof(DFBTriangle), 1, trace->file );
+
+     return trace->funcs.FillTriangle( driver_data, device_data, tri );
+}
+
+static bool
+traceFillQuadrangles( void     *driver_data,
+                      void     *device_data,
+                      DFBPoint *points,
+                      int       num )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+     u32              n     = num;
+
+     trace_record( trace, GLES2TR_FILLQUADRANGLES, sizeof(u32) + num * 4 * sizeof(DFBPoint) );
+     fwrite( &n, sizeof(u32), 1, trace->file );
+     fwrite( points, sizeof(DFBPoint), num * 4, trace->file );
+
+     return trace->funcs.FillQuadrangles( driver_data, device_data, points, num );
+}
+
+static bool
+traceBlit( void         *driver_data,
+           void         *device_data,
+           DFBRectangle *rect,
+           int           dx,
+           int           dy )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+     DFBPoint         point = { dx, dy };
+
+     trace_record( trace, GLES2TR_BLIT, sizeof(DFBRectangle) + sizeof(DFBPoint) );
+     fwrite( rect, sizeof(DFBRectangle), 1, trace->file );
+     fwrite( &point, sizeof(DFBPoint), 1, trace->file );
+
+     return trace->funcs.Blit( driver_data, device_data, rect, dx, dy );
+}
+
+static bool
+traceStretchBlit( void         *driver_data,
+                  void         *device_data,
+                  DFBRectangle *srect,
+                  DFBRectangle *drect )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+
+     trace_record( trace, GLES2TR_STRETCHBLIT, 2 * sizeof(DFBRectangle) );
+     fwrite( srect, sizeof(DFBRectangle), 1, trace->file );
+     fwrite( drect, sizeof(DFBRectangle), 1, trace->file );
+
+     return trace->funcs.StretchBlit( driver_data, device_data, srect, drect );
+}
+
+static bool
+traceBatchBlit( void               *driver_data,
+                void               *device_data,
+                const DFBRectangle *rects,
+                const DFBPoint     *points,
+                unsigned int        num,
+                unsigned int       *ret_num )
+{
+     GLES2DriverData *drv   = driver_data;
+     GLES2Trace      *trace = drv->trace;
+     u32              n     = num;
+
+     trace_record( trace, GLES2TR_BATCHBLIT, sizeof(u32) + num * (sizeof(DFBRectangle) + sizeof(DFBPoint)) );
+     fwrite( &n, sizeof(u32), 1, trace->file );
+     fwrite( rects, sizeof(DFBRectangle), num, trace->file );
+     fwrite( points, sizeof(DFBPoint), num, trace->file );
+
+     return trace->funcs.BatchBlit( driver_data, device_data, rects, points, num, ret_num );
+}
+
+/**********************************************************************************************************************/
+
+void
+gles2_trace_init( GLES2DriverData     *drv,
+                  GraphicsDeviceFuncs *funcs )
+{
+     const char *filename;
+     GLES2Trace *trace;
+     u32         version = GLES2_TRACE_VERSION;
+
+     filename = direct_config_get_value( "gles2-trace" );
+     if (!filename)
+          return;
+
+     D_DEBUG_AT( GLES2_Trace, "%s( '%s' )\n", __FUNCTION__, filename );
+
+     trace = D_CALLOC( 1, sizeof(GLES2Trace) );
+     if (!trace) {
+          D_OOM();
+          return;
+     }
+
+     trace->file = fopen( filename, "wb" );
+     if (!trace->file) {
+          D_ERROR( "GLES2/Trace: Failed to open trace file '%s'!\n", filename );
+          D_FREE( trace );
+          return;
+     }
+
+     fwrite( GLES2_TRACE_MAGIC, 8, 1, trace->file );
+     fwrite( &version, sizeof(u32), 1, trace->file );
+
+     /* Record each call before passing it on to the driver. */
+     trace->funcs = *funcs;
+
+     funcs->SetState        = traceSetState;
+     funcs->EmitCommands    = traceEmitCommands;
+     funcs->FillRectangle   = traceFillRectangle;
+     funcs->DrawRectangle   = traceDrawRectangle;
+     funcs->DrawLine        = traceDrawLine;
+     funcs->FillTriangle    = traceFillTriangle;
+     funcs->FillQuadrangles = traceFillQuadrangles;
+     funcs->Blit            = traceBlit;
+     funcs->StretchBlit     = traceStretchBlit;
+     funcs->BatchBlit       = traceBatchBlit;
+
+     /* Not recorded, the rectangles are passed to FillRectangle() one by one. */
+     funcs->BatchFill       = NULL;
+
+     drv->trace = trace;
+
+     D_INFO( "GLES2/Trace: Recording to '%s'\n", filename );
+}
+
+void
+gles2_trace_deinit( GLES2DriverData *drv )
+{
+     GLES2Trace *trace = drv->trace;
+
+     if (!trace)
+          return;
+
+     D_DEBUG_AT( GLES2_Trace, "%s()\n", __FUNCTION__ );
+
+     fclose( trace->file );
+
+     if (trace->surfaces)
+          D_FREE( trace->surfaces );
+
+     D_FREE( trace );
+
+     drv->trace = NULL;
+}
@@ -0,0 +1,102 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_TRACE_H__
+#define __GLES2_TRACE_H__
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * Trace file format, all values are stored in host byte order.
+ *
+ * The file starts with the magic string and the version (u32), followed by records. Each record is a
+ * GLES2TraceRecord followed by 'size' bytes of payload, depending on the record type.
+ */
+
+#define GLES2_TRACE_MAGIC   "GLES2TRC"
+#define GLES2_TRACE_VERSION 2 /* version 2 added GLES2TR_FILLQUADRANGLES, traces of version 1 are replayed too */
+
+typedef enum {
+     GLES2TR_SURFACE         = 1,  /* GLES2TraceSurface followed by w * h RGBA pixels, contents on first use */
+     GLES2TR_SETSTATE        = 2,  /* GLES2TraceSetState followed by the fields that changed */
+     GLES2TR_FILLRECTANGLE   = 3,  /* DFBRectangle */
+     GLES2TR_DRAWRECTANGLE   = 4,  /* DFBRectangle */
+     GLES2TR_DRAWLINE        = 5,  /* DFBRegion */
+     GLES2TR_FILLTRIANGLE    = 6,  /* DFBTriangle */
+     GLES2TR_BLIT            = 7,  /* DFBRectangle, DFBPoint */
+     GLES2TR_STRETCHBLIT     = 8,  /* DFBRectangle (source), DFBRectangle (destination) */
+     GLES2TR_BATCHBLIT       = 9,  /* u32 num, num DFBRectangle, num DFBPoint */
+     GLES2TR_EMITCOMMANDS    = 10, /* no payload */
+     GLES2TR_FILLQUADRANGLES = 11, /* u32 num, 4 * num DFBPoint */
+     NUM_TRACE_RECORDS
+} GLES2TraceRecordType;
+
+typedef struct {
+     u16 type;     /* GLES2TraceRecordType */
+     u16 reserved;
+     u32 size;     /* size of the payload */
+} GLES2TraceRecord;
+
+typedef struct {
+     u32 id;       /* surface object id */
+     s32 w;        /* width */
+     s32 h;        /* height */
+     u32 format;   /* DFBSurfacePixelFormat */
+} GLES2TraceSurface;
+
+/*
+ * State fields, in the order in which they follow GLES2TraceSetState.
+ */
+typedef enum {
+     GLES2TF_NONE           = 0x00000000,
+
+     GLES2TF_DESTINATION    = 0x00000001, /* GLES2TraceSurface */
+     GLES2TF_SOURCE         = 0x00000002, /* GLES2TraceSurface */
+     GLES2TF_CLIP           = 0x00000004, /* DFBRegion */
+     GLES2TF_COLOR          = 0x00000008, /* DFBColor */
+     GLES2TF_DRAWINGFLAGS   = 0x00000010, /* u32 */
+     GLES2TF_BLITTINGFLAGS  = 0x00000020, /* u32 */
+     GLES2TF_BLEND          = 0x00000040, /* u32 src_blend, u32 dst_blend */
+     GLES2TF_SRC_COLORKEY   = 0x00000080, /* u32 */
+     GLES2TF_RENDER_OPTIONS = 0x00000100, /* u32 */
+     GLES2TF_MATRIX         = 0x00000200, /* s32[9] */
+     GLES2TF_COLORMATRIX    = 0x00000400, /* s32[12] */
+     GLES2TF_CONVOLUTION    = 0x00000800, /* DFBConvolutionFilter */
+
+     GLES2TF_ALL            = 0x00000FFF
+} GLES2TraceFields;
+
+typedef struct {
+     u32 accel;    /* DFBAccelerationMask passed to SetState() */
+     u32 mod_hw;   /* StateModificationFlags of the state */
+     u32 fields;   /* GLES2TraceFields that follow */
+} GLES2TraceSetState;
+
+/**********************************************************************************************************************/
+
+/*
+ * Hook the trace recorder into the device functions if a trace file is configured.
+ */
+void gles2_trace_init  ( GLES2DriverData     *drv,
+                         GraphicsDeviceFuncs *funcs );
+
+void gles2_trace_deinit( GLES2DriverData     *drv );
+
+#endif
@@ -0,0 +1,473 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <direct/clock.h>
+
+#include "gles2_harness.h"
+
+/*
+ * Benchmark the device functions on a headless context.
+ *
+ * Each test prints one JSON object per line, to allow tracking results across commits.
+ */
+
+/**********************************************************************************************************************/
+
+#define BENCH_CHUNK 64 /* operations between checking the time, emitted as one frame and waited for */
+
+typedef enum {
+     BENCH_FILLRECTANGLE,
+     BENCH_DRAWRECTANGLE,
+     BENCH_DRAWLINE,
+     BENCH_FILLTRIANGLE,
+     BENCH_BLIT,
+     BENCH_STRETCHBLIT,
+     BENCH_BATCHBLIT
+} BenchOp;
+
+typedef struct {
+     BenchOp              op;
+     int                  sw;   /* source width, or size of drawing */
+     int                  sh;   /* source height, or size of drawing */
+     int                  dw;   /* destination width for StretchBlit() */
+     int                  dh;   /* destination height for StretchBlit() */
+     unsigned int         num;  /* number of rectangles for BatchBlit() */
+} BenchTest;
+
+typedef struct {
+     GLES2Harness         harness;
+
+     GLES2HarnessSurface  destination;
+     GLES2HarnessSurface  source;
+
+     int                  width;      /* destination width */
+     int                  height;     /* destination height */
+     long long            duration;   /* duration of each test in microseconds */
+     const char          *filter;     /* only run tests whose name contains this string */
+
+     u32                  seed;       /* position generator */
+
+     DFBRectangle        *rects;      /* BatchBlit() source rectangles */
+     DFBPoint            *points;     /* BatchBlit() destination points */
+} Bench;
+
+static const char *op_names[] = {
+     [BENCH_FILLRECTANGLE] = "FillRectangle",
+     [BENCH_DRAWRECTANGLE] = "DrawRectangle",
+     [BENCH_DRAWLINE]      = "DrawLine",
+     [BENCH_FILLTRIANGLE]  = "FillTriangle",
+     [BENCH_BLIT]          = "Blit",
+     [BENCH_STRETCHBLIT]   = "StretchBlit",
+     [BENCH_BATCHBLIT]     = "BatchBlit"
+};
+
+static const BenchTest draw_tests[] = {
+     { BENCH_FILLRECTANGLE,   8,   8, 0, 0, 1 },
+     { BENCH_FILLRECTANGLE,  64,  64, 0, 0, 1 },
+     { BENCH_FILLRECTANGLE, 256, 256, 0, 0, 1 },
+     { BENCH_DRAWRECTANGLE,  64,  64, 0, 0, 1 },
+     { BENCH_DRAWRECTANGLE, 256, 256, 0, 0, 1 },
+     { BENCH_DRAWLINE,       64,  64, 0, 0, 1 },
+     { BENCH_DRAWLINE,      256, 256, 0, 0, 1 },
+     { BENCH_FILLTRIANGLE,   64,  64, 0, 0, 1 },
+     { BENCH_FILLTRIANGLE,  256, 256, 0, 0, 1 }
+};
+
+static const BenchTest blit_tests[] = {
+     { BENCH_BLIT,            8,   8,   0,   0,   1 },
+     { BENCH_BLIT,           64,  64,   0,   0,   1 },
+     { BENCH_BLIT,          256, 256,   0,   0,   1 },
+     { BENCH_STRETCHBLIT,    64,  64, 128, 128,   1 },
+     { BENCH_STRETCHBLIT,   256, 256, 128, 128,   1 },
+     { BENCH_STRETCHBLIT,   256, 256, 512, 384,   1 },
+     { BENCH_BATCHBLIT,      16,  16,   0,   0,  16 },
+     { BENCH_BATCHBLIT,      16,  16,   0,   0, 256 },
+     { BENCH_BATCHBLIT,      64,  64,   0,   0,  64 }
+};
+
+/* Blitting flags combined with each other, rotation and source filters are tested separately. */
+static const struct {
+     DFBSurfaceBlittingFlags  flag;
+     const char              *name;
+} blitting_flags[] = {
+     { DSBLIT_BLEND_ALPHACHANNEL, "BLEND_ALPHACHANNEL" },
+     { DSBLIT_BLEND_COLORALPHA,   "BLEND_COLORALPHA"   },
+     { DSBLIT_COLORIZE,           "COLORIZE"           },
+     { DSBLIT_SRC_COLORKEY,       "SRC_COLORKEY"       },
+     { DSBLIT_SRC_PREMULTIPLY,    "SRC_PREMULTIPLY"    },
+     { DSBLIT_SRC_PREMULTCOLOR,   "SRC_PREMULTCOLOR"   },
+     { DSBLIT_ROTATE90,           "ROTATE90"           },
+     { DSBLIT_ROTATE180,          "ROTATE180"          },
+     { DSBLIT_ROTATE270,          "ROTATE270"          },
+     { DSBLIT_SRC_COLORMATRIX,    "SRC_COLORMATRIX"    },
+     { DSBLIT_SRC_CONVOLUTION,    "SRC_CONVOLUTION"    }
+};
+
+#define NUM_COMBINED_FLAGS 6
+
+/* Sepia tone for SRC_COLORMATRIX, in 16.16 fixed point. */
+static const s32 sepia_colormatrix[12] = {
+     25756, 50397, 12386, 0,
+     22872, 44958, 11010, 0,
+     17826, 34996,  8585, 0
+};
+
+/* Gaussian blur for SRC_CONVOLUTION, scaled by 1/16. */
+static const DFBConvolutionFilter blur_convolution = {
+     { 0x10000, 0x20000, 0x10000,
+       0x20000, 0x40000, 0x20000,
+       0x10000, 0x20000, 0x10000 }, 0x1000, 0
+};
+
+/**********************************************************************************************************************/
+
+static inline int
+bench_random( Bench *bench,
+              int    range )
+{
+     bench->seed = bench->seed * 1103515245 + 12345;
+
+     return range > 0 ? (bench->seed >> 8) % range : 0;
+}
+
+static unsigned long
+bench_op( Bench           *bench,
+          const BenchTest *test )
+{
+     GLES2Harness *harness = &bench->harness;
+     void         *drv     = harness->driver_data;
+     void         *dev     = harness->device_data;
+     int           x       = bench_random( bench, bench->width  - test->sw );
+     int           y       = bench_random( bench, bench->height - test->sh );
+     unsigned int  i, ret_num;
+
+     switch (test->op) {
+          case BENCH_FILLRECTANGLE: {
+               DFBRectangle rect = { x, y, test->sw, test->sh };
+
+               harness->funcs.FillRectangle( drv, dev, &rect );
+
+               return test->sw * test->sh;
+          }
+
+          case BENCH_DRAWRECTANGLE: {
+               DFBRectangle rect = { x, y, test->sw, test->sh };
+
+               harness->funcs.DrawRectangle( drv, dev, &rect );
+
+               return 2 * (test->sw + test->sh);
+          }
+
+          case BENCH_DRAWLINE: {
+               DFBRegion line = { x, y, x + test->sw - 1, y + test->sh - 1 };
+
+               harness->funcs.DrawLine( drv, dev, &line );
+
+               return D_MAX( test->sw, test->sh );
+          }
+
+          case BENCH_FILLTRIANGLE: {
+               DFBTriangle tri = { x, y, x + test->sw - 1, y + test->sh / 2, x, y + test->sh - 1 };
+
+               harness->funcs.FillTriangle( drv, dev, &tri );
+
+               return test->sw * test->sh / 2;
+          }
+
+          case BENCH_BLIT: {
+               DFBRectangle rect = { 0, 0, test->sw, test->sh };
+
+               harness->funcs.Blit( drv, dev, &rect, x, y );
+
+               return test->sw * test->sh;
+          }
+
+          case BENCH_STRETCHBLIT: {
+               DFBRectangle srect = { 0, 0, test->sw, test->sh };
+               DFBRectangle drect = { bench_random( bench, bench->width  - test->dw ),
+                                      bench_random( bench, bench->height - test->dh ), test->dw, test->dh };
+
+               harness->funcs.StretchBlit( drv, dev, &srect, &drect );
+
+               return test->dw * test->dh;
+          }
+
+          case BENCH_BATCHBLIT:
+               for (i = 0; i < test->num; i++) {
+                    bench->rects[i].x  = bench_random( bench, bench->source.surface.config.size.w - test->sw );
+                    bench->rects[i].y  = bench_random( bench, bench->source.surface.config.size.h - test->sh );
+                    bench->rects[i].w  = test->sw;
+                    bench->rects[i].h  = test->sh;
+                    bench->points[i].x = bench_random( bench, bench->width  - test->sw );
+                    bench->points[i].y = bench_random( bench, bench->height - test->sh );
+               }
+
+               harness->funcs.BatchBlit( drv, dev, bench->rects, bench->points, test->num, &ret_num );
+
+               return test->num * test->sw * test->sh;
+     }
+
+     return 0;
+}
+
+static void
+bench_run( Bench           *bench,
+           const BenchTest *test,
+           const char      *flags )
+{
+     GLES2Harness        *harness = &bench->harness;
+     DFBAccelerationMask  accel;
+     char                 size[32];
+     unsigned long        ops     = 0;
+     unsigned long long   pixels  = 0;
+     long long            start, micros;
+     int                  i;
+
+     switch (test->op) {
+          case BENCH_FILLRECTANGLE: accel = DFXL_FILLRECTANGLE; break;
+          case BENCH_DRAWRECTANGLE: accel = DFXL_DRAWRECTANGLE; break;
+          case BENCH_DRAWLINE:      accel = DFXL_DRAWLINE;      break;
+          case BENCH_FILLTRIANGLE:  accel = DFXL_FILLTRIANGLE;  break;
+          case BENCH_STRETCHBLIT:   accel = DFXL_STRETCHBLIT;   break;
+          default:                  accel = DFXL_BLIT;          break;
+     }
+
+     if (test->op == BENCH_STRETCHBLIT)
+          snprintf( size, sizeof(size), "%dx%d-%dx%d", test->sw, test->sh, test->dw, test->dh );
+     else
+          snprintf( size, sizeof(size), "%dx%d", test->sw, test->sh );
+
+     if (bench->filter && !strstr( op_names[test->op], bench->filter ) && !strstr( flags, bench->filter ))
+          return;
+
+     if (!gles2_harness_acquire( harness, accel )) {
+          printf( "{\"test\":\"%s\",\"flags\":\"%s\",\"size\":\"%s\",\"num\":%u,\"accelerated\":false}\n",
+                  op_names[test->op], flags, size, test->num );
+          return;
+     }
+
+     /* Warm up, e.g. shader compilation on first use. */
+     bench_op( bench, test );
+     gles2_harness_sync( harness );
+
+     start = direct_clock_get_micros();
+
+     do {
+          for (i = 0; i < BENCH_CHUNK; i++)
+               pixels += bench_op( bench, test );
+
+          ops += BENCH_CHUNK;
+
+          /* Wait for rendering, otherwise only the time to queue the commands is measured. */
+          gles2_harness_sync( harness );
+     } while (direct_clock_get_micros() - start < bench->duration);
+
+     micros = direct_clock_get_micros() - start;
+
+     printf( "{\"test\":\"%s\",\"flags\":\"%s\",\"size\":\"%s\",\"num\":%u,\"accelerated\":true,"
+             "\"ops\":%lu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"mpixels_per_sec\":%.2f}\n",
+             op_names[test->op], flags, size, test->num,
+             ops, micros / 1000000.0, ops * 1000000.0 / micros, pixels / (double) micros );
+
+     fflush( stdout );
+}
+
+static void
+bench_blitting_flags( Bench                   *bench,
+                      DFBSurfaceBlittingFlags  flags )
+{
+     char         names[256];
+     unsigned int i;
+
+     names[0] = 0;
+
+     for (i = 0; i < D_ARRAY_SIZE(blitting_flags); i++) {
+          if (flags & blitting_flags[i].flag) {
+               if (names[0])
+                    strcat( names, "|" );
+
+               strcat( names, blitting_flags[i].name );
+          }
+     }
+
+     if (!names[0])
+          strcpy( names, "NOFX" );
+
+     bench->harness.state.blittingflags = flags;
+
+     gles2_harness_modified( &bench->harness, SMF_BLITTING_FLAGS );
+
+     for (i = 0; i < D_ARRAY_SIZE(blit_tests); i++)
+          bench_run( bench, &blit_tests[i], names );
+}
+
+/**********************************************************************************************************************/
+
+static DFBResult
+bench_init_surfaces( Bench *bench )
+{
+     DFBResult  ret;
+     u32       *pixels;
+     int        x, y;
+
+     ret = gles2_harness_surface_create( &bench->destination, 1, bench->width, bench->height, DSPF_ABGR, NULL );
+     if (ret)
+          return ret;
+
+     /* Source with an alpha gradient and a color key pattern. */
+     pixels = D_MALLOC( 512 * 512 * 4 );
+     if (!pixels)
+          return D_OOM();
+
+     for (y = 0; y < 512; y++) {
+          for (x = 0; x < 512; x++) {
+               if (((x >> 3) ^ (y >> 3)) & 1)
+                    pixels[y * 512 + x] = 0xff00ff00;
+               else
+                    pixels[y * 512 + x] = ((x / 2) << 24) | (y / 2) << 16 | (x / 2) << 8 | 0x40;
+          }
+     }
+
+     ret = gles2_harness_surface_create( &bench->source, 2, 512, 512, DSPF_ABGR, pixels );
+
+     D_FREE( pixels );
+
+     return ret;
+}
+
+static void
+print_usage( void )
+{
+     fprintf( stderr, "Usage: gles2_bench [-t <milliseconds per test>] [-s <width>x<height>] [<filter>]\n" );
+}
+
+int
+main( int   argc,
+      char *argv[] )
+{
+     DFBResult     ret;
+     Bench         bench;
+     CardState    *state;
+     unsigned int  i, num = 0;
+     int           n;
+
+     memset( &bench, 0, sizeof(bench) );
+
+     bench.width    = 1024;
+     bench.height   = 768;
+     bench.duration = 200000;
+     bench.seed     = 1;
+
+     ret = gles2_harness_init( &bench.harness, &argc, &argv );
+     if (ret)
+          return 1;
+
+     for (n = 1; n < argc; n++) {
+          if (!strcmp( argv[n], "-t" ) && n + 1 < argc)
+               bench.duration = atoi( argv[++n] ) * 1000LL;
+          else if (!strcmp( argv[n], "-s" ) && n + 1 < argc) {
+               if (sscanf( argv[++n], "%dx%d", &bench.width, &bench.height ) != 2)
+                    bench.width = 0;
+          }
+          else if (!bench.filter && argv[n][0] != '-')
+               bench.filter = argv[n];
+          else
+               bench.duration = 0;
+     }
+
+     if (bench.duration < 1 || bench.width < 256 || bench.height < 256) {
+          print_usage();
+          gles2_harness_deinit( &bench.harness );
+          return 1;
+     }
+
+     for (i = 0; i < D_ARRAY_SIZE(blit_tests); i++)
+          num = D_MAX( num, blit_tests[i].num );
+
+     bench.rects  = D_MALLOC( num * sizeof(DFBRectangle) );
+     bench.points = D_MALLOC( num * sizeof(DFBPoint) );
+     if (!bench.rects || !bench.points) {
+          D_OOM();
+          goto out;
+     }
+
+     ret = bench_init_surfaces( &bench );
+     if (ret)
+          goto out;
+
+     printf( "{\"renderer\":\"%s\",\"version\":\"%s\",\"destination\":\"%dx%d\",\"milliseconds\":%lld}\n",
+             glGetString( GL_RENDERER ), glGetString( GL_VERSION ), bench.width, bench.height,
+             bench.duration / 1000 );
+
+     state = &bench.harness.state;
+
+     gles2_harness_set_destination( &bench.harness, &bench.destination );
+     gles2_harness_set_source( &bench.harness, &bench.source );
+
+     state->color.a      = 0xc0;
+     state->color.r      = 0x40;
+     state->color.g      = 0x80;
+     state->color.b      = 0xc0;
+     state->src_colorkey = 0x0000ff00;
+
+     memcpy( state->src_colormatrix, sepia_colormatrix, sizeof(sepia_colormatrix) );
+
+     state->src_convolution = blur_convolution;
+
+     gles2_harness_modified( &bench.harness, SMF_COLOR | SMF_SRC_COLORKEY | SMF_SRC_COLORMATRIX | SMF_SRC_CONVOLUTION );
+
+     /* Drawing without and with blending. */
+     for (i = 0; i < D_ARRAY_SIZE(draw_tests); i++)
+          bench_run( &bench, &draw_tests[i], "NOFX" );
+
+     state->drawingflags = DSDRAW_BLEND;
+
+     gles2_harness_modified( &bench.harness, SMF_DRAWING_FLAGS );
+
+     for (i = 0; i < D_ARRAY_SIZE(draw_tests); i++)
+          bench_run( &bench, &draw_tests[i], "BLEND" );
+
+     /* Blitting with each combination of flags, then each rotation. */
+     for (i = 0; i < 1 << NUM_COMBINED_FLAGS; i++) {
+          DFBSurfaceBlittingFlags flags = DSBLIT_NOFX;
+
+          for (n = 0; n < NUM_COMBINED_FLAGS; n++) {
+               if (i & (1 << n))
+                    flags |= blitting_flags[n].flag;
+          }
+
+          bench_blitting_flags( &bench, flags );
+     }
+
+     for (i = NUM_COMBINED_FLAGS; i < D_ARRAY_SIZE(blitting_flags); i++)
+          bench_blitting_flags( &bench, blitting_flags[i].flag );
+
+     gles2_harness_surface_destroy( &bench.source );
+     gles2_harness_surface_destroy( &bench.destination );
+
+out:
+     if (bench.points)
+          D_FREE( bench.points );
+
+     if (bench.rects)
+          D_FREE( bench.rects );
+
+     gles2_harness_deinit( &bench.harness );
+
+     return ret ? 1 : 0;
+}
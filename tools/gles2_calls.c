@@ -0,0 +1,1057 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <stdarg.h>
+
+#include <direct/serial.h>
+
+#include "gles2_harness.h"
+
+/*
+ * Count the GL calls issued by the driver for typical frame sequences.
+ *
+ * The GL functions used by the driver for rendering are defined here, they take precedence over the ones of the GL
+ * library for the driver built into this tool. Each call is counted (and optionally printed with its arguments) before
+ * being forwarded to the GL library. One JSON object is printed per scenario, to allow comparing results across
+ * commits. Entry points of OpenGL ES 3.0 queried with eglGetProcAddress() are counted by returning the functions
+ * defined here. The counts are compared with the expected ones, some scenarios also check the rendering and the driver
+ * state, the tool exits with 1 if a check fails.
+ */
+
+/**********************************************************************************************************************/
+
+typedef enum {
+     CALL_glBindSampler,
+     CALL_glBindTexture,
+     CALL_glBindVertexArray,
+     CALL_glBlendFunc,
+     CALL_glClear,
+     CALL_glClearColor,
+     CALL_glDisable,
+     CALL_glDisableVertexAttribArray,
+     CALL_glDrawArrays,
+     CALL_glDrawArraysInstanced,
+     CALL_glEnable,
+     CALL_glEnableVertexAttribArray,
+     CALL_glGetIntegerv,
+     CALL_glMapBufferRange,
+     CALL_glScissor,
+     CALL_glTexParameterf,
+     CALL_glUnmapBuffer,
+     CALL_glUniform2f,
+     CALL_glUniform3f,
+     CALL_glUniform3i,
+     CALL_glUniform4f,
+     CALL_glUniformMatrix3fv,
+     CALL_glUseProgram,
+     CALL_glVertexAttrib2f,
+     CALL_glVertexAttrib4f,
+     CALL_glVertexAttribPointer,
+     CALL_glViewport,
+     NUM_CALLS
+} CallIndex;
+
+static const char *call_names[NUM_CALLS] = {
+     [CALL_glBindSampler]              = "glBindSampler",
+     [CALL_glBindTexture]              = "glBindTexture",
+     [CALL_glBindVertexArray]          = "glBindVertexArray",
+     [CALL_glBlendFunc]                = "glBlendFunc",
+     [CALL_glClear]                    = "glClear",
+     [CALL_glClearColor]               = "glClearColor",
+     [CALL_glDisable]                  = "glDisable",
+     [CALL_glDisableVertexAttribArray] = "glDisableVertexAttribArray",
+     [CALL_glDrawArrays]               = "glDrawArrays",
+     [CALL_glDrawArraysInstanced]      = "glDrawArraysInstanced",
+     [CALL_glEnable]                   = "glEnable",
+     [CALL_glEnableVertexAttribArray]  = "glEnableVertexAttribArray",
+     [CALL_glGetIntegerv]              = "glGetIntegerv",
+     [CALL_glMapBufferRange]           = "glMapBufferRange",
+     [CALL_glScissor]                  = "glScissor",
+     [CALL_glTexParameterf]            = "glTexParameterf",
+     [CALL_glUnmapBuffer]              = "glUnmapBuffer",
+     [CALL_glUniform2f]                = "glUniform2f",
+     [CALL_glUniform3f]                = "glUniform3f",
+     [CALL_glUniform3i]                = "glUniform3i",
+     [CALL_glUniform4f]                = "glUniform4f",
+     [CALL_glUniformMatrix3fv]         = "glUniformMatrix3fv",
+     [CALL_glUseProgram]               = "glUseProgram",
+     [CALL_glVertexAttrib2f]           = "glVertexAttrib2f",
+     [CALL_glVertexAttrib4f]           = "glVertexAttrib4f",
+     [CALL_glVertexAttribPointer]      = "glVertexAttribPointer",
+     [CALL_glViewport]                 = "glViewport"
+};
+
+static unsigned long calls[NUM_CALLS];
+static bool          recording;  /* count calls issued by the driver only, not the ones of the harness */
+static bool          verbose;
+
+/*
+ * Define a GL function counting and optionally printing the call, then forwarding it to the GL library.
+ */
+#define GL_FORWARD(name,params,args,...)                                           \
+     void GL_APIENTRY                                                              \
+     name params                                                                   \
+     {                                                                             \
+          static void (GL_APIENTRY *real) params;                                  \
+                                                                                   \
+          if (!real)                                                               \
+               real = dlsym( RTLD_NEXT, #name );                                   \
+                                                                                   \
+          if (recording) {                                                         \
+               calls[CALL_##name]++;                                               \
+                                                                                   \
+               if (verbose)                                                        \
+                    printf( "  " #name "( " __VA_ARGS__ );                         \
+          }                                                                        \
+                                                                                   \
+          real args;                                                               \
+     }
+
+/*
+ * Same for a GL function returning a value.
+ */
+#define GL_FORWARD_RETURN(type,name,params,args,...)                               \
+     type GL_APIENTRY                                                              \
+     name params                                                                   \
+     {                                                                             \
+          static type (GL_APIENTRY *real) params;                                  \
+                                                                                   \
+          if (!real)                                                               \
+               real = dlsym( RTLD_NEXT, #name );                                   \
+                                                                                   \
+          if (recording) {                                                         \
+               calls[CALL_##name]++;                                               \
+                                                                                   \
+               if (verbose)                                                        \
+                    printf( "  " #name "( " __VA_ARGS__ );                         \
+          }                                                                        \
+                                                                                   \
+          return real args;                                                        \
+     }
+
+GL_FORWARD( glBindSampler,
+            (GLuint unit, GLuint sampler),
+            (unit, sampler),
+            "%u, %u )\n", unit, sampler )
+
+GL_FORWARD( glBindTexture,
+            (GLenum target, GLuint texture),
+            (target, texture),
+            "0x%04x, %u )\n", target, texture )
+
+GL_FORWARD( glBindVertexArray,
+            (GLuint array),
+            (array),
+            "%u )\n", array )
+
+GL_FORWARD( glBlendFunc,
+            (GLenum sfactor, GLenum dfactor),
+            (sfactor, dfactor),
+            "0x%04x, 0x%04x )\n", sfactor, dfactor )
+
+GL_FORWARD( glClear,
+            (GLbitfield mask),
+            (mask),
+            "0x%04x )\n", mask )
+
+GL_FORWARD( glClearColor,
+            (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha),
+            (red, green, blue, alpha),
+            "%g, %g, %g, %g )\n", red, green, blue, alpha )
+
+GL_FORWARD( glDisable,
+            (GLenum cap),
+            (cap),
+            "0x%04x )\n", cap )
+
+GL_FORWARD( glDisableVertexAttribArray,
+            (GLuint index),
+            (index),
+            "%u )\n", index )
+
+GL_FORWARD( glDrawArrays,
+            (GLenum mode, GLint first, GLsizei count),
+            (mode, first, count),
+            "0x%04x, %d, %d )\n", mode, first, count )
+
+GL_FORWARD( glDrawArraysInstanced,
+            (GLenum mode, GLint first, GLsizei count, GLsizei instancecount),
+            (mode, first, count, instancecount),
+            "0x%04x, %d, %d, %d )\n", mode, first, count, instancecount )
+
+GL_FORWARD( glEnable,
+            (GLenum cap),
+            (cap),
+            "0x%04x )\n", cap )
+
+GL_FORWARD( glEnableVertexAttribArray,
+            (GLuint index),
+            (index),
+            "%u )\n", index )
+
+GL_FORWARD( glGetIntegerv,
+            (GLenum pname, GLint *data),
+            (pname, data),
+            "0x%04x )\n", pname )
+
+GL_FORWARD_RETURN( void*, glMapBufferRange,
+                   (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),
+                   (target, offset, length, access),
+                   "0x%04x, %ld, %ld, 0x%04x )\n", target, (long) offset, (long) length, access )
+
+GL_FORWARD( glScissor,
+            (GLint x, GLint y, GLsizei width, GLsizei height),
+            (x, y, width, height),
+            "%d, %d, %d, %d )\n", x, y, width, height )
+
+GL_FORWARD( glTexParameterf,
+            (GLenum target, GLenum pname, GLfloat param),
+            (target, pname, param),
+            "0x%04x, 0x%04x, %g )\n", target, pname, param )
+
+GL_FORWARD_RETURN( GLboolean, glUnmapBuffer,
+                   (GLenum target),
+                   (target),
+                   "0x%04x )\n", target )
+
+GL_FORWARD( glUniform2f,
+            (GLint location, GLfloat v0, GLfloat v1),
+            (location, v0, v1),
+            "%d, %g, %g )\n", location, v0, v1 )
+
+GL_FORWARD( glUniform3f,
+            (GLint location, GLfloat v0, GLfloat v1, GLfloat v2),
+            (location, v0, v1, v2),
+            "%d, %g, %g, %g )\n", location, v0, v1, v2 )
+
+GL_FORWARD( glUniform3i,
+            (GLint location, GLint v0, GLint v1, GLint v2),
+            (location, v0, v1, v2),
+            "%d, %d, %d, %d )\n", location, v0, v1, v2 )
+
+GL_FORWARD( glUniform4f,
+            (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3),
+            (location, v0, v1, v2, v3),
+            "%d, %g, %g, %g, %g )\n", location, v0, v1, v2, v3 )
+
+GL_FORWARD( glUniformMatrix3fv,
+            (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value),
+            (location, count, transpose, value),
+            "%d, %d, %d, [%g %g %g %g %g %g %g %g %g] )\n", location, count, transpose,
+            value[0], value[1], value[2], value[3], value[4], value[5], value[6], value[7], value[8] )
+
+GL_FORWARD( glUseProgram,
+            (GLuint program),
+            (program),
+            "%u )\n", program )
+
+GL_FORWARD( glVertexAttrib2f,
+            (GLuint index, GLfloat x, GLfloat y),
+            (index, x, y),
+            "%u, %g, %g )\n", index, x, y )
+
+GL_FORWARD( glVertexAttrib4f,
+            (GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w),
+            (index, x, y, z, w),
+            "%u, %g, %g, %g, %g )\n", index, x, y, z, w )
+
+GL_FORWARD( glVertexAttribPointer,
+            (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer),
+            (index, size, type, normalized, stride, pointer),
+            "%u, %d, 0x%04x, %d, %d )\n", index, size, type, normalized, stride )
+
+GL_FORWARD( glViewport,
+            (GLint x, GLint y, GLsizei width, GLsizei height),
+            (x, y, width, height),
+            "%d, %d, %d, %d )\n", x, y, width, height )
+
+static const struct {
+     const char                              *name;
+     __eglMustCastToProperFunctionPointerType func;
+} entry_points[] = {
+     { "glBindSampler",         (__eglMustCastToProperFunctionPointerType) glBindSampler         },
+     { "glBindVertexArray",     (__eglMustCastToProperFunctionPointerType) glBindVertexArray     },
+     { "glDrawArraysInstanced", (__eglMustCastToProperFunctionPointerType) glDrawArraysInstanced },
+     { "glMapBufferRange",      (__eglMustCastToProperFunctionPointerType) glMapBufferRange      },
+     { "glUnmapBuffer",         (__eglMustCastToProperFunctionPointerType) glUnmapBuffer         }
+};
+
+__eglMustCastToProperFunctionPointerType EGLAPIENTRY
+eglGetProcAddress( const char *procname )
+{
+     static __eglMustCastToProperFunctionPointerType (EGLAPIENTRY *real)( const char *procname );
+     unsigned int                                    i;
+
+     if (!real)
+          real = dlsym( RTLD_NEXT, "eglGetProcAddress" );
+
+     for (i = 0; i < D_ARRAY_SIZE(entry_points); i++) {
+          if (!strcmp( procname, entry_points[i].name ))
+               return entry_points[i].func;
+     }
+
+     return real( procname );
+}
+
+/**********************************************************************************************************************/
+
+#define NUM_ICONS 64
+
+typedef struct {
+     GLES2Harness         harness;
+
+     GLES2HarnessSurface  destination[2];
+     GLES2HarnessSurface  source;
+     GLES2HarnessSurface  icons[NUM_ICONS]; /* small sources copied into atlas pages */
+
+     unsigned long        ops;      /* drawing operations of the scenario */
+     unsigned int         failed;   /* failed checks */
+} Calls;
+
+static void
+calls_check( Calls      *c,
+             bool        ok,
+             const char *format,
+             ... )
+{
+     va_list args;
+
+     if (ok)
+          return;
+
+     va_start( args, format );
+
+     fprintf( stderr, "gles2_calls: " );
+     vfprintf( stderr, format, args );
+     fprintf( stderr, "\n" );
+
+     va_end( args );
+
+     c->failed++;
+}
+
+/*
+ * Read a pixel of the first destination, after the engine has been synchronized.
+ */
+static u32
+calls_pixel( Calls *c,
+             int    x,
+             int    y )
+{
+     u32 pixel;
+
+     glBindFramebuffer( GL_FRAMEBUFFER, c->destination[0].fbo );
+     glReadPixels( x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixel );
+
+     return pixel;
+}
+
+/*
+ * Color of an icon, in the byte order of the textures.
+ */
+static u32
+calls_icon_color( unsigned int icon,
+                  unsigned int version )
+{
+     return 0xff000000 | (icon * 4) << 16 | (version * 0x40) << 8 | (0xff - icon * 4);
+}
+
+static void
+calls_fill( Calls *c,
+            int    x,
+            int    y )
+{
+     DFBRectangle rect = { x, y, 32, 32 };
+
+     if (gles2_harness_acquire( &c->harness, DFXL_FILLRECTANGLE ))
+          c->harness.funcs.FillRectangle( c->harness.driver_data, c->harness.device_data, &rect );
+
+     c->ops++;
+}
+
+static void
+calls_blit( Calls *c,
+            int    x,
+            int    y )
+{
+     DFBRectangle rect = { 0, 0, 32, 32 };
+
+     if (gles2_harness_acquire( &c->harness, DFXL_BLIT ))
+          c->harness.funcs.Blit( c->harness.driver_data, c->harness.device_data, &rect, x, y );
+
+     c->ops++;
+}
+
+/*
+ * Entry of an icon in the atlas, NULL if there is none.
+ */
+static const GLES2AtlasEntry *
+calls_atlas_entry( Calls        *c,
+                   unsigned int  icon )
+{
+     GLES2DriverData *drv = c->harness.driver_data;
+     unsigned int     i;
+
+     for (i = 0; i < GLES2_ATLAS_ENTRIES; i++) {
+          if (drv->atlas.entries[i].tex == c->icons[icon].tex)
+               return &drv->atlas.entries[i];
+     }
+
+     return NULL;
+}
+
+static void
+calls_icon( Calls        *c,
+            unsigned int  icon )
+{
+     DFBRectangle rect = { 0, 0, 16, 16 };
+
+     gles2_harness_set_source( &c->harness, &c->icons[icon] );
+
+     if (gles2_harness_acquire( &c->harness, DFXL_BLIT ))
+          c->harness.funcs.Blit( c->harness.driver_data, c->harness.device_data, &rect,
+                                 (icon % 32) * 16, 64 + (icon / 32) * 16 );
+
+     c->ops++;
+}
+
+static void
+calls_color( Calls *c,
+             u8     a,
+             u8     r,
+             u8     g,
+             u8     b )
+{
+     c->harness.state.color.a = a;
+     c->harness.state.color.r = r;
+     c->harness.state.color.g = g;
+     c->harness.state.color.b = b;
+
+     gles2_harness_modified( &c->harness, SMF_COLOR );
+}
+
+static void
+calls_blittingflags( Calls                   *c,
+                     DFBSurfaceBlittingFlags  flags )
+{
+     c->harness.state.blittingflags = flags;
+
+     gles2_harness_modified( &c->harness, SMF_BLITTING_FLAGS );
+}
+
+static void
+calls_drawingflags( Calls                  *c,
+                    DFBSurfaceDrawingFlags  flags )
+{
+     c->harness.state.drawingflags = flags;
+
+     gles2_harness_modified( &c->harness, SMF_DRAWING_FLAGS );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Scenarios, each one is one frame.
+ */
+
+static void
+scenario_fill_same_state( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 100; i++)
+          calls_fill( c, i, i );
+}
+
+static void
+scenario_frame( Calls *c )
+{
+     CoreSurfaceConfig *config = &c->destination[0].surface.config;
+     DFBRectangle       rect   = { 0, 0, config->size.w, config->size.h };
+     int                i;
+
+     /* Background, then opaque panels. */
+     calls_color( c, 0xff, 0x20, 0x20, 0x20 );
+
+     if (gles2_harness_acquire( &c->harness, DFXL_FILLRECTANGLE ))
+          c->harness.funcs.FillRectangle( c->harness.driver_data, c->harness.device_data, &rect );
+
+     c->ops++;
+
+     for (i = 0; i < 10; i++) {
+          calls_color( c, 0xff, 0x40, 0x40, i * 20 );
+          calls_fill( c, i * 40, 20 );
+     }
+
+     calls_color( c, 0xff, 0xff, 0xff, 0xff );
+}
+
+static void
+scenario_fill_color_change( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 100; i++) {
+          calls_color( c, 0xff, i, 0, 0 );
+          calls_fill( c, i, i );
+     }
+}
+
+static void
+scenario_fill_blend_toggle( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 100; i++) {
+          calls_drawingflags( c, (i & 1) ? DSDRAW_BLEND : DSDRAW_NOFX );
+          calls_fill( c, i, i );
+     }
+
+     calls_drawingflags( c, DSDRAW_NOFX );
+}
+
+static void
+scenario_blit_same_state( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 100; i++)
+          calls_blit( c, i, i );
+}
+
+static void
+scenario_blit_blend( Calls *c )
+{
+     int i;
+
+     calls_blittingflags( c, DSBLIT_BLEND_ALPHACHANNEL );
+
+     for (i = 0; i < 100; i++)
+          calls_blit( c, i, i );
+
+     calls_blittingflags( c, DSBLIT_NOFX );
+}
+
+static void
+scenario_blit_flags_toggle( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 100; i++) {
+          calls_blittingflags( c, (i & 1) ? DSBLIT_BLEND_ALPHACHANNEL : DSBLIT_SRC_COLORKEY );
+          calls_blit( c, i, i );
+     }
+
+     calls_blittingflags( c, DSBLIT_NOFX );
+}
+
+static void
+scenario_fill_blit_mix( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 50; i++) {
+          calls_fill( c, i, i );
+          calls_blit( c, i, i );
+     }
+}
+
+static void
+scenario_glyphs( Calls *c )
+{
+     DFBRectangle rects[64];
+     DFBPoint     points[64];
+     unsigned int i, n, ret_num;
+
+     for (i = 0; i < 64; i++) {
+          rects[i].x  = (i % 8) * 16;
+          rects[i].y  = (i / 8) * 16;
+          rects[i].w  = 16;
+          rects[i].h  = 16;
+          points[i].x = i * 8;
+          points[i].y = 100;
+     }
+
+     /* Text strings in different colors, as rendered by DirectFB. */
+     calls_blittingflags( c, DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_COLORIZE );
+
+     for (n = 0; n < 10; n++) {
+          calls_color( c, 0xff, n * 20, 0xff, 0 );
+
+          if (gles2_harness_acquire( &c->harness, DFXL_BLIT ))
+               c->harness.funcs.BatchBlit( c->harness.driver_data, c->harness.device_data,
+                                           rects, points, 64, &ret_num );
+
+          c->ops++;
+     }
+
+     calls_blittingflags( c, DSBLIT_NOFX );
+     calls_color( c, 0xff, 0xff, 0xff, 0xff );
+}
+
+static void
+scenario_stretchblit( Calls *c )
+{
+     DFBRectangle srect = { 0, 0, 64, 64 };
+     DFBRectangle drect = { 0, 0, 128, 96 };
+     int          i;
+
+     for (i = 0; i < 50; i++) {
+          drect.x = i;
+
+          if (gles2_harness_acquire( &c->harness, DFXL_STRETCHBLIT ))
+               c->harness.funcs.StretchBlit( c->harness.driver_data, c->harness.device_data, &srect, &drect );
+
+          c->ops++;
+     }
+}
+
+static void
+scenario_destination_switch( Calls *c )
+{
+     int i;
+
+     for (i = 0; i < 20; i++) {
+          gles2_harness_set_destination( &c->harness, &c->destination[i & 1] );
+          calls_fill( c, i, i );
+     }
+
+     gles2_harness_set_destination( &c->harness, &c->destination[0] );
+}
+
+#define LIST_ROWS 8
+
+/*
+ * Draw the rows of a list view, each one with a background, a line of text and an icon, then a line through the text of
+ * the third row, ending each operation like DirectFB core does.
+ */
+static void
+calls_list( Calls *c )
+{
+     DFBRectangle icon = { 0, 0, 16, 16 };
+     DFBRectangle line = { 16, 250, 120, 4 };
+     unsigned int i, n;
+
+     for (n = 0; n < LIST_ROWS; n++) {
+          DFBRectangle background = { 0, 200 + n * 20, 200, 20 };
+
+          calls_color( c, 0xff, 0x30, 0x30, 0x30 );
+
+          if (gles2_harness_acquire( &c->harness, DFXL_FILLRECTANGLE ))
+               c->harness.funcs.FillRectangle( c->harness.driver_data, c->harness.device_data, &background );
+
+          c->harness.funcs.EmitCommands( c->harness.driver_data, c->harness.device_data );
+
+          /* Glyphs of the text, BatchBlit() is not queued. */
+          calls_color( c, 0xff, 0xff, 0xff, 0x80 );
+          calls_blittingflags( c, DSBLIT_COLORIZE );
+          gles2_harness_set_source( &c->harness, &c->source );
+
+          for (i = 0; i < 8; i++) {
+               DFBRectangle glyph = { i * 16, n * 16, 12, 16 };
+
+               if (gles2_harness_acquire( &c->harness, DFXL_BLIT ))
+                    c->harness.funcs.Blit( c->harness.driver_data, c->harness.device_data, &glyph,
+                                           20 + i * 12, 202 + n * 20 );
+          }
+
+          c->harness.funcs.EmitCommands( c->harness.driver_data, c->harness.device_data );
+
+          /* Icon from another source. */
+          calls_blittingflags( c, DSBLIT_NOFX );
+          gles2_harness_set_source( &c->harness, &c->destination[1] );
+
+          if (gles2_harness_acquire( &c->harness, DFXL_BLIT ))
+               c->harness.funcs.Blit( c->harness.driver_data, c->harness.device_data, &icon, 180, 202 + n * 20 );
+
+          c->harness.funcs.EmitCommands( c->harness.driver_data, c->harness.device_data );
+
+          c->ops += 3;
+     }
+
+     /* Line through the text of a row, it must stay after the glyphs. */
+     calls_color( c, 0xff, 0x30, 0x30, 0x30 );
+
+     if (gles2_harness_acquire( &c->harness, DFXL_FILLRECTANGLE ))
+          c->harness.funcs.FillRectangle( c->harness.driver_data, c->harness.device_data, &line );
+
+     c->harness.funcs.EmitCommands( c->harness.driver_data, c->harness.device_data );
+
+     c->ops++;
+
+     gles2_harness_set_source( &c->harness, &c->source );
+     calls_color( c, 0xff, 0xff, 0xff, 0xff );
+}
+
+/*
+ * Rows of a list view, the primitives of each kind are drawn together without a change of the result.
+ */
+static void
+scenario_list( Calls *c )
+{
+     GLES2DriverData *drv       = c->harness.driver_data;
+     GLES2DeviceData *dev       = c->harness.device_data;
+     bool             reorder   = drv->reorder;
+     unsigned int     reordered = dev->stats.reordered;
+     u32             *expected, *pixels;
+
+     expected = D_MALLOC( 200 * LIST_ROWS * 20 * 4 );
+     pixels   = D_MALLOC( 200 * LIST_ROWS * 20 * 4 );
+
+     /* Reference in submission order, not counted. */
+     recording    = false;
+     drv->reorder = false;
+
+     calls_list( c );
+
+     gles2_harness_sync( &c->harness );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, c->destination[0].fbo );
+     glReadPixels( 0, 200, 200, LIST_ROWS * 20, GL_RGBA, GL_UNSIGNED_BYTE, expected );
+
+     recording    = true;
+     drv->reorder = reorder;
+     c->ops       = 0;
+
+     calls_list( c );
+
+     gles2_harness_sync( &c->harness );
+
+     glBindFramebuffer( GL_FRAMEBUFFER, c->destination[0].fbo );
+     glReadPixels( 0, 200, 200, LIST_ROWS * 20, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+
+     calls_check( c, !memcmp( pixels, expected, 200 * LIST_ROWS * 20 * 4 ),
+                  "list: result differs from submission order" );
+
+     /* The background, the glyphs and the icon of each row but the first one are moved back to the first row, the line
+        is drawn last. */
+     if (reorder) {
+          calls_check( c, dev->stats.reordered - reordered == (LIST_ROWS - 1) * 10,
+                       "list: %u primitives reordered instead of %u", dev->stats.reordered - reordered,
+                       (LIST_ROWS - 1) * 10 );
+
+          calls_check( c, calls[CALL_glDrawArrays] + calls[CALL_glDrawArraysInstanced] == 4,
+                       "list: %lu draw calls instead of 4",
+                       calls[CALL_glDrawArrays] + calls[CALL_glDrawArraysInstanced] );
+     }
+
+     D_FREE( pixels );
+     D_FREE( expected );
+}
+
+/*
+ * Icons blitted from atlas pages, reduced to four pages of 4x4 slots to reach the eviction of a page.
+ */
+static void
+scenario_atlas( Calls *c )
+{
+     GLES2DriverData       *drv   = c->harness.driver_data;
+     GLES2Atlas            *atlas = &drv->atlas;
+     const GLES2AtlasEntry *entry;
+     unsigned int           i;
+     u32                    pixel[16 * 16];
+
+     /* The pages are created with the size on first use. */
+     if (atlas->pages[0].tex) {
+          calls_check( c, false, "atlas: pages already in use" );
+          return;
+     }
+
+     atlas->size     = 64;
+     atlas->max_size = 16;
+
+     /* Each icon gets its own slot, filling shelves from left to right. */
+     for (i = 0; i < 8; i++)
+          calls_icon( c, i );
+
+     gles2_harness_sync( &c->harness );
+
+     for (i = 0; i < 8; i++) {
+          entry = calls_atlas_entry( c, i );
+
+          calls_check( c, entry && entry->page == &atlas->pages[0] &&
+                       entry->slot.x == (int) (i % 4) * 16 && entry->slot.y == (int) (i / 4) * 16,
+                       "atlas: icon %u not copied into slot %u,%u of the first page", i, (i % 4) * 16, (i / 4) * 16 );
+
+          calls_check( c, calls_pixel( c, i * 16 + 8, 72 ) == calls_icon_color( i, 0 ),
+                       "atlas: icon %u blitted from the wrong slot", i );
+     }
+
+     /* A modified icon is copied again into a new slot. */
+     for (i = 0; i < 16 * 16; i++)
+          pixel[i] = calls_icon_color( 0, 1 );
+
+     recording = false;
+
+     glBindTexture( GL_TEXTURE_2D, c->icons[0].tex );
+     glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 16, 16, GL_RGBA, GL_UNSIGNED_BYTE, pixel );
+
+     recording = true;
+
+     direct_serial_increase( &c->icons[0].allocation.serial );
+
+     calls_icon( c, 0 );
+
+     gles2_harness_sync( &c->harness );
+
+     entry = calls_atlas_entry( c, 0 );
+
+     calls_check( c, entry && entry->changes == 1 && entry->page == &atlas->pages[0] &&
+                  entry->slot.x == 0 && entry->slot.y == 32,
+                  "atlas: modified icon not copied into a new slot" );
+
+     calls_check( c, calls_pixel( c, 8, 72 ) == calls_icon_color( 0, 1 ),
+                  "atlas: modified icon blitted from the old copy" );
+
+     /* A new allocation at the same address with the same texture name is copied too, whatever its serial. */
+     for (i = 0; i < 16 * 16; i++)
+          pixel[i] = calls_icon_color( 2, 1 );
+
+     recording = false;
+
+     glBindTexture( GL_TEXTURE_2D, c->icons[2].tex );
+     glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 16, 16, GL_RGBA, GL_UNSIGNED_BYTE, pixel );
+
+     recording = true;
+
+     c->icons[2].allocation.object.id += NUM_ICONS;
+
+     calls_icon( c, 2 );
+
+     gles2_harness_sync( &c->harness );
+
+     entry = calls_atlas_entry( c, 2 );
+
+     calls_check( c, entry && entry->changes == 0 && entry->page == &atlas->pages[0] &&
+                  entry->slot.x == 16 && entry->slot.y == 32, "atlas: reallocated icon not copied into a new slot" );
+
+     calls_check( c, calls_pixel( c, 40, 72 ) == calls_icon_color( 2, 1 ),
+                  "atlas: reallocated icon blitted from the old copy" );
+
+     /* The remaining icons fill all pages, the least recently used page is evicted for the last two. */
+     for (i = 8; i < NUM_ICONS; i++)
+          calls_icon( c, i );
+
+     gles2_harness_sync( &c->harness );
+
+     for (i = 0; i < NUM_ICONS; i++) {
+          calls_check( c, calls_pixel( c, (i % 32) * 16 + 8, 64 + (i / 32) * 16 + 8 ) ==
+                       calls_icon_color( i, i == 0 || i == 2 ), "atlas: icon %u blitted from the wrong slot", i );
+     }
+
+     for (i = 0; i < 14; i++) {
+          entry = calls_atlas_entry( c, i );
+
+          calls_check( c, entry && !entry->page, "atlas: icon %u still in the evicted page", i );
+     }
+
+     for (i = NUM_ICONS - 2; i < NUM_ICONS; i++) {
+          entry = calls_atlas_entry( c, i );
+
+          calls_check( c, entry && entry->page == &atlas->pages[0] &&
+                       entry->slot.x == (int) (i - (NUM_ICONS - 2)) * 16 && entry->slot.y == 0,
+                       "atlas: icon %u not copied into the evicted page", i );
+     }
+
+     /* An evicted icon is copied again on its next use. */
+     calls_icon( c, 1 );
+
+     gles2_harness_sync( &c->harness );
+
+     entry = calls_atlas_entry( c, 1 );
+
+     calls_check( c, entry && entry->page == &atlas->pages[0] && entry->slot.x == 32 && entry->slot.y == 0,
+                  "atlas: evicted icon not copied again" );
+
+     calls_check( c, calls_pixel( c, 24, 72 ) == calls_icon_color( 1, 0 ),
+                  "atlas: evicted icon blitted from the wrong slot" );
+
+     gles2_harness_set_source( &c->harness, &c->source );
+}
+
+/*
+ * Scenarios with the expected calls on the OpenGL ES 2.0 path and on the OpenGL ES 3.x path, in the order of CallIndex.
+ * The counts are only checked when all scenarios are run with the default options, each one starts with the hardware
+ * state left by the previous one.
+ */
+static const struct {
+     const char    *name;
+     void         (*run)( Calls *c );
+     unsigned long  expected[2][NUM_CALLS];
+} scenarios[] = {
+     { "fill_same_state", scenario_fill_same_state,
+       { { 0, 0, 0, 0, 0, 0, 1, 2, 0, 1, 1, 2, 2, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 1, 2, 2, 1 },
+         { 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 2, 2, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 2, 2, 1 } } },
+     { "frame", scenario_frame,
+       { { 0, 0, 0, 0, 1, 1, 11, 11, 10, 0, 0, 11, 1, 0, 0, 0, 0, 0, 1, 0, 11, 1, 0, 0, 0, 10, 1 },
+         { 0, 0, 0, 0, 1, 1, 11, 0, 10, 0, 0, 0, 1, 10, 0, 0, 10, 0, 1, 0, 11, 1, 0, 0, 0, 10, 1 } } },
+     { "fill_color_change", scenario_fill_color_change,
+       { { 0, 0, 0, 0, 0, 0, 100, 100, 100, 0, 0, 100, 4, 0, 0, 0, 0, 0, 1, 0, 100, 1, 0, 0, 0, 100, 1 },
+         { 0, 0, 0, 0, 0, 0, 100, 0, 100, 0, 0, 0, 4, 100, 0, 0, 100, 0, 1, 0, 100, 1, 0, 0, 0, 100, 1 } } },
+     { "fill_blend_toggle", scenario_fill_blend_toggle,
+       { { 0, 0, 0, 1, 0, 0, 50, 100, 100, 0, 50, 100, 4, 0, 0, 0, 0, 0, 1, 0, 100, 1, 0, 0, 0, 100, 1 },
+         { 0, 0, 0, 1, 0, 0, 50, 0, 100, 0, 50, 0, 4, 100, 0, 0, 100, 0, 1, 0, 100, 1, 0, 0, 0, 100, 1 } } },
+     { "blit_same_state", scenario_blit_same_state,
+       { { 0, 1, 0, 0, 0, 0, 1, 2, 0, 1, 1, 4, 1, 0, 1, 2, 0, 1, 1, 0, 1, 1, 1, 1, 1, 4, 1 },
+         { 1, 1, 1, 0, 0, 0, 1, 2, 0, 1, 1, 4, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 4, 1 } } },
+     { "blit_blend", scenario_blit_blend,
+       { { 0, 0, 0, 1, 0, 0, 0, 2, 0, 1, 1, 4, 1, 0, 0, 2, 0, 0, 1, 0, 1, 1, 0, 1, 1, 4, 1 },
+         { 0, 0, 0, 1, 0, 0, 0, 2, 0, 1, 1, 2, 1, 1, 0, 0, 1, 0, 1, 0, 1, 1, 0, 1, 1, 4, 1 } } },
+     { "blit_flags_toggle", scenario_blit_flags_toggle,
+       { { 0, 1, 0, 100, 0, 0, 0, 0, 100, 0, 101, 200, 4, 0, 1, 200, 0, 1, 3, 1, 100, 3, 100, 0, 0, 200, 3 },
+         { 0, 1, 0, 100, 0, 0, 0, 0, 100, 0, 101, 0, 4, 100, 1, 0, 100, 1, 3, 1, 100, 3, 100, 0, 0, 200, 3 } } },
+     { "fill_blit_mix", scenario_fill_blit_mix,
+       { { 0, 0, 0, 0, 0, 0, 52, 2, 52, 0, 0, 102, 4, 0, 0, 100, 0, 0, 2, 0, 2, 2, 4, 0, 0, 102, 2 },
+         { 0, 0, 4, 0, 0, 0, 52, 0, 52, 0, 0, 0, 4, 52, 0, 0, 52, 0, 2, 0, 2, 2, 4, 0, 0, 102, 2 } } },
+     { "glyphs", scenario_glyphs,
+       { { 0, 1, 0, 1, 0, 0, 0, 20, 0, 10, 11, 40, 10, 0, 1, 20, 0, 1, 1, 0, 10, 1, 1, 10, 10, 40, 1 },
+         { 0, 1, 0, 1, 0, 0, 0, 20, 0, 10, 11, 20, 10, 10, 1, 0, 10, 1, 1, 0, 10, 1, 1, 10, 10, 40, 1 } } },
+     { "stretchblit", scenario_stretchblit,
+       { { 0, 0, 0, 0, 0, 0, 1, 0, 50, 0, 0, 2, 50, 0, 0, 2, 0, 0, 0, 0, 1, 0, 1, 0, 0, 100, 0 },
+         { 0, 0, 0, 0, 0, 0, 1, 0, 50, 0, 0, 0, 50, 50, 0, 0, 50, 0, 0, 0, 1, 0, 1, 0, 0, 100, 0 } } },
+     { "destination_switch", scenario_destination_switch,
+       { { 0, 0, 0, 0, 0, 0, 20, 20, 20, 0, 20, 20, 21, 0, 20, 0, 0, 0, 20, 0, 1, 20, 1, 0, 0, 20, 20 },
+         { 0, 0, 1, 0, 0, 0, 20, 0, 20, 0, 20, 0, 21, 20, 20, 0, 20, 0, 20, 0, 1, 20, 1, 0, 0, 20, 20 } } },
+     { "list", scenario_list,
+       { { 0, 2, 0, 0, 0, 0, 4, 7, 1, 3, 0, 11, 1, 0, 0, 4, 0, 2, 3, 0, 4, 3, 3, 2, 3, 11, 3 },
+         { 0, 2, 2, 0, 0, 0, 4, 5, 1, 3, 0, 5, 1, 4, 0, 0, 4, 2, 3, 0, 4, 3, 3, 2, 3, 11, 3 } } },
+     { "atlas", scenario_atlas,
+       { { 0, 82, 0, 0, 0, 0, 8, 14, 3, 7, 0, 30, 86, 0, 0, 16, 0, 8, 5, 0, 3, 5, 1, 7, 7, 34, 5 },
+         { 0, 82, 1, 0, 0, 0, 8, 14, 3, 7, 0, 14, 86, 10, 0, 0, 10, 8, 5, 0, 3, 5, 1, 7, 7, 34, 5 } } }
+};
+
+/**********************************************************************************************************************/
+
+static void
+print_usage( void )
+{
+     fprintf( stderr, "Usage: gles2_calls [-v] [<scenario>]\n" );
+}
+
+int
+main( int   argc,
+      char *argv[] )
+{
+     DFBResult        ret;
+     Calls            c;
+     GLES2DriverData *drv;
+     const char      *filter = NULL;
+     unsigned int     i, n;
+     unsigned long    total;
+
+     memset( &c, 0, sizeof(c) );
+
+     /* Skipped by 'meson test' without a headless EGL context. */
+     ret = gles2_harness_init( &c.harness, &argc, &argv );
+     if (ret)
+          return 77;
+
+     drv = c.harness.driver_data;
+
+     for (n = 1; n < (unsigned int) argc; n++) {
+          if (!strcmp( argv[n], "-v" ))
+               verbose = true;
+          else if (!filter && argv[n][0] != '-')
+               filter = argv[n];
+          else {
+               print_usage();
+               gles2_harness_deinit( &c.harness );
+               return 1;
+          }
+     }
+
+     if (gles2_harness_surface_create( &c.destination[0], 1, 640, 480, DSPF_ABGR, NULL ) ||
+         gles2_harness_surface_create( &c.destination[1], 2, 320, 240, DSPF_ABGR, NULL ) ||
+         gles2_harness_surface_create( &c.source,         3, 256, 256, DSPF_ABGR, NULL )) {
+          gles2_harness_deinit( &c.harness );
+          return 1;
+     }
+
+     for (i = 0; i < NUM_ICONS; i++) {
+          u32 pixel[16 * 16];
+
+          for (n = 0; n < 16 * 16; n++)
+               pixel[n] = calls_icon_color( i, 0 );
+
+          if (gles2_harness_surface_create( &c.icons[i], 10 + i, 16, 16, DSPF_ABGR, pixel )) {
+               gles2_harness_deinit( &c.harness );
+               return 1;
+          }
+     }
+
+     gles2_harness_set_destination( &c.harness, &c.destination[0] );
+     gles2_harness_set_source( &c.harness, &c.source );
+
+     c.harness.state.src_colorkey = 0x0000ff00;
+
+     /* Scenarios run in order, each one starts with the hardware state left by the previous one. */
+     for (i = 0; i < D_ARRAY_SIZE(scenarios); i++) {
+          if (filter && strcmp( filter, scenarios[i].name ))
+               continue;
+
+          if (verbose)
+               printf( "%s:\n", scenarios[i].name );
+
+          memset( calls, 0, sizeof(calls) );
+
+          c.ops = 0;
+
+          recording = true;
+
+          scenarios[i].run( &c );
+
+          /* The frame ends with the engine synchronized, commands kept for offscreen surfaces are issued too. */
+          gles2_harness_sync( &c.harness );
+
+          recording = false;
+
+          printf( "{\"scenario\":\"%s\",\"ops\":%lu,\"calls\":{", scenarios[i].name, c.ops );
+
+          for (n = 0, total = 0; n < NUM_CALLS; n++) {
+               printf( "%s\"%s\":%lu", n ? "," : "", call_names[n], calls[n] );
+
+               total += calls[n];
+          }
+
+          printf( "},\"total\":%lu,\"calls_per_op\":%.2f}\n", total, c.ops ? (double) total / c.ops : 0.0 );
+
+          if (filter)
+               continue;
+
+          for (n = 0; n < NUM_CALLS; n++) {
+               calls_check( &c, calls[n] == scenarios[i].expected[drv->es3][n], "%s: %lu %s calls instead of %lu",
+                            scenarios[i].name, calls[n], call_names[n], scenarios[i].expected[drv->es3][n] );
+          }
+     }
+
+     gles2_harness_sync( &c.harness );
+
+     for (i = 0; i < NUM_ICONS; i++)
+          gles2_harness_surface_destroy( &c.icons[i] );
+
+     gles2_harness_surface_destroy( &c.source );
+     gles2_harness_surface_destroy( &c.destination[1] );
+     gles2_harness_surface_destroy( &c.destination[0] );
+
+     gles2_harness_deinit( &c.harness );
+
+     return c.failed ? 1 : 0;
+}
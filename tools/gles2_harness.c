@@ -0,0 +1,341 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <direct/list.h>
+#include <direct/modules.h>
+#include <misc/conf.h>
+
+#include "gles2_harness.h"
+
+D_DEBUG_DOMAIN( GLES2_Harness, "GLES2/Harness", "OpenGL ES 2.0 Driver Harness" );
+
+/**********************************************************************************************************************/
+
+static DFBResult
+harness_init_egl( GLES2Harness *harness )
+{
+     EGLConfig  config;
+     EGLint     num_configs = 0;
+     EGLint     config_attribs[]  = { EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, EGL_NONE };
+     EGLint     context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+
+     harness->display = EGL_NO_DISPLAY;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+     {
+          PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplayEXT;
+
+          /* Prefer a surfaceless platform, no window system is required. */
+          GetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+          if (GetPlatformDisplayEXT)
+               harness->display = GetPlatformDisplayEXT( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+     }
+#endif
+
+     if (harness->display == EGL_NO_DISPLAY)
+          harness->display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+     if (!eglInitialize( harness->display, NULL, NULL )) {
+          D_ERROR( "GLES2/Harness: Failed to initialize EGL display!\n" );
+          return DFB_INIT;
+     }
+
+     eglBindAPI( EGL_OPENGL_ES_API );
+
+     /* No surface is used, fall back to a context without config if there is no matching config. */
+     if (!eglChooseConfig( harness->display, config_attribs, &config, 1, &num_configs ) || !num_configs)
+          config = (EGLConfig) 0;
+
+     harness->context = eglCreateContext( harness->display, config, EGL_NO_CONTEXT, context_attribs );
+     if (harness->context == EGL_NO_CONTEXT) {
+          D_ERROR( "GLES2/Harness: Failed to create EGL context!\n" );
+          eglTerminate( harness->display );
+          return DFB_INIT;
+     }
+
+     if (!eglMakeCurrent( harness->display, EGL_NO_SURFACE, EGL_NO_SURFACE, harness->context )) {
+          D_ERROR( "GLES2/Harness: Failed to make EGL context current (EGL_KHR_surfaceless_context required)!\n" );
+          eglDestroyContext( harness->display, harness->context );
+          eglTerminate( harness->display );
+          return DFB_INIT;
+     }
+
+     D_DEBUG_AT( GLES2_Harness, "  -> %s, %s\n", glGetString( GL_RENDERER ), glGetString( GL_VERSION ) );
+
+     return DFB_OK;
+}
+
+static void
+harness_deinit_egl( GLES2Harness *harness )
+{
+     eglMakeCurrent( harness->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+     eglDestroyContext( harness->display, harness->context );
+     eglTerminate( harness->display );
+}
+
+/**********************************************************************************************************************/
+
+DFBResult
+gles2_harness_init( GLES2Harness  *harness,
+                    int           *argc,
+                    char         **argv[] )
+{
+     DFBResult           ret;
+     DirectModuleEntry  *module;
+     GraphicsDriverInfo  driver_info;
+     GLES2DriverData    *drv;
+
+     D_DEBUG_AT( GLES2_Harness, "%s()\n", __FUNCTION__ );
+
+     memset( harness, 0, sizeof(GLES2Harness) );
+
+     /* Parse DFBARGS and the command line, driver options can be passed this way. */
+     ret = dfb_config_init( argc, argv );
+     if (ret)
+          return ret;
+
+     /* The driver is built into the tool, it has registered itself. */
+     direct_list_foreach (module, dfb_graphics_drivers.entries) {
+          if (!strcmp( module->name, "gles2" )) {
+               harness->driver = module->funcs;
+               break;
+          }
+     }
+
+     if (!harness->driver) {
+          D_ERROR( "GLES2/Harness: Driver not registered!\n" );
+          return DFB_NOIMPL;
+     }
+
+     ret = harness_init_egl( harness );
+     if (ret)
+          return ret;
+
+     if (!harness->driver->Probe()) {
+          D_ERROR( "GLES2/Harness: Driver probe failed!\n" );
+          ret = DFB_UNSUPPORTED;
+          goto error_egl;
+     }
+
+     memset( &driver_info, 0, sizeof(driver_info) );
+
+     harness->driver->GetDriverInfo( &driver_info );
+
+     harness->driver_data = D_CALLOC( 1, driver_info.driver_data_size );
+     harness->device_data = D_CALLOC( 1, driver_info.device_data_size );
+     if (!harness->driver_data || !harness->device_data) {
+          ret = D_OOM();
+          goto error_data;
+     }
+
+     ret = harness->driver->InitDriver( &harness->funcs, harness->driver_data, harness->device_data, NULL );
+     if (ret) {
+          D_ERROR( "GLES2/Harness: Failed to initialize driver!\n" );
+          goto error_data;
+     }
+
+     ret = harness->driver->InitDevice( &harness->device_info, harness->driver_data, harness->device_data );
+     if (ret) {
+          D_ERROR( "GLES2/Harness: Failed to initialize device!\n" );
+          harness->driver->CloseDriver( harness->driver_data );
+          goto error_data;
+     }
+
+     /* There are no screens without DirectFB core, and the destination is always a framebuffer object. */
+     drv = harness->driver_data;
+
+     drv->aspect   = 1.0f;
+     drv->rotation = 0;
+
+     /* Default state. */
+     harness->state.mod_hw    = SMF_ALL;
+     harness->state.src_blend = DSBF_SRCALPHA;
+     harness->state.dst_blend = DSBF_INVSRCALPHA;
+     harness->state.color.a   = 0xff;
+     harness->state.color.r   = 0xff;
+     harness->state.color.g   = 0xff;
+     harness->state.color.b   = 0xff;
+
+     return DFB_OK;
+
+error_data:
+     if (harness->device_data)
+          D_FREE( harness->device_data );
+
+     if (harness->driver_data)
+          D_FREE( harness->driver_data );
+
+error_egl:
+     harness_deinit_egl( harness );
+
+     return ret;
+}
+
+void
+gles2_harness_deinit( GLES2Harness *harness )
+{
+     D_DEBUG_AT( GLES2_Harness, "%s()\n", __FUNCTION__ );
+
+     harness->driver->CloseDevice( harness->driver_data, harness->device_data );
+     harness->driver->CloseDriver( harness->driver_data );
+
+     D_FREE( harness->device_data );
+     D_FREE( harness->driver_data );
+
+     harness_deinit_egl( harness );
+}
+
+DFBResult
+gles2_harness_surface_create( GLES2HarnessSurface   *surface,
+                              u32                    id,
+                              int                    width,
+                              int                    height,
+                              DFBSurfacePixelFormat  format,
+                              const void            *pixels )
+{
+     D_DEBUG_AT( GLES2_Harness, "%s( %u, %dx%d )\n", __FUNCTION__, id, width, height );
+
+     memset( surface, 0, sizeof(GLES2HarnessSurface) );
+
+     surface->surface.object.id     = id;
+     surface->surface.config.size.w = width;
+     surface->surface.config.size.h = height;
+     surface->surface.config.format = format;
+
+     surface->buffer.surface        = &surface->surface;
+
+     surface->allocation.object.id  = id;
+     surface->allocation.buffer     = &surface->buffer;
+     surface->allocation.surface    = &surface->surface;
+     surface->allocation.config     = surface->surface.config;
+
+     glGenTextures( 1, &surface->tex );
+     glBindTexture( GL_TEXTURE_2D, surface->tex );
+
+     glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+
+     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+     glGenFramebuffers( 1, &surface->fbo );
+     glBindFramebuffer( GL_FRAMEBUFFER, surface->fbo );
+     glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, surface->tex, 0 );
+
+     if (glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE) {
+          D_ERROR( "GLES2/Harness: Incomplete framebuffer for %dx%d surface!\n", width, height );
+          gles2_harness_surface_destroy( surface );
+          return DFB_FAILURE;
+     }
+
+     return DFB_OK;
+}
+
+void
+gles2_harness_surface_destroy( GLES2HarnessSurface *surface )
+{
+     D_DEBUG_AT( GLES2_Harness, "%s( %u )\n", __FUNCTION__, surface->surface.object.id );
+
+     glDeleteFramebuffers( 1, &surface->fbo );
+     glDeleteTextures( 1, &surface->tex );
+
+     surface->fbo = 0;
+     surface->tex = 0;
+}
+
+void
+gles2_harness_set_destination( GLES2Harness        *harness,
+                               GLES2HarnessSurface *surface )
+{
+     CardState *state = &harness->state;
+
+     state->destination    = &surface->surface;
+     state->dst.buffer     = &surface->buffer;
+     state->dst.allocation = &surface->allocation;
+     state->dst.handle     = (void*)(long) surface->tex;
+
+     state->clip.x1 = 0;
+     state->clip.y1 = 0;
+     state->clip.x2 = surface->surface.config.size.w - 1;
+     state->clip.y2 = surface->surface.config.size.h - 1;
+
+     /* The driver renders into the framebuffer bound by the system module. */
+     glBindFramebuffer( GL_FRAMEBUFFER, surface->fbo );
+
+     gles2_harness_modified( harness, SMF_DESTINATION | SMF_CLIP );
+}
+
+void
+gles2_harness_set_source( GLES2Harness        *harness,
+                          GLES2HarnessSurface *surface )
+{
+     CardState *state = &harness->state;
+
+     state->source         = &surface->surface;
+     state->src.buffer     = &surface->buffer;
+     state->src.allocation = &surface->allocation;
+     state->src.handle     = (void*)(long) surface->tex;
+
+     gles2_harness_modified( harness, SMF_SOURCE );
+}
+
+void
+gles2_harness_modified( GLES2Harness           *harness,
+                        StateModificationFlags  flags )
+{
+     harness->state.mod_hw  |= flags;
+     harness->state.checked  = DFXL_NONE;
+     harness->state.set      = DFXL_NONE;
+}
+
+bool
+gles2_harness_acquire( GLES2Harness        *harness,
+                       DFBAccelerationMask  accel )
+{
+     CardState *state = &harness->state;
+
+     if (!(state->checked & accel)) {
+          state->accel &= ~accel;
+
+          harness->funcs.CheckState( harness->driver_data, harness->device_data, state, accel );
+
+          state->checked |= accel;
+     }
+
+     if (!(state->accel & accel))
+          return false;
+
+     if (state->mod_hw || !(state->set & accel))
+          harness->funcs.SetState( harness->driver_data, harness->device_data, &harness->funcs, state, accel );
+
+     return true;
+}
+
+void
+gles2_harness_sync( GLES2Harness *harness )
+{
+     if (harness->funcs.EmitCommands)
+          harness->funcs.EmitCommands( harness->driver_data, harness->device_data );
+
+     /* Commands rendering into offscreen surfaces are kept until the engine is synchronized. */
+     if (harness->funcs.EngineSync)
+          harness->funcs.EngineSync( harness->driver_data, harness->device_data );
+
+     glFinish();
+}
@@ -0,0 +1,100 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GLES2_HARNESS_H__
+#define __GLES2_HARNESS_H__
+
+#include <core/graphics_driver.h>
+#include <core/state.h>
+#include <core/surface_allocation.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gles2_gfxdriver.h"
+
+/**********************************************************************************************************************/
+
+/*
+ * A surface backed by a texture and a framebuffer object, standing in for a surface of the GL surface pool.
+ */
+typedef struct {
+     CoreSurface            surface;
+     CoreSurfaceBuffer      buffer;
+     CoreSurfaceAllocation  allocation;
+
+     GLuint                 tex;        /* texture object */
+     GLuint                 fbo;        /* framebuffer object with the texture attached */
+} GLES2HarnessSurface;
+
+/*
+ * The driver running on a headless EGL context (e.g. Mesa surfaceless/llvmpipe), without DirectFB core.
+ */
+typedef struct {
+     EGLDisplay                 display;     /* EGL display */
+     EGLContext                 context;     /* EGL context current on the calling thread */
+
+     const GraphicsDriverFuncs *driver;      /* driver functions */
+     GraphicsDeviceFuncs        funcs;       /* device functions */
+     GraphicsDeviceInfo         device_info; /* device information */
+     void                      *driver_data; /* driver data */
+     void                      *device_data; /* device data */
+
+     CardState                  state;       /* state passed to the device functions */
+} GLES2Harness;
+
+/**********************************************************************************************************************/
+
+DFBResult gles2_harness_init             ( GLES2Harness          *harness,
+                                           int                   *argc,
+                                           char                 **argv[] );
+
+void      gles2_harness_deinit           ( GLES2Harness          *harness );
+
+DFBResult gles2_harness_surface_create   ( GLES2HarnessSurface   *surface,
+                                           u32                    id,
+                                           int                    width,
+                                           int                    height,
+                                           DFBSurfacePixelFormat  format,
+                                           const void            *pixels );
+
+void      gles2_harness_surface_destroy  ( GLES2HarnessSurface   *surface );
+
+void      gles2_harness_set_destination  ( GLES2Harness          *harness,
+                                           GLES2HarnessSurface   *surface );
+
+void      gles2_harness_set_source       ( GLES2Harness          *harness,
+                                           GLES2HarnessSurface   *surface );
+
+/*
+ * Mark state fields as modified, as done by the DirectFB state functions.
+ */
+void      gles2_harness_modified         ( GLES2Harness          *harness,
+                                           StateModificationFlags flags );
+
+/*
+ * Check and set the state for a function like DirectFB core does, returns false if it is not accelerated.
+ */
+bool      gles2_harness_acquire          ( GLES2Harness          *harness,
+                                           DFBAccelerationMask    accel );
+
+/*
+ * Emit pending commands, synchronize the engine and wait until rendering has finished.
+ */
+void      gles2_harness_sync             ( GLES2Harness          *harness );
+
+#endif
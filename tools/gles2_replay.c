@@ -0,0 +1,549 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <direct/clock.h>
+#include <direct/serial.h>
+
+#include "gles2_harness.h"
+#include "gles2_trace.h"
+
+/*
+ * Replay a trace recorded with 'gles2-trace=<file>' through the driver on a headless context.
+ *
+ * Driver options are passed via DFBARGS or --dfb:, e.g. 'gles2_replay --dfb:gles2-gpu-timing trace.trc'.
+ */
+
+/**********************************************************************************************************************/
+
+typedef struct {
+     u32                 id;
+     GLES2HarnessSurface surface;
+} ReplaySurface;
+
+typedef struct {
+     GLES2Harness    harness;
+
+     ReplaySurface **surfaces;
+     unsigned int    num_surfaces;
+
+     unsigned long   counts[NUM_TRACE_RECORDS];
+     unsigned long   failed;
+     unsigned long   pixels;
+} Replay;
+
+static const char *record_names[NUM_TRACE_RECORDS] = {
+     [GLES2TR_SURFACE]         = "Surface",
+     [GLES2TR_SETSTATE]        = "SetState",
+     [GLES2TR_FILLRECTANGLE]   = "FillRectangle",
+     [GLES2TR_DRAWRECTANGLE]   = "DrawRectangle",
+     [GLES2TR_DRAWLINE]        = "DrawLine",
+     [GLES2TR_FILLTRIANGLE]    = "FillTriangle",
+     [GLES2TR_BLIT]            = "Blit",
+     [GLES2TR_STRETCHBLIT]     = "StretchBlit",
+     [GLES2TR_BATCHBLIT]       = "BatchBlit",
+     [GLES2TR_EMITCOMMANDS]    = "EmitCommands",
+     [GLES2TR_FILLQUADRANGLES] = "FillQuadrangles"
+};
+
+/**********************************************************************************************************************/
+
+/*
+ * Look up the surface with the id of the reference, (re)creating it if it does not exist or has a different size.
+ */
+static GLES2HarnessSurface *
+replay_surface( Replay                  *replay,
+                const GLES2TraceSurface *ref )
+{
+     unsigned int    i;
+     ReplaySurface  *surface;
+     ReplaySurface **surfaces;
+
+     for (i = 0; i < replay->num_surfaces; i++) {
+          surface = replay->surfaces[i];
+
+          if (surface->id == ref->id) {
+               if (surface->surface.surface.config.size.w == ref->w &&
+                   surface->surface.surface.config.size.h == ref->h)
+                    return &surface->surface;
+
+               gles2_harness_surface_destroy( &surface->surface );
+               break;
+          }
+     }
+
+     /* Surfaces are allocated individually, the state points to them. */
+     if (i == replay->num_surfaces) {
+          surfaces = D_REALLOC( replay->surfaces, (replay->num_surfaces + 1) * sizeof(ReplaySurface*) );
+          if (!surfaces) {
+               D_OOM();
+               return NULL;
+          }
+
+          replay->surfaces = surfaces;
+
+          surface = D_CALLOC( 1, sizeof(ReplaySurface) );
+          if (!surface) {
+               D_OOM();
+               return NULL;
+          }
+
+          replay->surfaces[replay->num_surfaces++] = surface;
+     }
+
+     surface->id = ref->id;
+
+     if (gles2_harness_surface_create( &surface->surface, ref->id, ref->w, ref->h, ref->format, NULL ))
+          return NULL;
+
+     return &surface->surface;
+}
+
+static DFBResult
+replay_setstate( Replay   *replay,
+                 const u8 *data,
+                 u32       size )
+{
+     GLES2Harness              *harness = &replay->harness;
+     CardState                 *state   = &harness->state;
+     const GLES2TraceSetState  *set     = (const GLES2TraceSetState*) data;
+     const u8                  *end     = data + size;
+     GLES2HarnessSurface       *surface;
+     DFBRegion                  clip    = state->clip;
+
+     data += sizeof(GLES2TraceSetState);
+
+#define REPLAY_FIELD(flag,field)                                                   \
+     do {                                                                          \
+          if (set->fields & flag) {                                                \
+               if (data + sizeof(field) > end)                                     \
+                    return DFB_IO;                                                 \
+               memcpy( &field, data, sizeof(field) );                              \
+               data += sizeof(field);                                              \
+          }                                                                        \
+     } while (0)
+
+     if (set->fields & GLES2TF_DESTINATION) {
+          GLES2TraceSurface ref;
+
+          REPLAY_FIELD( GLES2TF_DESTINATION, ref );
+
+          surface = replay_surface( replay, &ref );
+          if (!surface)
+               return DFB_FAILURE;
+
+          gles2_harness_set_destination( harness, surface );
+
+          /* Keep the recorded clip, setting the destination resets it. */
+          state->clip = clip;
+     }
+
+     if (set->fields & GLES2TF_SOURCE) {
+          GLES2TraceSurface ref;
+
+          REPLAY_FIELD( GLES2TF_SOURCE, ref );
+
+          /* No source has been used yet if drawing comes first. */
+          if (ref.w > 0 && ref.h > 0) {
+               surface = replay_surface( replay, &ref );
+               if (!surface)
+                    return DFB_FAILURE;
+
+               gles2_harness_set_source( harness, surface );
+          }
+     }
+
+     REPLAY_FIELD( GLES2TF_CLIP,           state->clip );
+     REPLAY_FIELD( GLES2TF_COLOR,          state->color );
+     REPLAY_FIELD( GLES2TF_DRAWINGFLAGS,   state->drawingflags );
+     REPLAY_FIELD( GLES2TF_BLITTINGFLAGS,  state->blittingflags );
+     REPLAY_FIELD( GLES2TF_BLEND,          state->src_blend );
+     REPLAY_FIELD( GLES2TF_BLEND,          state->dst_blend );
+     REPLAY_FIELD( GLES2TF_SRC_COLORKEY,   state->src_colorkey );
+     REPLAY_FIELD( GLES2TF_RENDER_OPTIONS, state->render_options );
+     REPLAY_FIELD( GLES2TF_MATRIX,         state->matrix );
+     REPLAY_FIELD( GLES2TF_COLORMATRIX,    state->src_colormatrix );
+     REPLAY_FIELD( GLES2TF_CONVOLUTION,    state->src_convolution );
+
+#undef REPLAY_FIELD
+
+     /* The recorded modification flags take precedence over the ones from the harness. */
+     state->mod_hw = set->mod_hw;
+
+     harness->funcs.SetState( harness->driver_data, harness->device_data, &harness->funcs, state, set->accel );
+
+     return DFB_OK;
+}
+
+static DFBResult
+replay_record( Replay                 *replay,
+               const GLES2TraceRecord *record,
+               const u8               *data )
+{
+     GLES2Harness *harness = &replay->harness;
+     void         *drv     = harness->driver_data;
+     void         *dev     = harness->device_data;
+     bool          done    = true;
+
+     switch (record->type) {
+          case GLES2TR_SURFACE: {
+               const GLES2TraceSurface *ref = (const GLES2TraceSurface*) data;
+               GLES2HarnessSurface     *surface;
+
+               if (record->size < sizeof(GLES2TraceSurface) ||
+                   record->size < sizeof(GLES2TraceSurface) + ref->w * ref->h * 4)
+                    return DFB_IO;
+
+               surface = replay_surface( replay, ref );
+               if (!surface)
+                    return DFB_FAILURE;
+
+               glBindTexture( GL_TEXTURE_2D, surface->tex );
+               glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, ref->w, ref->h, GL_RGBA, GL_UNSIGNED_BYTE, ref + 1 );
+
+               /* The contents changed, as after a write lock in DirectFB core. */
+               direct_serial_increase( &surface->allocation.serial );
+               break;
+          }
+
+          case GLES2TR_SETSTATE:
+               if (record->size < sizeof(GLES2TraceSetState))
+                    return DFB_IO;
+
+               return replay_setstate( replay, data, record->size );
+
+          case GLES2TR_FILLRECTANGLE:
+          case GLES2TR_DRAWRECTANGLE: {
+               DFBRectangle rect;
+
+               if (record->size < sizeof(rect))
+                    return DFB_IO;
+
+               memcpy( &rect, data, sizeof(rect) );
+
+               if (record->type == GLES2TR_FILLRECTANGLE)
+                    done = harness->funcs.FillRectangle( drv, dev, &rect );
+               else
+                    done = harness->funcs.DrawRectangle( drv, dev, &rect );
+
+               replay->pixels += rect.w * rect.h;
+               break;
+          }
+
+          case GLES2TR_DRAWLINE: {
+               DFBRegion line;
+
+               if (record->size < sizeof(line))
+                    return DFB_IO;
+
+               memcpy( &line, data, sizeof(line) );
+
+               done = harness->funcs.DrawLine( drv, dev, &line );
+               break;
+          }
+
+          case GLES2TR_FILLTRIANGLE: {
+               DFBTriangle tri;
+
+               if (record->size < sizeof(tri))
+                    return DFB_IO;
+
+               memcpy( &tri, data, sizeof(tri) );
+
+               done = harness->funcs.FillTriangle( drv, dev, &tri );
+               break;
+          }
+
+          case GLES2TR_FILLQUADRANGLES: {
+               u32       num;
+               DFBPoint *points;
+
+               if (record->size < sizeof(u32))
+                    return DFB_IO;
+
+               memcpy( &num, data, sizeof(u32) );
+
+               if (record->size < sizeof(u32) + num * 4 * sizeof(DFBPoint))
+                    return DFB_IO;
+
+               /* Copy to get proper alignment. */
+               points = D_MALLOC( num * 4 * sizeof(DFBPoint) );
+               if (!points)
+                    return D_OOM();
+
+               memcpy( points, data + sizeof(u32), num * 4 * sizeof(DFBPoint) );
+
+               done = harness->funcs.FillQuadrangles( drv, dev, points, num );
+
+               D_FREE( points );
+               break;
+          }
+
+          case GLES2TR_BLIT: {
+               DFBRectangle rect;
+               DFBPoint     point;
+
+               if (record->size < sizeof(rect) + sizeof(point))
+                    return DFB_IO;
+
+               memcpy( &rect, data, sizeof(rect) );
+               memcpy( &point, data + sizeof(rect), sizeof(point) );
+
+               done = harness->funcs.Blit( drv, dev, &rect, point.x, point.y );
+
+               replay->pixels += rect.w * rect.h;
+               break;
+          }
+
+          case GLES2TR_STRETCHBLIT: {
+               DFBRectangle srect;
+               DFBRectangle drect;
+
+               if (record->size < 2 * sizeof(DFBRectangle))
+                    return DFB_IO;
+
+               memcpy( &srect, data, sizeof(srect) );
+               memcpy( &drect, data + sizeof(srect), sizeof(drect) );
+
+               done = harness->funcs.StretchBlit( drv, dev, &srect, &drect );
+
+               replay->pixels += drect.w * drect.h;
+               break;
+          }
+
+          case GLES2TR_BATCHBLIT: {
+               u32           num;
+               DFBRectangle *rects;
+               DFBPoint     *points;
+               unsigned int  i, ret_num = 0;
+
+               if (record->size < sizeof(u32))
+                    return DFB_IO;
+
+               memcpy( &num, data, sizeof(u32) );
+
+               if (record->size < sizeof(u32) + num * (sizeof(DFBRectangle) + sizeof(DFBPoint)))
+                    return DFB_IO;
+
+               /* Copy to get proper alignment. */
+               rects  = D_MALLOC( num * (sizeof(DFBRectangle) + sizeof(DFBPoint)) );
+               if (!rects)
+                    return D_OOM();
+
+               points = (DFBPoint*) (rects + num);
+
+               memcpy( rects, data + sizeof(u32), num * (sizeof(DFBRectangle) + sizeof(DFBPoint)) );
+
+               done = harness->funcs.BatchBlit( drv, dev, rects, points, num, &ret_num );
+
+               for (i = 0; i < num; i++)
+                    replay->pixels += rects[i].w * rects[i].h;
+
+               D_FREE( rects );
+               break;
+          }
+
+          case GLES2TR_EMITCOMMANDS:
+               if (harness->funcs.EmitCommands)
+                    harness->funcs.EmitCommands( drv, dev );
+               break;
+
+          default:
+               /* Skip unknown records. */
+               return DFB_OK;
+     }
+
+     if (!done)
+          replay->failed++;
+
+     return DFB_OK;
+}
+
+static DFBResult
+replay_trace( Replay   *replay,
+              const u8 *data,
+              size_t    length )
+{
+     DFBResult   ret;
+     size_t      offset = 8 + sizeof(u32);
+
+     while (offset + sizeof(GLES2TraceRecord) <= length) {
+          GLES2TraceRecord record;
+
+          memcpy( &record, data + offset, sizeof(record) );
+
+          offset += sizeof(record);
+
+          if (record.size > length - offset) {
+               fprintf( stderr, "Truncated record at offset %zu\n", offset - sizeof(record) );
+               return DFB_IO;
+          }
+
+          ret = replay_record( replay, &record, data + offset );
+          if (ret) {
+               fprintf( stderr, "Invalid record (type %u) at offset %zu\n", record.type, offset - sizeof(record) );
+               return ret;
+          }
+
+          if (record.type < NUM_TRACE_RECORDS)
+               replay->counts[record.type]++;
+
+          offset += record.size;
+     }
+
+     return DFB_OK;
+}
+
+/**********************************************************************************************************************/
+
+static void
+print_usage( void )
+{
+     fprintf( stderr, "Usage: gles2_replay [-n <repeat>] <trace>\n" );
+}
+
+int
+main( int   argc,
+      char *argv[] )
+{
+     DFBResult     ret;
+     Replay        replay;
+     const char   *filename = NULL;
+     int           repeat   = 1;
+     int           i;
+     unsigned int  n;
+     FILE         *file;
+     long          length;
+     u8           *data;
+     u32           version;
+     long long     start, micros;
+     unsigned long ops = 0;
+
+     memset( &replay, 0, sizeof(replay) );
+
+     ret = gles2_harness_init( &replay.harness, &argc, &argv );
+     if (ret)
+          return 1;
+
+     for (i = 1; i < argc; i++) {
+          if (!strcmp( argv[i], "-n" ) && i + 1 < argc)
+               repeat = atoi( argv[++i] );
+          else if (!filename)
+               filename = argv[i];
+          else {
+               print_usage();
+               goto error;
+          }
+     }
+
+     if (!filename || repeat < 1) {
+          print_usage();
+          goto error;
+     }
+
+     /* Read the whole trace to keep file I/O out of the measurement. */
+     file = fopen( filename, "rb" );
+     if (!file) {
+          fprintf( stderr, "Failed to open '%s'!\n", filename );
+          goto error;
+     }
+
+     fseek( file, 0, SEEK_END );
+     length = ftell( file );
+     fseek( file, 0, SEEK_SET );
+
+     data = D_MALLOC( length > 0 ? length : 1 );
+     if (!data) {
+          D_OOM();
+          fclose( file );
+          goto error;
+     }
+
+     if (fread( data, 1, length, file ) != (size_t) length) {
+          fprintf( stderr, "Failed to read '%s'!\n", filename );
+          fclose( file );
+          goto error_data;
+     }
+
+     fclose( file );
+
+     if (length < 8 + (long) sizeof(u32) || memcmp( data, GLES2_TRACE_MAGIC, 8 )) {
+          fprintf( stderr, "'%s' is not a trace file!\n", filename );
+          goto error_data;
+     }
+
+     memcpy( &version, data + 8, sizeof(u32) );
+
+     if (version < 1 || version > GLES2_TRACE_VERSION) {
+          fprintf( stderr, "Unsupported trace version %u!\n", version );
+          goto error_data;
+     }
+
+     start = direct_clock_get_micros();
+
+     for (i = 0; i < repeat; i++) {
+          ret = replay_trace( &replay, data, length );
+          if (ret)
+               goto error_data;
+     }
+
+     gles2_harness_sync( &replay.harness );
+
+     micros = direct_clock_get_micros() - start;
+     if (micros < 1)
+          micros = 1;
+
+     printf( "%-16s %10s\n", "Record", "Count" );
+
+     for (i = GLES2TR_SURFACE; i < NUM_TRACE_RECORDS; i++) {
+          printf( "%-16s %10lu\n", record_names[i], replay.counts[i] );
+
+          if (i >= GLES2TR_FILLRECTANGLE && i <= GLES2TR_BATCHBLIT)
+               ops += replay.counts[i];
+     }
+
+     printf( "\n" );
+     printf( "Replays        : %d\n", repeat );
+     printf( "Frames         : %lu\n", replay.counts[GLES2TR_EMITCOMMANDS] );
+     printf( "Not accelerated: %lu\n", replay.failed );
+     printf( "Time           : %lld.%03lld ms\n", micros / 1000, micros % 1000 );
+     printf( "Operations/sec : %.1f\n", ops * 1000000.0 / micros );
+     printf( "MPixels/sec    : %.2f\n", replay.pixels / (double) micros );
+
+     D_FREE( data );
+
+     for (n = 0; n < replay.num_surfaces; n++) {
+          gles2_harness_surface_destroy( &replay.surfaces[n]->surface );
+
+          D_FREE( replay.surfaces[n] );
+     }
+
+     if (replay.surfaces)
+          D_FREE( replay.surfaces );
+
+     gles2_harness_deinit( &replay.harness );
+
+     return 0;
+
+error_data:
+     D_FREE( data );
+
+error:
+     gles2_harness_deinit( &replay.harness );
+
+     return 1;
+}